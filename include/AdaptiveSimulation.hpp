@@ -0,0 +1,77 @@
+#pragma once
+
+#include "CellGrid.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Simulation {
+
+// The particles of DistributedSimulation in one process, integrated with block time steps: each particle runs at
+// level l, i.e. with time step dt / 2^l, where l is the coarsest level that satisfies an acceleration criterion
+// (sqrt(cutoff / |a|) * accuracy) and a CFL criterion (cutoff / |v| * courant). A step() advances everything by dt
+// in 2^max_level substeps of the finest level; on each substep every particle drifts, but only the particles whose
+// level ends a step there get new forces, a closing and an opening half kick (kick-drift-kick) and a new level. A
+// particle moves to a coarser level only where both levels' steps end, so the levels stay synchronised.
+//
+// Particles are kept sorted by level, finest first. The levels active on a substep are always the finest ones, so
+// the active particles are always the prefix [0, active_end(level)).
+class AdaptiveSimulation {
+public:
+    struct Config {
+        uint32_t particle_count = 64 * 1024;
+        float dt = 0.016f; // of level 0
+        uint32_t max_level = 6;
+        float accuracy = 0.1f;
+        float courant = 0.5f;
+        float strength = 0.05f;
+        float cutoff = 0.01f;
+        float stiffness = 2.0f;
+        uint32_t seed = 1234;
+    };
+
+    AdaptiveSimulation(ThreadPool& pool, const Config& config);
+
+    AdaptiveSimulation(const AdaptiveSimulation&) = delete;
+    void operator=(const AdaptiveSimulation&) = delete;
+
+    void step();
+
+    uint64_t tick() { return m_tick; }
+    const std::vector<DomainParticle>& particles() { return m_particles; }
+    uint32_t level_count(uint32_t level);
+    // Force evaluations so far, and what a global step at the finest level in use would have needed instead.
+    uint64_t force_evaluations() { return m_force_evaluations; }
+    uint64_t uniform_force_evaluations() { return m_uniform_force_evaluations; }
+
+private:
+    glm::vec3 acceleration(const DomainParticle& particle) const;
+    uint32_t pick_level(const DomainParticle& particle, const glm::vec3& acceleration) const;
+    void accelerate(uint32_t end);
+    // For particles [0, end): the closing half kick at the old level, a new level that may end a step after
+    // `substep`, and the opening half kick at that level. Returns whether any level changed.
+    bool kick(uint32_t end, uint32_t substep);
+    // Stable counting sort of the particles by level, finest first.
+    void sort_by_level();
+    // Particles at `level` or finer.
+    uint32_t active_end(uint32_t level) { return m_level_starts[m_config.max_level - level + 1]; }
+
+    ThreadPool& m_pool;
+    Config m_config;
+
+    std::vector<DomainParticle> m_particles;
+    std::vector<glm::vec3> m_accelerations;
+    std::vector<uint32_t> m_levels;
+    // Slot s holds level max_level - s; the particles of slot s are [m_level_starts[s], m_level_starts[s + 1]).
+    std::vector<uint32_t> m_level_starts;
+    CellGrid m_grid;
+
+    uint64_t m_tick = 0;
+    uint64_t m_force_evaluations = 0;
+    uint64_t m_uniform_force_evaluations = 0;
+};
+
+} // namespace Simulation
@@ -1,20 +1,128 @@
 #pragma once
 
+#include "Autotuner.hpp"
+#include "Device.hpp"
+#include "DrawQueue.hpp"
+#include "FrameCapture.hpp"
+#include "FrameLimiter.hpp"
+#include "GpuCulling.hpp"
+#include "GpuProfiler.hpp"
+#include "Mesh.hpp"
+#include "ParticleSimulation.hpp"
 #include "Pipeline.hpp"
+#include "RenderGraph.hpp"
+#include "SceneObjects.hpp"
+#include "SwapChain.hpp"
+#include "ThreadPool.hpp"
+#include "UploadQueue.hpp"
 #include "Window.hpp"
 
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
 namespace Simulation {
 class Application {
 public:
     static constexpr int WIDTH = 800;
     static constexpr int HEIGHT = 800;
 
+    Application();
+    ~Application();
+
+    Application(const Application&) = delete;
+    Application& operator=(const Application&) = delete;
+
+    // Draws only while something changes: the simulation is running, a mesh is still streaming in, or the window
+    // got input or needs repainting. Otherwise it blocks in glfwWaitEventsTimeout() without recording or
+    // presenting. Space pauses and resumes the simulation.
     void run();
 
+    // Stream every presented frame to `path` through a FrameCapture ring. Refused with an error when the surface does
+    // not let swapchain images be copied from.
+    void enable_capture(const std::string& path);
+    // Start streaming a .smesh file; it is drawn as soon as its coarsest LOD is resident.
+    void load_mesh(const std::string& path);
+    // Draw the mesh as `count` orbiting objects instead of once, culling them against the view every frame (see
+    // SceneObjects). Nothing is drawn for them until a mesh is loaded.
+    void add_objects(uint32_t count);
+    // Cull the objects with GpuCulling instead, against the frustum and last frame's depth, and draw them with one
+    // indirect call. Falls back to the BVH when the device cannot draw indirect with a first instance.
+    void enable_gpu_culling();
+    // Measure the compute kernels on this device instead of only using cached results (see Autotuner).
+    void enable_autotune(bool retune);
+    // Print average GPU time of the graphics and simulation work next to the frame time every few seconds, along
+    // with the draw calls and state changes recorded per frame and the objects left after culling. With async
+    // compute the frame time can be below the sum of the GPU times.
+    void enable_stats() { m_print_stats = true; }
+    // Cap the frame rate while drawing; 0 leaves it to presentation.
+    void set_frame_rate(double frames_per_second) { m_limiter.set_rate(frames_per_second); }
+    void set_paused(bool paused) { m_paused = paused; }
+
 private:
+    // How often the idle loop wakes without events to finish capture readbacks.
+    static constexpr double IDLE_TIMEOUT = 0.25;
+
+    void create_pipeline_layout();
+    void build_render_graph();
+    void create_pipeline();
+    void create_command_buffers();
+    void record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index);
+    void record_scene(VkCommandBuffer command_buffer);
+    void create_gpu_culling();
+    void record_gpu_cull(VkCommandBuffer command_buffer);
+    void record_gpu_draw(VkCommandBuffer command_buffer);
+    void handle_input();
+    bool needs_frame();
+    void draw_frame();
+    void poll_capture();
+    void update_stats(float frame_seconds, const std::vector<GpuProfiler::Scope>& gpu_scopes);
+
     Window m_window { WIDTH, HEIGHT, "Hello Vulkan" };
     Device m_device { m_window };
-    Pipeline m_pipeline { m_device, "../shaders/simple_shader.vert.spv", "../shaders/simple_shader.frag.spv",
-        Pipeline::default_pipeline_config_info(WIDTH, HEIGHT) };
+    SwapChain m_swap_chain { m_device, m_window.get_extent() };
+    RenderGraph m_graph { m_device, SwapChain::MAX_FRAMES_IN_FLIGHT };
+    RenderResource m_backbuffer;
+    uint32_t m_scene_pass;
+    VkPipelineLayout m_pipeline_layout;
+    std::unique_ptr<Pipeline> m_pipeline;
+    std::unique_ptr<Pipeline> m_mesh_pipeline;
+    std::unique_ptr<Pipeline> m_instanced_mesh_pipeline;
+    ThreadPool m_pool {};
+    DrawQueue m_draw_queue { m_device, m_pool, SwapChain::MAX_FRAMES_IN_FLIGHT };
+    uint32_t m_pipeline_id;
+    uint32_t m_mesh_pipeline_id;
+    uint32_t m_instanced_mesh_pipeline_id;
+    uint32_t m_particle_pipeline_id;
+    std::vector<VkCommandBuffer> m_command_buffers;
+    std::unique_ptr<FrameCapture> m_capture;
+    bool m_capture_failed = false;
+    UploadQueue m_uploader { m_device };
+    std::unique_ptr<Mesh> m_mesh;
+    std::unique_ptr<SceneObjects> m_objects;
+    uint32_t m_visible_objects = 0;
+    bool m_use_gpu_culling = false;
+    std::unique_ptr<GpuCulling> m_gpu_culling;
+    // The mesh LOD this frame's cull wrote commands for, and what the draw source buffer holds.
+    DrawItem m_gpu_mesh_item;
+    bool m_gpu_mesh_culled = false;
+    GpuDrawSource m_gpu_draw_source {};
+    Autotuner m_tuner { m_device };
+    ParticleSimulation m_particles { m_device };
+    std::unique_ptr<Pipeline> m_particle_pipeline;
+    GpuProfiler m_profiler { m_device, SwapChain::MAX_FRAMES_IN_FLIGHT };
+    std::chrono::steady_clock::time_point m_last_frame_time = std::chrono::steady_clock::now();
+    FrameLimiter m_limiter {};
+    bool m_paused = false;
+
+    bool m_print_stats = false;
+    uint32_t m_stats_frames = 0;
+    double m_stats_seconds = 0.0;
+    double m_stats_graphics_ms = 0.0;
+    double m_stats_simulation_ms = 0.0;
+    uint64_t m_stats_draw_calls = 0;
+    uint64_t m_stats_state_changes = 0;
+    uint64_t m_stats_visible_objects = 0;
 };
 } // namespace Simulation
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "ComputePipeline.hpp"
+#include "Device.hpp"
+#include "GpuProfiler.hpp"
+#include "Specialization.hpp"
+
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// One tunable specialization constant and the values worth trying for it: workgroup or tile sizes, unroll factors,
+// 0/1 feature toggles, ...
+struct TuningParameter {
+    std::string name;
+    uint32_t constant_id;
+    std::vector<uint32_t> values;
+};
+
+// Picks specialization constants per kernel and per device. With tuning enabled every combination of the parameter
+// values is built, timed on this device, and the fastest is stored in the cache file under the device and driver
+// UUIDs; with tuning disabled the cached winner is used when there is one and the first value of every
+// parameter otherwise, so nothing is measured at startup.
+class Autotuner {
+public:
+    // Records one run of the kernel with `pipeline` bound; `constants` are the variant's values, e.g. to size the
+    // dispatch for its workgroup.
+    using RecordFn = std::function<void(VkCommandBuffer, ComputePipeline&, const SpecializationConstants&)>;
+
+    Autotuner(Device& device, const std::string& cache_path = "autotune.cache");
+
+    Autotuner(const Autotuner&) = delete;
+    void operator=(const Autotuner&) = delete;
+
+    // Also re-measure kernels that already have a cached winner.
+    void set_tuning(bool enabled, bool retune = false);
+    bool tuning() { return m_tuning; }
+    // Whether select() for `kernel` would measure rather than answer from the cache or the defaults; lets callers
+    // skip preparing benchmark inputs.
+    bool needs_tuning(const std::string& kernel);
+
+    // The variants run on the graphics queue, or on the compute queue when `compute_queue` is set, which must be the
+    // queue family that owns the buffers `record` uses.
+    SpecializationConstants select(const std::string& kernel, std::span<const uint32_t> code,
+        VkPipelineLayout pipeline_layout, const std::vector<TuningParameter>& space, const RecordFn& record,
+        bool compute_queue = false, uint32_t repetitions = 5);
+
+private:
+    double measure(std::span<const uint32_t> code, VkPipelineLayout pipeline_layout,
+        const SpecializationConstants& constants, const RecordFn& record, bool compute_queue, uint32_t repetitions);
+    void load();
+    void save();
+
+    Device& m_device;
+    std::string m_cache_path;
+    std::string m_device_key;
+    bool m_tuning = false;
+    bool m_retune = false;
+    GpuProfiler m_profiler;
+    // (device key, kernel) -> SpecializationConstants::to_string() of the winner
+    std::map<std::pair<std::string, std::string>, std::string> m_cache;
+};
+
+} // namespace Simulation
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Simulation {
+
+// Particle with an id that survives reordering. Also the wire format of DistributedSimulation's halo and migration
+// messages.
+struct DomainParticle {
+    glm::vec3 position;
+    uint32_t id;
+    glm::vec3 velocity;
+    uint32_t padding;
+};
+
+// Uniform grid of cells no smaller than the cutoff, so a particle's neighbours are all in the 27 cells around it.
+// Built by a counting sort; `order` lists particle indices cell by cell.
+struct CellGrid {
+    static constexpr int MAX_CELLS_PER_AXIS = 128;
+
+    glm::vec3 origin;
+    glm::vec3 cell_size;
+    glm::ivec3 dims;
+    std::vector<uint32_t> starts;
+    std::vector<uint32_t> order;
+
+    void build(const std::vector<DomainParticle>& particles, float cutoff);
+    // Put `particles`, which the grid was built from, into cell order so neighbours are close in memory.
+    void sort(std::vector<DomainParticle>& particles);
+    glm::ivec3 cell_of(const glm::vec3& position) const;
+
+    template <typename Fn>
+    void for_each_near(const glm::vec3& position, const std::vector<DomainParticle>& particles, Fn&& fn) const
+    {
+        glm::ivec3 center = cell_of(position);
+        glm::ivec3 lo = glm::max(center - 1, glm::ivec3(0));
+        glm::ivec3 hi = glm::min(center + 1, dims - 1);
+        for (int z = lo.z; z <= hi.z; z++) {
+            for (int y = lo.y; y <= hi.y; y++) {
+                // Cells along x are contiguous in `order`.
+                uint32_t row = static_cast<uint32_t>((z * dims.y + y) * dims.x);
+                for (uint32_t slot = starts[row + lo.x]; slot < starts[row + hi.x + 1]; slot++) {
+                    fn(particles[order[slot]]);
+                }
+            }
+        }
+    }
+};
+
+} // namespace Simulation
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Specialization.hpp"
+
+#include <cstdint>
+#include <span>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+class ComputePipeline {
+public:
+    ComputePipeline(Device& device, std::span<const uint32_t> code, VkPipelineLayout pipeline_layout,
+        const SpecializationConstants& specialization = {});
+    ~ComputePipeline();
+
+    ComputePipeline(const ComputePipeline&) = delete;
+    void operator=(const ComputePipeline&) = delete;
+
+    void bind(VkCommandBuffer command_buffer);
+    VkPipeline pipeline() { return m_pipeline; }
+
+    static uint32_t group_count(uint32_t invocations, uint32_t group_size)
+    {
+        return (invocations + group_size - 1) / group_size;
+    }
+
+private:
+    void create_compute_pipeline(std::span<const uint32_t> code, VkPipelineLayout pipeline_layout,
+        const SpecializationConstants& specialization);
+
+    Device& m_device;
+    VkPipeline m_pipeline;
+    VkShaderModule m_shader_module;
+};
+} // namespace Simulation
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Simulation {
+
+// Extended position-based dynamics (XPBD) for point bodies joined by distance constraints and resting on a ground
+// plane at y = 0. Gauss-Seidel over all constraints does not parallelise, so the constraint graph is colored: no
+// two constraints of a color share a dynamic body, which makes each color one parallel loop while consecutive
+// colors still see each other's corrections. Rows are stored structure-of-arrays and grouped by color, so a
+// color is a contiguous range of every row array.
+//
+// Bodies connected by constraints form islands. An island whose bodies all stay below `sleep_speed` for
+// `sleep_steps` steps falls asleep and is left out of the batches until one of its bodies is woken.
+class ConstraintSolver {
+public:
+    struct Config {
+        glm::vec3 gravity = { 0.0f, -9.81f, 0.0f };
+        uint32_t iterations = 10;
+        float radius = 0.01f; // of every body, for ground contact
+        float friction = 0.5f; // fraction of the sliding on the ground undone per iteration
+        float sleep_speed = 0.02f;
+        uint32_t sleep_steps = 60;
+    };
+
+    ConstraintSolver(ThreadPool& pool, const Config& config);
+
+    ConstraintSolver(const ConstraintSolver&) = delete;
+    void operator=(const ConstraintSolver&) = delete;
+
+    // An inverse mass of 0 makes the body static. Adding bodies or constraints wakes every island.
+    uint32_t add_body(const glm::vec3& position, float inverse_mass);
+    // The rest length is the current distance between the bodies.
+    void add_distance(uint32_t a, uint32_t b, float compliance = 0.0f);
+    void wake(uint32_t body);
+
+    void step(float dt);
+
+    glm::vec3 position(uint32_t body) { return { m_x[body], m_y[body], m_z[body] }; }
+    bool asleep(uint32_t body);
+    uint32_t body_count() { return static_cast<uint32_t>(m_x.size()); }
+    uint32_t constraint_count() { return static_cast<uint32_t>(m_constraints.size()); }
+    uint32_t awake_body_count() { return static_cast<uint32_t>(m_awake_bodies.size()); }
+    uint32_t island_count() { return static_cast<uint32_t>(m_island_asleep.size()); }
+    // Colors of the current batches, which hold only the constraints of awake islands.
+    uint32_t color_count() { return static_cast<uint32_t>(m_color_starts.size()) - 1; }
+
+private:
+    struct Constraint {
+        uint32_t a;
+        uint32_t b;
+        float rest_length;
+        float compliance;
+    };
+
+    // Color c is rows [m_color_starts[c], m_color_starts[c + 1]).
+    struct Rows {
+        std::vector<uint32_t> a;
+        std::vector<uint32_t> b;
+        std::vector<float> rest_length;
+        std::vector<float> compliance;
+        std::vector<float> lambda;
+    };
+
+    static constexpr uint32_t NO_ISLAND = ~0u;
+    static constexpr uint32_t MAX_COLORS = 64;
+
+    void build_islands();
+    void build_batches();
+    void solve_rows(uint32_t begin, uint32_t end, float inverse_dt_squared);
+    void solve_ground(uint32_t begin, uint32_t end);
+    void update_sleep();
+
+    ThreadPool& m_pool;
+    Config m_config;
+
+    // Bodies, structure-of-arrays; p is the position at the start of the step.
+    std::vector<float> m_x, m_y, m_z;
+    std::vector<float> m_px, m_py, m_pz;
+    std::vector<float> m_vx, m_vy, m_vz;
+    std::vector<float> m_inverse_mass;
+    std::vector<uint32_t> m_island; // NO_ISLAND for static bodies
+
+    std::vector<Constraint> m_constraints;
+    std::vector<uint8_t> m_island_asleep;
+    std::vector<uint32_t> m_island_still_steps;
+
+    Rows m_rows;
+    std::vector<uint32_t> m_color_starts = { 0 };
+    std::vector<uint32_t> m_awake_bodies;
+
+    bool m_islands_dirty = false;
+    bool m_batches_dirty = false;
+};
+
+} // namespace Simulation
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Simulation {
+
+// Axis-aligned boxes stored as one array per component so four of them can be tested per SIMD instruction.
+struct AabbSoA {
+    std::vector<float> min_x, min_y, min_z;
+    std::vector<float> max_x, max_y, max_z;
+
+    uint32_t size() const { return static_cast<uint32_t>(min_x.size()); }
+    void resize(uint32_t count);
+    void set(uint32_t index, const glm::vec3& min, const glm::vec3& max);
+};
+
+struct Frustum {
+    // Planes as (normal, distance) with the normal pointing inwards; a point p is inside when dot(n, p) + d >= 0.
+    glm::vec4 planes[6];
+
+    // Extract the planes from a Vulkan (zero to one depth) view-projection matrix.
+    static Frustum from_matrix(const glm::mat4& view_projection);
+};
+
+// Bounding volume hierarchy over simulation objects. The tree topology is built once and refit every tick from the
+// objects' current boxes, which is linear in the object count; rebuild() is only needed when refitting has let the
+// tree degrade (see needs_rebuild()).
+class Bvh {
+public:
+    static constexpr uint32_t LEAF_SIZE = 8;
+
+    void build(const AabbSoA& boxes);
+    void refit(const AabbSoA& boxes);
+    bool needs_rebuild() const;
+
+    // Test every object against the frustum on the pool's threads and write the visible ones, compacted, to `dst`.
+    // With `src_instances` each visible object's `stride`-byte record is copied (e.g. straight into a mapped
+    // instance buffer); without it the object indices are written as uint32_t. Returns the visible count, at most
+    // `capacity`.
+    uint32_t cull(const Frustum& frustum, ThreadPool& pool, void* dst, uint32_t capacity,
+        const void* src_instances = nullptr, uint32_t stride = sizeof(uint32_t)) const;
+
+    uint32_t object_count() const { return static_cast<uint32_t>(m_order.size()); }
+
+private:
+    struct Node {
+        glm::vec3 min;
+        uint32_t first; // first child for inner nodes, first object slot for leaves
+        glm::vec3 max;
+        uint32_t count; // 0 for inner nodes, object count for leaves
+    };
+
+    void build_node(uint32_t node, uint32_t begin, uint32_t end, const std::vector<glm::vec3>& centers);
+    void cull_node(const Frustum& frustum, uint32_t node, std::vector<uint32_t>& visible) const;
+    void cull_leaf(const Frustum& frustum, const Node& leaf, std::vector<uint32_t>& visible) const;
+    void accept_all(const Node& node, std::vector<uint32_t>& visible) const;
+    float surface_area(const Node& node) const;
+
+    std::vector<Node> m_nodes;
+    // Object indices in leaf order, and their boxes gathered into that order by refit(). The boxes are padded by
+    // three so leaf tests can load whole SIMD lanes from any leaf start.
+    std::vector<uint32_t> m_order;
+    AabbSoA m_leaf_boxes;
+    float m_area = 0.0f; // summed over all nodes
+    float m_built_area = 0.0f;
+};
+
+} // namespace Simulation
@@ -1 +1,120 @@
 #pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU trace zones. Built with SIM_ENABLE_TRACING (the CMake option of the same name), SIM_TRACE_ZONE("name")
+// records the time from the macro to the end of the enclosing scope into the calling thread's trace buffer while
+// Trace is enabled; without it the macros expand to nothing. Names must be string literals.
+#ifdef SIM_ENABLE_TRACING
+#define SIM_TRACE_JOIN_(a, b) a##b
+#define SIM_TRACE_JOIN(a, b) SIM_TRACE_JOIN_(a, b)
+#define SIM_TRACE_ZONE(name) ::Simulation::TraceZone SIM_TRACE_JOIN(sim_trace_zone_, __LINE__) { name }
+#define SIM_TRACE_THREAD(name) ::Simulation::Trace::instance().set_thread_name(name)
+#else
+#define SIM_TRACE_ZONE(name) static_cast<void>(0)
+#define SIM_TRACE_THREAD(name) static_cast<void>(0)
+#endif
+
+namespace Simulation {
+
+// Process-wide recorder of CPU zones and GPU scopes, written out as Chrome trace JSON for chrome://tracing or
+// ui.perfetto.dev. Each thread appends to its own buffer of fixed-size chunks and publishes the new event count with
+// a release store, so recording takes no lock and write() can run while other threads keep recording. Only a
+// thread's first event takes the registry lock. A thread that has filled MAX_CHUNKS drops further events and counts
+// them. GPU scopes arrive a few frames late from GpuProfiler::collect() and go through a mutex.
+//
+// Timestamps are steady_clock nanoseconds; GPU timestamps are converted to the same clock (see GpuProfiler), so both
+// end up on one timeline.
+class Trace {
+public:
+    static constexpr uint32_t CHUNK_EVENTS = 16 * 1024;
+    static constexpr uint32_t MAX_CHUNKS = 64; // per thread
+    static constexpr uint32_t MAX_GPU_EVENTS = 1024 * 1024;
+
+    static Trace& instance();
+    static uint64_t now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    Trace(const Trace&) = delete;
+    void operator=(const Trace&) = delete;
+
+    // Recording is off until enabled, so an instrumented build only pays for a relaxed load per zone by default.
+    void set_enabled(bool enabled) { m_enabled.store(enabled, std::memory_order_relaxed); }
+    bool enabled() { return m_enabled.load(std::memory_order_relaxed); }
+
+    void set_thread_name(const std::string& name);
+    void record(const char* name, uint64_t begin, uint64_t end);
+    // `track` becomes a row of the GPU process in the trace.
+    void record_gpu(const std::string& track, const std::string& name, uint64_t begin, uint64_t end);
+
+    // Write everything recorded so far. Returns the number of events written.
+    uint64_t write(const std::string& path);
+    uint64_t dropped();
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+    struct ThreadBuffer {
+        uint32_t id;
+        std::string name;
+        std::unique_ptr<Event[]> chunks[MAX_CHUNKS];
+        std::atomic<uint32_t> count { 0 };
+        std::atomic<uint64_t> dropped { 0 };
+    };
+    struct GpuEvent {
+        std::string track;
+        std::string name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    Trace() = default;
+
+    ThreadBuffer& thread_buffer();
+
+    std::atomic<bool> m_enabled { false };
+    std::mutex m_mutex; // guards everything below
+    std::vector<std::unique_ptr<ThreadBuffer>> m_threads;
+    std::vector<GpuEvent> m_gpu_events;
+    uint64_t m_gpu_dropped = 0;
+};
+
+// Records its lifetime as a zone; use SIM_TRACE_ZONE instead of naming one.
+class TraceZone {
+public:
+    explicit TraceZone(const char* name)
+        : m_name { name }
+        , m_begin { Trace::instance().enabled() ? Trace::now() : NOT_RECORDING }
+    {
+    }
+    ~TraceZone()
+    {
+        if (m_begin != NOT_RECORDING) {
+            Trace::instance().record(m_name, m_begin, Trace::now());
+        }
+    }
+
+    TraceZone(const TraceZone&) = delete;
+    void operator=(const TraceZone&) = delete;
+
+private:
+    static constexpr uint64_t NOT_RECORDING = ~0ull;
+
+    const char* m_name;
+    uint64_t m_begin;
+};
+
+} // namespace Simulation
@@ -2,12 +2,15 @@
 
 #include "Window.hpp"
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace Simulation {
 
+class TimelineSemaphore;
+
 struct SwapChainSupportDetails {
     VkSurfaceCapabilitiesKHR capabilities;
     std::vector<VkSurfaceFormatKHR> formats;
@@ -17,6 +20,8 @@ struct SwapChainSupportDetails {
 struct QueueFamilyIndicies {
     uint32_t graphics_family;
     uint32_t present_family;
+    // A compute-only family when the device has one, otherwise the graphics family.
+    uint32_t compute_family;
     bool graphics_family_has_value = false;
     bool present_family_has_value = false;
     bool is_complete() { return graphics_family_has_value && present_family_has_value; }
@@ -31,6 +36,8 @@ public:
 #endif
 
     Device(Window& window);
+    // Without a window: no surface or swapchain, for batch runs on machines without a display.
+    Device();
     ~Device();
 
     // Not copyable or movable
@@ -42,8 +49,33 @@ public:
     VkCommandPool get_command_pool() { return m_command_pool; }
     VkDevice device() { return m_device; }
     VkSurfaceKHR surface() { return m_surface; };
+    bool headless() { return m_window == nullptr; }
     VkQueue graphics_queue() { return m_graphics_queue; }
     VkQueue present_queue() { return m_present_queue; }
+    // Without a dedicated compute family this is the graphics queue, and work submitted to it runs in order with
+    // graphics work instead of alongside it.
+    VkQueue compute_queue() { return m_compute_queue; }
+    bool has_async_compute() { return m_compute_family != m_graphics_family; }
+    uint32_t graphics_family() { return m_graphics_family; }
+    uint32_t compute_family() { return m_compute_family; }
+    const VkPhysicalDeviceFeatures& enabled_features() { return m_enabled_features; }
+    bool supports_draw_indirect_count() { return m_draw_indirect_count; }
+    // Whether compute shaders can use GL_KHR_shader_subgroup_arithmetic and GL_KHR_shader_subgroup_ballot.
+    bool supports_subgroup_arithmetic() { return m_subgroup_arithmetic; }
+    // Stable across runs for the same GPU and driver build respectively.
+    const uint8_t* device_uuid() { return m_device_uuid; }
+    const uint8_t* driver_uuid() { return m_driver_uuid; }
+
+    // Every graphics queue submission signals the next value of this semaphore.
+    TimelineSemaphore& graphics_timeline() { return *m_graphics_timeline; }
+    // Every compute queue submission signals the next value of this one.
+    TimelineSemaphore& compute_timeline() { return *m_compute_timeline; }
+    // Submit to the graphics or compute queue, waiting on and signaling `waits`/`signals` in addition to the queue's
+    // timeline. Returns the timeline value the submission signals.
+    uint64_t submit_graphics(const std::vector<VkCommandBuffer>& command_buffers,
+        const std::vector<VkSemaphoreSubmitInfo>& waits = {}, const std::vector<VkSemaphoreSubmitInfo>& signals = {});
+    uint64_t submit_compute(const std::vector<VkCommandBuffer>& command_buffers,
+        const std::vector<VkSemaphoreSubmitInfo>& waits = {}, const std::vector<VkSemaphoreSubmitInfo>& signals = {});
 
     SwapChainSupportDetails get_swap_chain_support() { return query_swap_chain_support(m_physical_device); }
     uint32_t find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags properties);
@@ -53,21 +85,32 @@ public:
 
     void create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer,
         VkDeviceMemory& buffer_memory);
-    VkCommandBuffer begin_single_time_commands();
-    void end_single_time_commands(VkCommandBuffer command_buffer);
+    // Recorded and submitted on the graphics queue, or on the compute queue for work on buffers that family owns.
+    VkCommandBuffer begin_single_time_commands(bool compute_queue = false);
+    void end_single_time_commands(VkCommandBuffer command_buffer, bool compute_queue = false);
     void copy_buffer(VkBuffer src, VkBuffer dest, VkDeviceSize size);
     void copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layer_count);
     void create_image_with_info(const VkImageCreateInfo& image_info, VkMemoryPropertyFlags properties, VkImage& image,
         VkDeviceMemory& image_memory);
+    // Whether calibrate_timestamps() works (VK_EXT_calibrated_timestamps with the CLOCK_MONOTONIC domain).
+    bool has_calibrated_timestamps() { return m_get_calibrated_timestamps != nullptr; }
+    // Sample the device timestamp counter and CLOCK_MONOTONIC, which steady_clock uses, at the same instant.
+    bool calibrate_timestamps(uint64_t& gpu_ticks, uint64_t& cpu_nanoseconds);
+    // Only valid when supports_draw_indirect_count() is true.
+    void cmd_draw_indexed_indirect_count(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset,
+        VkBuffer count_buffer, VkDeviceSize count_offset, uint32_t max_draw_count, uint32_t stride);
     VkPhysicalDeviceProperties properties;
 
 private:
+    void init();
     void create_instance();
     void setup_debug_messenger();
     void create_surface();
     void pick_physcial_device();
     void create_logical_device();
     void create_command_pool();
+    uint64_t submit(VkQueue queue, TimelineSemaphore& timeline, const std::vector<VkCommandBuffer>& command_buffers,
+        const std::vector<VkSemaphoreSubmitInfo>& waits, const std::vector<VkSemaphoreSubmitInfo>& signals);
     // helper methods
     bool is_device_suitable(VkPhysicalDevice device);
     std::vector<const char*> get_required_ext();
@@ -76,21 +119,36 @@ private:
     void populate_debug_messanger_create_info(VkDebugUtilsMessengerCreateInfoEXT& create_info);
     void has_glfw_required_ext();
     bool check_device_ext_support(VkPhysicalDevice device);
+    bool check_optional_ext_support(VkPhysicalDevice device, const char* extension);
+    bool supports_monotonic_time_domain(VkPhysicalDevice device);
     SwapChainSupportDetails query_swap_chain_support(VkPhysicalDevice device);
 
     // private members
     VkInstance m_instance;
     VkDebugUtilsMessengerEXT m_debug_messenger;
-    VkPhysicalDevice m_physical_device;
+    VkPhysicalDevice m_physical_device = VK_NULL_HANDLE;
     VkCommandPool m_command_pool;
-    Window& m_window;
+    VkCommandPool m_compute_command_pool;
+    Window* m_window;
     VkDevice m_device;
-    VkSurfaceKHR m_surface;
+    VkSurfaceKHR m_surface = VK_NULL_HANDLE;
     VkQueue m_graphics_queue;
     VkQueue m_present_queue;
+    VkQueue m_compute_queue;
+    uint32_t m_graphics_family;
+    uint32_t m_compute_family;
+    VkPhysicalDeviceFeatures m_enabled_features {};
+    bool m_draw_indirect_count = false;
+    bool m_calibrated_timestamps = false;
+    bool m_subgroup_arithmetic = false;
+    PFN_vkGetCalibratedTimestampsEXT m_get_calibrated_timestamps = nullptr;
+    uint8_t m_device_uuid[VK_UUID_SIZE] {};
+    uint8_t m_driver_uuid[VK_UUID_SIZE] {};
+    std::unique_ptr<TimelineSemaphore> m_graphics_timeline;
+    std::unique_ptr<TimelineSemaphore> m_compute_timeline;
 
     const std::vector<const char*> m_validation_layers = { "VK_LAYER_KHRONOS_validation" };
-    const std::vector<const char*> m_device_ext = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+    std::vector<const char*> m_device_ext = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 };
 
 } // namespace Simulation
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "CellGrid.hpp"
+#include "ThreadPool.hpp"
+#include "Transport.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Simulation {
+
+// Particle simulation split across the ranks of a Transport by slabs along x, so no process has to hold all of
+// it. Particles feel the attractor plus a short-range repulsion from everything within `cutoff`, which is what
+// needs the halo: each tick every rank sends the particles within `cutoff` of its slab edges to its neighbours,
+// computes its interior particles while those are in flight, then finishes the particles near the edges against
+// the received halo. Particles that leave the slab migrate to the neighbour; every `rebalance_interval` ticks the
+// slab edges are moved to the quantiles of a global x histogram so each rank holds about the same number.
+class DistributedSimulation {
+public:
+    struct Config {
+        uint32_t particle_count = 256 * 1024; // over all ranks
+        float dt = 0.002f;
+        float strength = 0.05f; // attractor at the origin
+        float cutoff = 0.01f;
+        float stiffness = 2.0f;
+        float extent = 1.5f; // the histogram covers [-extent, extent); particles beyond count in the end bins
+        uint32_t rebalance_interval = 50;
+        uint32_t seed = 1234;
+    };
+
+    // Collective: every rank of `transport` must construct one with the same config.
+    DistributedSimulation(Transport& transport, ThreadPool& pool, const Config& config);
+
+    DistributedSimulation(const DistributedSimulation&) = delete;
+    void operator=(const DistributedSimulation&) = delete;
+
+    // Collective, like rebalance() and global_count().
+    void step();
+    void rebalance();
+    uint64_t global_count();
+
+    uint64_t tick() { return m_tick; }
+    uint32_t local_count() { return static_cast<uint32_t>(m_particles.size()); }
+    uint32_t halo_count() { return static_cast<uint32_t>(m_halo.size()); }
+    float slab_begin();
+    float slab_end();
+    // Time step() spent blocked on halo messages, i.e. what the interior computation did not hide.
+    double halo_wait_seconds() { return m_halo_wait_seconds; }
+
+private:
+    enum Tag : uint32_t {
+        TAG_HALO = 1,
+        TAG_MIGRATE,
+        TAG_REDUCE,
+        TAG_BROADCAST,
+    };
+
+    static constexpr uint32_t HISTOGRAM_BINS = 1024;
+
+    uint32_t owner(float x);
+    glm::vec3 acceleration(const DomainParticle& particle, bool with_halo) const;
+    void accelerate(const std::vector<uint32_t>& indices, bool with_halo);
+    // Neighbour-only after a tick; to any rank after the slab edges have moved.
+    void migrate(bool all_ranks);
+    // Element-wise sum over all ranks, gathered on rank 0 and broadcast back.
+    std::vector<uint64_t> all_reduce_sum(std::vector<uint64_t> values);
+
+    Transport& m_transport;
+    ThreadPool& m_pool;
+    Config m_config;
+
+    // Rank r owns x in [m_cuts[r - 1], m_cuts[r]); the first and last slabs are open-ended.
+    std::vector<float> m_cuts;
+    std::vector<DomainParticle> m_particles;
+    std::vector<DomainParticle> m_halo;
+    std::vector<glm::vec3> m_accelerations;
+    std::vector<uint32_t> m_interior;
+    std::vector<uint32_t> m_edge;
+    CellGrid m_local_grid;
+    CellGrid m_halo_grid;
+
+    uint64_t m_tick = 0;
+    double m_halo_wait_seconds = 0.0;
+};
+
+} // namespace Simulation
@@ -0,0 +1,122 @@
+#pragma once
+
+#include "Device.hpp"
+#include "Pipeline.hpp"
+#include "ThreadPool.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Geometry of one draw. Without an index buffer it is a vkCmdDraw of `count` vertices from `first`; without a
+// vertex buffer nothing is bound at binding 0, and without an instance buffer nothing at binding 1.
+struct DrawItem {
+    VkBuffer vertex_buffer = VK_NULL_HANDLE;
+    VkDeviceSize vertex_offset = 0;
+    VkBuffer instance_buffer = VK_NULL_HANDLE;
+    VkDeviceSize instance_offset = 0;
+    VkBuffer index_buffer = VK_NULL_HANDLE;
+    VkDeviceSize index_offset = 0;
+    VkIndexType index_type = VK_INDEX_TYPE_UINT32;
+    uint32_t count = 0; // vertices, or indices when indexed
+    uint32_t first = 0;
+    int32_t base_vertex = 0;
+    uint32_t instance_count = 1;
+    uint32_t first_instance = 0;
+};
+
+// Draw submission front end. Draws are pushed in any order with a 64-bit sort key, most significant first:
+//
+//   pass (4 bits) | pipeline (12) | material (16) | depth (32)
+//
+// submit() radix-sorts the keys, then walks them keeping track of the bound state, so every pipeline, descriptor
+// set, buffer and push constant change is recorded once per run of draws that share it. Within a run, draws of the
+// same geometry with consecutive instances become one instanced draw, and the remaining draws become a single
+// multi-draw indirect call when the device supports it. Draws only batch when they are adjacent after sorting, so
+// passes that do not need depth order should use depth 0.
+class DrawQueue {
+public:
+    static constexpr uint32_t PASS_BITS = 4;
+    static constexpr uint32_t PIPELINE_BITS = 12;
+    static constexpr uint32_t MATERIAL_BITS = 16;
+    static constexpr uint32_t MAX_INDIRECT_COMMANDS = 4096; // per frame; draws beyond it are recorded directly
+
+    // Per submit(); everything but `draws` counts recorded commands.
+    struct Stats {
+        uint32_t draws;
+        uint32_t draw_calls;
+        uint32_t pipeline_binds;
+        uint32_t descriptor_binds;
+        uint32_t buffer_binds;
+        uint32_t push_constant_updates;
+
+        uint32_t state_changes() const
+        {
+            return pipeline_binds + descriptor_binds + buffer_binds + push_constant_updates;
+        }
+    };
+
+    DrawQueue(Device& device, ThreadPool& pool, uint32_t frames_in_flight);
+    ~DrawQueue();
+
+    DrawQueue(const DrawQueue&) = delete;
+    void operator=(const DrawQueue&) = delete;
+
+    // Non-negative depth; larger depths sort later unless `back_to_front`.
+    static uint64_t make_key(
+        uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool back_to_front = false);
+
+    uint32_t add_pipeline(Pipeline& pipeline, VkPipelineLayout layout, VkShaderStageFlags push_stages);
+    // Bound as set 0 of the pipeline's layout. Material 0 binds nothing.
+    uint32_t add_material(VkDescriptorSet descriptor_set);
+
+    // The push constants are copied; they are pushed at offset 0 for the pipeline's push stages.
+    void push(uint64_t key, const DrawItem& item, const void* push_constants = nullptr, uint32_t push_size = 0);
+    // Sort, batch and record everything pushed since the last submit() into `command_buffer`, which must be
+    // inside a render pass compatible with the pipelines. `frame_index` picks the indirect buffer, which must no
+    // longer be in use by the GPU.
+    void submit(VkCommandBuffer command_buffer, uint32_t frame_index);
+
+    const Stats& last_stats() { return m_stats; }
+
+private:
+    struct Entry {
+        DrawItem item;
+        uint32_t push_offset;
+        uint32_t push_size;
+    };
+    struct PipelineSlot {
+        Pipeline* pipeline;
+        VkPipelineLayout layout;
+        VkShaderStageFlags push_stages;
+    };
+
+    // Stable LSD radix sort of m_keys, carrying m_order along.
+    void sort();
+    bool same_state(const Entry& a, const Entry& b);
+
+    Device& m_device;
+    ThreadPool& m_pool;
+    bool m_multi_draw;
+
+    std::vector<PipelineSlot> m_pipelines;
+    std::vector<VkDescriptorSet> m_materials = { VK_NULL_HANDLE };
+
+    std::vector<uint64_t> m_keys;
+    std::vector<uint32_t> m_order;
+    std::vector<Entry> m_entries;
+    std::vector<uint8_t> m_push_data;
+    std::vector<uint64_t> m_scratch_keys;
+    std::vector<uint32_t> m_scratch_order;
+
+    // Persistently mapped, one region of MAX_INDIRECT_COMMANDS per frame in flight.
+    VkBuffer m_indirect_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory m_indirect_memory = VK_NULL_HANDLE;
+    uint8_t* m_indirect_mapped = nullptr;
+
+    Stats m_stats {};
+};
+
+} // namespace Simulation
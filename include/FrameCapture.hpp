@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// On-disk layout of a capture stream: every record is a FRAME_SINK_BLOCK sized header followed by the payload
+// padded to a whole number of blocks, so the file can be written with O_DIRECT and read back with plain seeks.
+struct CaptureRecordHeader {
+    static constexpr uint32_t MAGIC = 0x50414353; // "SCAP"
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t frame;
+    uint32_t width;
+    uint32_t height;
+    uint32_t format;
+    uint32_t row_pitch;
+    uint64_t payload_size;
+    uint64_t padded_size;
+};
+
+// Background writer that streams raw records to a single file with large sequential writes. Payloads are written
+// straight out of the memory they are handed and the caller is told when it may reuse that memory.
+class FrameSink {
+public:
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    struct Record {
+        CaptureRecordHeader header;
+        const void* data;
+        uint32_t slot;
+    };
+
+    FrameSink(const std::string& path, std::atomic<uint32_t>* slot_states);
+    ~FrameSink();
+
+    FrameSink(const FrameSink&) = delete;
+    void operator=(const FrameSink&) = delete;
+
+    void push(const Record& record);
+    bool direct_io() { return m_direct_io; }
+    uint64_t bytes_written() { return m_bytes_written.load(std::memory_order_relaxed); }
+    // Set after the first failed write. A partial record would leave every later one misaligned, so from then on
+    // records are dropped and their slots handed straight back.
+    bool failed() { return m_failed.load(std::memory_order_relaxed); }
+
+private:
+    void writer_loop();
+    bool write_record(const Record& record);
+    bool write_fully(const void* data, size_t size);
+
+    int m_fd = -1;
+    bool m_direct_io = false;
+    void* m_bounce_buffer = nullptr;
+    size_t m_bounce_size = 0;
+
+    std::atomic<uint32_t>* m_slot_states;
+    std::atomic<uint64_t> m_bytes_written { 0 };
+    std::atomic<bool> m_failed { false };
+
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::deque<Record> m_queue;
+    bool m_stop = false;
+    std::thread m_thread;
+};
+
+// Ring of host-visible, host-cached readback buffers. Copies are recorded into the frame's own command buffer, so
+// capturing adds no submits or waits; a slot is handed to the FrameSink once the frame it was recorded in has
+// completed and comes back to the ring after the writer is done with it. When every slot is busy the frame is
+// dropped rather than stalling the render loop.
+class FrameCapture {
+public:
+    static constexpr uint32_t DEFAULT_SLOT_COUNT = 6;
+
+    FrameCapture(Device& device, const std::string& path, VkDeviceSize slot_size,
+        uint32_t slot_count = DEFAULT_SLOT_COUNT);
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture&) = delete;
+    void operator=(const FrameCapture&) = delete;
+
+    // Copy a color image into a free slot. The image is expected in `layout` and is returned to it afterwards.
+    bool record_image(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout, VkFormat format,
+        VkExtent2D extent, uint64_t frame);
+    // Copy a buffer (e.g. a simulation field) into a free slot.
+    bool record_buffer(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize size, uint64_t frame);
+
+    // Hand every slot whose frame is <= completed_frame to the writer. Never blocks.
+    void poll(uint64_t completed_frame);
+
+    uint64_t captured_frames() { return m_captured; }
+    uint64_t dropped_frames() { return m_dropped; }
+    // The file could not be written; nothing more is captured.
+    bool failed() { return m_sink.failed(); }
+
+    static uint32_t texel_size(VkFormat format);
+
+private:
+    enum SlotState : uint32_t {
+        SLOT_FREE,
+        SLOT_RECORDED,
+        SLOT_WRITING,
+    };
+
+    struct Slot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        CaptureRecordHeader header {};
+    };
+
+    int acquire_slot();
+
+    Device& m_device;
+    VkDeviceSize m_slot_size;
+    bool m_coherent = false;
+
+    std::vector<Slot> m_slots;
+    std::vector<std::atomic<uint32_t>> m_slot_states;
+    uint32_t m_next_slot = 0;
+
+    uint64_t m_captured = 0;
+    uint64_t m_dropped = 0;
+
+    FrameSink m_sink;
+};
+
+} // namespace Simulation
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+
+namespace Simulation {
+
+// Paces a loop to a fixed rate. The OS sleep is only accurate to a scheduler tick, so wait() sleeps until shortly
+// before the deadline and spins the rest. Deadlines advance by whole intervals so the rate does not drift, but a
+// loop that falls more than one interval behind starts over from now instead of catching up with a burst.
+class FrameLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A rate of 0 disables the cap.
+    explicit FrameLimiter(double frames_per_second = 0.0);
+
+    void set_rate(double frames_per_second);
+    double rate() { return m_rate; }
+
+    // Block until the next frame is due.
+    void wait();
+    // Let the next wait() return immediately, e.g. after the loop was idle.
+    void reset() { m_next = Clock::time_point {}; }
+
+private:
+    static constexpr std::chrono::microseconds SPIN_MARGIN { 1500 };
+
+    double m_rate = 0.0;
+    Clock::duration m_interval {};
+    Clock::time_point m_next {};
+};
+
+} // namespace Simulation
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Autotuner.hpp"
+#include "ComputePipeline.hpp"
+#include "Device.hpp"
+#include "SwapChain.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <span>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Per-object input to the cull shader. `draw` indexes the GpuDrawSource that says which index range to draw.
+struct GpuInstance {
+    glm::vec4 bounding_sphere;
+    uint32_t draw;
+    uint32_t padding[3];
+};
+
+// Where a mesh lives in the shared vertex/index buffers.
+struct GpuDrawSource {
+    uint32_t index_count;
+    uint32_t first_index;
+    int32_t vertex_offset;
+    uint32_t padding;
+};
+
+// GPU-driven culling: a compute pass tests every instance against the frustum and, optionally, a Hi-Z pyramid built
+// from last frame's depth buffer, then writes VkDrawIndexedIndirectCommands plus a draw count. The CPU records the
+// same handful of commands each frame however many instances there are. Each emitted draw has one instance whose
+// firstInstance is the instance index, so vertex shaders fetch their GpuInstance with gl_InstanceIndex, or bind
+// instance_buffer() as a per-instance vertex buffer.
+//
+// Without VK_KHR_draw_indirect_count every instance keeps a command and culled ones draw zero instances.
+class GpuCulling {
+public:
+    GpuCulling(Device& device, SwapChain& swap_chain, uint32_t max_instances, uint32_t max_draw_sources);
+    ~GpuCulling();
+
+    GpuCulling(const GpuCulling&) = delete;
+    void operator=(const GpuCulling&) = delete;
+
+    // Device-local inputs; fill them through an UploadQueue, record_upload() or a compute pass.
+    VkBuffer instance_buffer() { return m_instance_buffer; }
+    VkBuffer draw_source_buffer() { return m_draw_source_buffer; }
+    bool compact() { return m_compact; }
+
+    // Pick the cull workgroup size for this device (see Autotuner). When the tuner measures, the instance buffer is
+    // overwritten with synthetic data, so call this before filling it.
+    void tune(Autotuner& tuner);
+
+    // Record copies of new inputs for the next record_cull(): `instance_count` GpuInstances from `source` at
+    // `offset`, and `draw_sources` when not empty. Waits for the previous frame's cull and draw to stop reading
+    // them. Must be outside a render pass.
+    void record_upload(VkCommandBuffer command_buffer, VkBuffer source, VkDeviceSize offset, uint32_t instance_count,
+        std::span<const GpuDrawSource> draw_sources);
+    // Record the cull dispatch. Must be outside a render pass.
+    void record_cull(VkCommandBuffer command_buffer, uint32_t frame_index, const glm::mat4& view_projection,
+        uint32_t instance_count, bool occlusion);
+    // Record the indirect draw; the caller has bound the pipeline and the shared vertex/index buffers.
+    void record_draw(VkCommandBuffer command_buffer);
+    // Downsample `depth_view` into the pyramid used by the next record_cull. The depth image must already be in
+    // SHADER_READ_ONLY_OPTIMAL and visible to compute, e.g. by recording this from a RenderGraph pass that declares
+    // it as sampled.
+    void record_depth_pyramid(VkCommandBuffer command_buffer, uint32_t frame_index, VkImageView depth_view);
+
+private:
+    struct CullData {
+        glm::mat4 view_projection;
+        glm::vec4 planes[6];
+        glm::vec2 pyramid_size;
+        uint32_t instance_count;
+        uint32_t flags;
+    };
+
+    static constexpr uint32_t FLAG_OCCLUSION = 1;
+    static constexpr uint32_t FLAG_COMPACT = 2;
+    static constexpr uint32_t CULL_GROUP_SIZE_ID = 0;
+    static constexpr uint32_t PYRAMID_TILE = 8;
+
+    void create_buffers(uint32_t max_draw_sources);
+    void create_depth_pyramid();
+    void create_descriptors();
+    void create_pipelines();
+    void fill_synthetic_instances();
+    void write_cull_data(
+        uint32_t frame_index, const glm::mat4& view_projection, uint32_t instance_count, uint32_t flags);
+    void dispatch_cull(VkCommandBuffer command_buffer, ComputePipeline& pipeline, uint32_t frame_index,
+        uint32_t instance_count, uint32_t group_size);
+
+    Device& m_device;
+    SwapChain& m_swap_chain;
+    uint32_t m_max_instances;
+    uint32_t m_instance_count = 0;
+    bool m_compact;
+    bool m_pyramid_valid = false;
+
+    VkBuffer m_instance_buffer;
+    VkDeviceMemory m_instance_memory;
+    VkBuffer m_draw_source_buffer;
+    VkDeviceMemory m_draw_source_memory;
+    VkBuffer m_command_buffer;
+    VkDeviceMemory m_command_memory;
+    VkBuffer m_count_buffer;
+    VkDeviceMemory m_count_memory;
+    VkBuffer m_uniform_buffer;
+    VkDeviceMemory m_uniform_memory;
+    char* m_uniform_mapped;
+    VkDeviceSize m_uniform_stride;
+
+    VkExtent2D m_pyramid_extent;
+    uint32_t m_pyramid_levels;
+    VkImage m_pyramid_image;
+    VkDeviceMemory m_pyramid_memory;
+    VkImageView m_pyramid_view;
+    std::vector<VkImageView> m_pyramid_level_views;
+    VkSampler m_sampler;
+
+    VkDescriptorPool m_descriptor_pool;
+    VkDescriptorSetLayout m_cull_set_layout;
+    VkDescriptorSetLayout m_pyramid_set_layout;
+    std::vector<VkDescriptorSet> m_cull_sets;
+    // One set per frame in flight for level 0, then one per further level.
+    std::vector<VkDescriptorSet> m_pyramid_sets;
+
+    VkPipelineLayout m_cull_layout;
+    VkPipelineLayout m_pyramid_layout;
+    SpecializationConstants m_cull_specialization;
+    uint32_t m_cull_group_size = 64;
+    std::unique_ptr<ComputePipeline> m_cull_pipeline;
+    std::unique_ptr<ComputePipeline> m_pyramid_pipeline;
+};
+
+} // namespace Simulation
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Named GPU time ranges measured with timestamp queries. There is one query pool per frame in flight; a frame's
+// results are read back with collect() once the graphics timeline has passed it, so reading never stalls.
+class GpuProfiler {
+public:
+    struct Scope {
+        std::string name;
+        double milliseconds;
+    };
+
+    GpuProfiler(Device& device, uint32_t frame_count, uint32_t max_scopes = 64);
+    ~GpuProfiler();
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    void operator=(const GpuProfiler&) = delete;
+
+    bool supported() { return m_supported; }
+
+    // Reset the frame's queries; must be recorded outside a render pass before any scope of the frame.
+    void begin_frame(VkCommandBuffer command_buffer, uint32_t frame_index);
+    // Returns an id for end_scope(), or ~0u when the frame has run out of queries or timestamps are unsupported.
+    uint32_t begin_scope(VkCommandBuffer command_buffer, const std::string& name);
+    void end_scope(VkCommandBuffer command_buffer, uint32_t scope);
+
+    // Read the frame's results. With `wait` the call blocks until they are available, which is what one-off
+    // measurements submitted through single-time commands want.
+    const std::vector<Scope>& collect(uint32_t frame_index, bool wait = false);
+
+private:
+    struct Frame {
+        VkQueryPool pool;
+        std::vector<std::string> names;
+        std::vector<Scope> results;
+    };
+
+    Device& m_device;
+    bool m_supported;
+    double m_period_ms;
+    uint32_t m_max_scopes;
+    uint32_t m_current = 0;
+    std::vector<Frame> m_frames;
+};
+
+} // namespace Simulation
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "ComputePipeline.hpp"
+#include "Device.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Compute kernels that reduce storage buffers on the GPU, so diagnostics read back a few words instead of the
+// buffers: sums, minima and maxima of vec4 fields, histograms of one component, and inclusive prefix sums of
+// earlier results. The kernels use subgroup arithmetic where the device has it and workgroup shared memory
+// otherwise.
+//
+// Everything is recorded into the caller's compute command buffer between begin() and end(). Results land in a
+// device-local buffer of 32-bit words; end() copies the words used into one of `slots` persistently mapped readback
+// slots, which are read on the host once the submission has completed, typically a few frames later.
+class GpuReduction {
+public:
+    enum class Op : uint32_t {
+        Sum,
+        Min,
+        Max,
+    };
+
+    // A vec4 per element of a buffer of structs, all sizes in vec4s. With `length`, the field's xyz length is used
+    // instead (in every component of a reduction).
+    struct Field {
+        uint32_t offset = 0;
+        uint32_t stride = 1;
+        bool length = false;
+    };
+
+    static constexpr uint32_t MAX_GROUPS = 256; // workgroups of the first pass of a reduction
+    static constexpr uint32_t MAX_BINS = 1024; // matches histogram.comp
+    static constexpr uint32_t MAX_SOURCES = 8;
+
+    GpuReduction(Device& device, uint32_t slots, uint32_t max_words, uint32_t max_reductions = 16);
+    ~GpuReduction();
+
+    GpuReduction(const GpuReduction&) = delete;
+    void operator=(const GpuReduction&) = delete;
+
+    // Register a storage buffer to read from; returns the source id to record with. At most MAX_SOURCES.
+    uint32_t add_source(VkBuffer buffer);
+
+    // Clears the results. Makes earlier compute shader writes in the command buffer visible to the kernels.
+    void begin(VkCommandBuffer command_buffer);
+    // Return the results word of the value: four words for a reduction, `bins` counts for a histogram.
+    uint32_t reduce(VkCommandBuffer command_buffer, uint32_t source, Op op, const Field& field, uint32_t count);
+    uint32_t histogram(VkCommandBuffer command_buffer, uint32_t source, const Field& field, uint32_t component,
+        uint32_t count, float low, float high, uint32_t bins);
+    // In-place inclusive prefix sum of `count` result words recorded before, e.g. a histogram into its cumulative
+    // distribution. Runs as one workgroup, so it is meant for result-sized ranges.
+    void scan(VkCommandBuffer command_buffer, uint32_t word, uint32_t count);
+    // Copy the results into readback slot `slot`, which must not be read until the submission has completed.
+    void end(VkCommandBuffer command_buffer, uint32_t slot);
+
+    glm::vec4 value(uint32_t slot, uint32_t word);
+    const uint32_t* words(uint32_t slot, uint32_t word);
+    bool uses_subgroups() { return m_subgroups; }
+
+private:
+    struct ReducePush {
+        uint32_t offset;
+        uint32_t stride;
+        uint32_t count;
+        uint32_t op;
+        uint32_t use_length;
+        uint32_t destination;
+        uint32_t final_pass;
+    };
+    struct HistogramPush {
+        uint32_t offset;
+        uint32_t stride;
+        uint32_t count;
+        uint32_t use_length;
+        uint32_t component;
+        uint32_t destination;
+        uint32_t bins;
+        float low;
+        float high;
+    };
+    struct ScanPush {
+        uint32_t destination;
+        uint32_t count;
+    };
+
+    static constexpr uint32_t GROUP_SIZE_ID = 0;
+
+    void create_buffers();
+    void create_layouts();
+    uint32_t allocate_words(uint32_t count);
+    void bind(VkCommandBuffer command_buffer, ComputePipeline& pipeline, uint32_t source);
+    void compute_barrier(VkCommandBuffer command_buffer);
+
+    Device& m_device;
+    uint32_t m_slots;
+    uint32_t m_max_words;
+    uint32_t m_max_reductions;
+    bool m_subgroups;
+    uint32_t m_group_size;
+
+    VkBuffer m_partials;
+    VkDeviceMemory m_partials_memory;
+    VkBuffer m_results;
+    VkDeviceMemory m_results_memory;
+    VkBuffer m_readback;
+    VkDeviceMemory m_readback_memory;
+    const uint32_t* m_mapped;
+
+    VkDescriptorSetLayout m_set_layout;
+    VkPipelineLayout m_pipeline_layout;
+    VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> m_sets; // per source; the first reads the partials, for passes that need no source
+    std::unique_ptr<ComputePipeline> m_reduce;
+    std::unique_ptr<ComputePipeline> m_histogram;
+    std::unique_ptr<ComputePipeline> m_scan;
+
+    // Of the recording between begin() and end(): final passes and scans wait for end(), which first makes
+    // everything recorded so far visible to them.
+    uint32_t m_words_used = 0;
+    std::vector<ReducePush> m_final_passes;
+    std::vector<ScanPush> m_scans;
+};
+
+} // namespace Simulation
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace Simulation {
+
+enum class LogSeverity : uint32_t {
+    Debug,
+    Info,
+    Warning,
+    Error,
+};
+
+enum class LogCategory : uint32_t {
+    General,
+    Validation, // validation layer messages
+    Performance, // performance warnings from the validation layer
+    Device,
+    Presentation,
+    Tuning,
+    Capture,
+    Stats,
+    Simulation,
+    Count,
+};
+
+// Process-wide log that never blocks the calling thread on I/O. A message is formatted straight into a slot of a
+// bounded lock-free multi-producer ring (Vyukov's queue); a background thread drains the ring to stdout (debug and
+// info) or stderr (warnings and errors). When the ring is full the message is dropped and counted instead of
+// waiting. The drain thread also rate-limits: after RATE_LIMIT identical messages within a second, further repeats
+// are counted and summarised once the second is over.
+class Logger {
+public:
+    static constexpr uint32_t CAPACITY = 4096; // power of two
+    static constexpr uint32_t MAX_MESSAGE = 480;
+    static constexpr uint32_t RATE_LIMIT = 5;
+
+    static Logger& instance();
+
+    Logger(const Logger&) = delete;
+    void operator=(const Logger&) = delete;
+
+    // Messages below the minimum severity or in disabled categories cost one relaxed load and are not formatted.
+    void set_min_severity(LogSeverity severity) { m_min_severity.store(static_cast<uint32_t>(severity)); }
+    void set_category_enabled(LogCategory category, bool enabled);
+    bool enabled(LogSeverity severity, LogCategory category);
+
+    void log(LogSeverity severity, LogCategory category, const char* format, ...)
+        __attribute__((format(printf, 4, 5)));
+    void vlog(LogSeverity severity, LogCategory category, const char* format, va_list arguments);
+
+    static void debug(LogCategory category, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    static void info(LogCategory category, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    static void warning(LogCategory category, const char* format, ...) __attribute__((format(printf, 2, 3)));
+    static void error(LogCategory category, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    // Blocks until everything logged before the call has been written.
+    void flush();
+
+    static bool parse_severity(const std::string& name, LogSeverity& severity);
+    static bool parse_category(const std::string& name, LogCategory& category);
+
+private:
+    struct Record {
+        std::chrono::steady_clock::time_point time;
+        LogSeverity severity;
+        LogCategory category;
+        uint32_t length;
+        char text[MAX_MESSAGE];
+    };
+    struct Cell {
+        std::atomic<uint64_t> sequence;
+        Record record;
+    };
+
+    Logger();
+    ~Logger();
+
+    void write(const Record& record);
+    void drain_loop();
+
+    std::unique_ptr<Cell[]> m_cells;
+    alignas(64) std::atomic<uint64_t> m_enqueue_position { 0 };
+    alignas(64) uint64_t m_dequeue_position = 0;
+    std::atomic<uint64_t> m_written { 0 };
+    std::atomic<uint64_t> m_dropped { 0 };
+
+    std::atomic<uint32_t> m_min_severity { static_cast<uint32_t>(LogSeverity::Info) };
+    std::atomic<uint32_t> m_disabled_categories { 0 };
+
+    std::chrono::steady_clock::time_point m_start;
+    std::atomic<bool> m_stop { false };
+    std::thread m_thread;
+};
+
+} // namespace Simulation
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Device.hpp"
+#include "DrawQueue.hpp"
+#include "MeshFile.hpp"
+#include "UploadQueue.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// A mesh whose LODs stream into device-local buffers through an UploadQueue. It can be drawn as soon as the
+// coarsest level has arrived and refines itself as finer levels land.
+class Mesh {
+public:
+    struct PushConstants {
+        glm::mat4 transform;
+        glm::vec4 position_offset;
+        glm::vec4 position_scale;
+    };
+
+    Mesh(Device& device, UploadQueue& uploader, const std::string& path);
+    ~Mesh();
+
+    Mesh(const Mesh&) = delete;
+    void operator=(const Mesh&) = delete;
+
+    static std::vector<VkVertexInputBindingDescription> binding_descriptions();
+    static std::vector<VkVertexInputAttributeDescription> attribute_descriptions();
+
+    // Finest fully resident LOD, or -1 while nothing has arrived yet.
+    int finest_resident_lod() const { return m_finest_resident; }
+    glm::vec3 bounds_min() const;
+    glm::vec3 bounds_max() const;
+    PushConstants push_constants(const glm::mat4& transform) const;
+    // Positions relative to the center of the bounds, scaled so that the bounds fit in a sphere of radius one; for
+    // instanced draws that scale and place every copy with a per-instance sphere.
+    PushConstants unit_push_constants(const glm::mat4& transform) const;
+
+    // The draw of `desired_lod`, or of the closest coarser level that is resident. Returns false if nothing is
+    // resident yet.
+    bool draw_item(uint32_t desired_lod, DrawItem& item) const;
+
+private:
+    void stream_complete(uint32_t lod);
+
+    Device& m_device;
+    UploadQueue& m_uploader;
+    MeshAsset m_asset;
+
+    VkBuffer m_vertex_buffer;
+    VkDeviceMemory m_vertex_memory;
+    VkBuffer m_index_buffer;
+    VkDeviceMemory m_index_memory;
+
+    std::vector<VkDeviceSize> m_vertex_offsets;
+    std::vector<VkDeviceSize> m_index_offsets;
+    std::vector<uint32_t> m_pending_streams;
+    int m_finest_resident = -1;
+};
+
+} // namespace Simulation
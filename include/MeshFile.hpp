@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Simulation {
+
+// Binary mesh layout (.smesh). Everything after the header is GPU-ready: vertex and index streams are copied to the
+// device byte for byte. LOD 0 is the finest level; streams are stored coarsest first so a sequential read makes the
+// cheapest level resident earliest.
+struct MeshFileHeader {
+    static constexpr uint32_t MAGIC = 0x48534D53; // "SMSH"
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint64_t STREAM_ALIGNMENT = 256; // of every stream's file offset
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t lod_count;
+    uint32_t vertex_stride;
+    float bounds_min[3];
+    float bounds_max[3];
+    uint32_t reserved[2];
+};
+
+struct MeshFileLod {
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint32_t vertex_count;
+    uint32_t index_count;
+    uint32_t index_size; // 2 or 4 bytes
+    uint32_t reserved;
+};
+
+// Positions are unorm16 inside the mesh bounds, normals are octahedral snorm16.
+struct MeshVertex {
+    uint16_t position[4];
+    int16_t normal[2];
+};
+
+struct MeshSourceLod {
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    std::vector<uint32_t> indices;
+};
+
+// Quantize and write a mesh; `lods[0]` is the finest level.
+void write_mesh_file(const std::string& path, const std::vector<MeshSourceLod>& lods);
+// Wavefront OBJ positions, normals and polygon faces, which are split into triangle fans. Vertices without a normal
+// get the area-weighted normal of the faces around them.
+MeshSourceLod read_obj_file(const std::string& path);
+// A coarser level by vertex clustering: the vertices in each cell of a `cells`^3 grid over the bounds merge into
+// one, and triangles that collapse are dropped.
+MeshSourceLod simplify_mesh(const MeshSourceLod& lod, uint32_t cells);
+
+// Read-only mmap of a .smesh file. Pages are faulted in as the uploader reads them.
+class MeshAsset {
+public:
+    explicit MeshAsset(const std::string& path);
+    ~MeshAsset();
+
+    MeshAsset(const MeshAsset&) = delete;
+    void operator=(const MeshAsset&) = delete;
+
+    const MeshFileHeader& header() const { return *static_cast<const MeshFileHeader*>(m_data); }
+    uint32_t lod_count() const { return header().lod_count; }
+    const MeshFileLod& lod(uint32_t index) const;
+    const void* vertex_data(uint32_t index) const;
+    const void* index_data(uint32_t index) const;
+
+    // Ask the kernel to start reading a level ahead of the uploader.
+    void prefetch(uint32_t index) const;
+
+private:
+    void* m_data = nullptr;
+    size_t m_size = 0;
+};
+
+
+} // namespace Simulation
@@ -0,0 +1,160 @@
+#pragma once
+
+#include "Autotuner.hpp"
+#include "ComputePipeline.hpp"
+#include "Device.hpp"
+#include "DrawQueue.hpp"
+#include "GpuProfiler.hpp"
+#include "GpuReduction.hpp"
+
+#include <glm/glm.hpp>
+
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Particles orbiting an attractor, integrated on the compute queue. Simulation state is double buffered and never
+// leaves the compute queue; every tick also writes the positions into one of two vertex buffers, which are handed
+// to the graphics queue. A frame draws the tick before the one just submitted, so tick N+1 is simulated while
+// tick N is rendered. With a dedicated compute family the vertex buffers change queue family ownership each tick;
+// all cross-queue waits are timeline values.
+class ParticleSimulation {
+public:
+    struct Particle {
+        glm::vec4 position; // w is the specific energy, kinetic plus potential
+        glm::vec4 velocity;
+    };
+
+    // Per unit mass, reduced on the GPU from a tick's state; only these few hundred bytes are read back.
+    struct Diagnostics {
+        uint64_t tick; // 0 until the first tick's diagnostics are in
+        float energy;
+        glm::vec3 momentum;
+        glm::vec3 bounds_min;
+        glm::vec3 bounds_max;
+        float max_speed;
+        // Particles with a speed below (b + 1) * MAX_DIAGNOSTIC_SPEED / SPEED_BINS, for each bin b.
+        std::vector<uint32_t> cumulative_speeds;
+
+        float speed_percentile(float fraction) const;
+    };
+
+    // Vertices are the position relative to vertex_origin() and the speed, as four floats or four halves. Halves
+    // halve the bytes the compute queue writes and the vertex fetch reads per particle.
+    enum class VertexEncoding : uint32_t {
+        Float,
+        Half,
+    };
+
+    static constexpr uint32_t DEFAULT_PARTICLE_COUNT = 64 * 1024;
+    static constexpr uint32_t SPEED_BINS = 64;
+    static constexpr float MAX_DIAGNOSTIC_SPEED = 2.0f;
+
+    ParticleSimulation(Device& device, uint32_t particle_count = DEFAULT_PARTICLE_COUNT,
+        VertexEncoding encoding = VertexEncoding::Half);
+    ~ParticleSimulation();
+
+    ParticleSimulation(const ParticleSimulation&) = delete;
+    void operator=(const ParticleSimulation&) = delete;
+
+    // Pick the workgroup size for this device (see Autotuner). Measuring overwrites the particles, so the initial
+    // state is restored afterwards; no frame may be in flight.
+    void tune(Autotuner& tuner);
+
+    // Submit the next tick. Blocks only if the compute queue is two ticks behind.
+    void step(float dt);
+
+    // Graphics side of the frame that draws the previous tick: the wait to add to the frame's submission, the
+    // ownership acquire to record before the draw, and the draw itself. The pipeline, bound by the draw queue, uses
+    // binding_descriptions()/attribute_descriptions() with point topology, and its transform has to translate by
+    // vertex_origin().
+    VkSemaphoreSubmitInfo render_wait();
+    void record_acquire(VkCommandBuffer command_buffer);
+    DrawItem draw_item();
+    // The graphics timeline value of the submission that drew the tick, which the tick after next waits for before
+    // overwriting its vertex buffer.
+    void rendered(uint64_t graphics_value) { m_render_reads[m_render_slot] = graphics_value; }
+
+    // GPU time of the most recently completed tick, 0 without timestamp support.
+    double last_step_milliseconds() { return m_last_step_ms; }
+    // Of the most recently completed tick, two ticks behind the one just submitted.
+    const Diagnostics& diagnostics() { return m_diagnostics; }
+
+    // A flattened disc in the xy plane on roughly circular orbits around an attractor of `strength` at the origin.
+    static std::vector<Particle> make_disc(uint32_t count, float strength, uint32_t seed);
+
+    glm::vec3 vertex_origin();
+    std::vector<VkVertexInputBindingDescription> binding_descriptions();
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions();
+
+private:
+    struct StepConstants {
+        glm::vec4 attractor; // xyz position, w strength
+        float dt;
+        uint32_t count;
+        uint32_t half_vertices;
+    };
+    // Where the reductions of every tick put their results.
+    struct DiagnosticWords {
+        uint32_t energy;
+        uint32_t momentum;
+        uint32_t bounds_min;
+        uint32_t bounds_max;
+        uint32_t max_speed;
+        uint32_t cumulative_speeds;
+    };
+
+    static constexpr uint32_t GROUP_SIZE_ID = 0;
+
+    uint32_t vertex_size() { return m_encoding == VertexEncoding::Half ? 4 * sizeof(uint16_t) : sizeof(glm::vec4); }
+    void create_buffers();
+    void create_descriptors();
+    void create_command_buffers();
+    void upload_initial_state();
+    void dispatch(VkCommandBuffer command_buffer, ComputePipeline& pipeline, uint32_t slot, float dt,
+        uint32_t group_size);
+    void record_diagnostics(VkCommandBuffer command_buffer, uint32_t slot);
+    void read_diagnostics(uint32_t slot, uint64_t tick);
+    // Queue family release/acquire of a vertex buffer; no-op when both queues are in the same family.
+    void ownership_barrier(VkCommandBuffer command_buffer, uint32_t slot, bool release, VkPipelineStageFlags2 stages,
+        VkAccessFlags2 access);
+
+    Device& m_device;
+    uint32_t m_count;
+    VertexEncoding m_encoding;
+
+    // Slot i holds tick i mod 2.
+    VkBuffer m_state_buffers[2];
+    VkDeviceMemory m_state_memory[2];
+    VkBuffer m_vertex_buffers[2];
+    VkDeviceMemory m_vertex_memory[2];
+
+    VkDescriptorPool m_descriptor_pool;
+    VkDescriptorSetLayout m_set_layout;
+    VkDescriptorSet m_sets[2]; // m_sets[i] reads slot 1 - i and writes slot i
+    VkPipelineLayout m_pipeline_layout;
+    SpecializationConstants m_specialization;
+    uint32_t m_group_size = 64;
+    std::unique_ptr<ComputePipeline> m_pipeline;
+
+    VkCommandPool m_command_pool;
+    VkCommandBuffer m_command_buffers[2];
+    GpuProfiler m_profiler;
+    double m_last_step_ms = 0.0;
+
+    // Readback slot i holds the diagnostics of the tick in state slot i.
+    GpuReduction m_reduction;
+    uint32_t m_state_sources[2];
+    DiagnosticWords m_diagnostic_words {};
+    Diagnostics m_diagnostics {};
+
+    uint64_t m_tick = 0;
+    uint32_t m_render_slot = 0;
+    uint64_t m_tick_values[2] = {}; // compute timeline value of the tick in each slot
+    uint64_t m_render_reads[2] = {}; // graphics timeline value of the last frame drawing each slot
+    bool m_pending_acquire = false;
+};
+
+} // namespace Simulation
@@ -1,14 +1,18 @@
 #pragma once
 
 #include "Device.hpp"
+#include "Specialization.hpp"
 
-#include <string>
+#include <cstdint>
+#include <span>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
 namespace Simulation {
 
 struct PipelineConfigInfo {
+    std::vector<VkVertexInputBindingDescription> binding_descriptions {};
+    std::vector<VkVertexInputAttributeDescription> attribute_descriptions {};
     VkViewport viewport;
     VkRect2D scissor;
     VkPipelineViewportStateCreateInfo viewport_info;
@@ -21,11 +25,13 @@ struct PipelineConfigInfo {
     VkPipelineLayout pipeline_layout = nullptr;
     VkRenderPass render_pass = nullptr;
     uint32_t sub_pass = 0;
+    SpecializationConstants specialization {};
 };
 
 class Pipeline {
 public:
-    Pipeline(Device& device, const std::string& vertex_filepath, const std::string& frag_filepath,
+    // SPIR-V words, normally the arrays that the build embeds in Shaders.hpp.
+    Pipeline(Device& device, std::span<const uint32_t> vertex_code, std::span<const uint32_t> frag_code,
         const PipelineConfigInfo& config_info);
 
     ~Pipeline();
@@ -33,15 +39,15 @@ public:
     Pipeline(const Pipeline&) = delete;
     void operator=(const Pipeline&) = delete;
 
+    void bind(VkCommandBuffer command_buffer);
+
     static PipelineConfigInfo default_pipeline_config_info(uint32_t width, uint32_t height);
 
 private:
-    static std::vector<char> read_file(const std::string& filepath);
-
-    void create_graphics_pipeline(
-        const std::string& vertex_filepath, const std::string& frag_filepath, const PipelineConfigInfo& config_info);
+    void create_graphics_pipeline(std::span<const uint32_t> vertex_code, std::span<const uint32_t> frag_code,
+        const PipelineConfigInfo& config_info);
 
-    void create_shader_module(const std::vector<char>& code, VkShaderModule* shader_module);
+    void create_shader_module(std::span<const uint32_t> code, VkShaderModule* shader_module);
 
     Device& m_device;
     VkPipeline m_graphics_pipeline;
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+using RenderResource = uint32_t;
+
+class RenderGraph;
+
+// Handed to a pass's setup callback to declare every resource the pass touches and how. Nothing is recorded here;
+// the graph derives render passes, barriers and lifetimes from these declarations in compile().
+class RenderPassBuilder {
+public:
+    void color_attachment(RenderResource image, VkAttachmentLoadOp load_op, VkClearColorValue clear = {});
+    void depth_attachment(RenderResource image, VkAttachmentLoadOp load_op, float clear_depth = 1.0f);
+    void sampled(RenderResource image, VkPipelineStageFlags2 stages);
+    void storage_read(RenderResource resource, VkPipelineStageFlags2 stages);
+    void storage_write(RenderResource resource, VkPipelineStageFlags2 stages);
+    void transfer_read(RenderResource resource);
+    void transfer_write(RenderResource resource);
+    void indirect_read(RenderResource buffer);
+    // Keep the pass even if nothing in the graph consumes what it writes (readbacks, captures, ...).
+    void side_effect();
+
+private:
+    friend class RenderGraph;
+    RenderPassBuilder(RenderGraph& graph, uint32_t pass)
+        : m_graph { graph }
+        , m_pass { pass }
+    {
+    }
+
+    void access(RenderResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access, VkImageLayout layout,
+        VkImageUsageFlags usage, bool write);
+
+    RenderGraph& m_graph;
+    uint32_t m_pass;
+};
+
+// Per-frame render graph. Passes are added in submission order together with the resources they read and write;
+// compile() then
+//  - drops passes whose results nothing uses,
+//  - creates a VkRenderPass per graphics pass, storing attachments only when a later pass or the caller needs them,
+//  - places every image/buffer barrier as early as it may go and merges them into as few vkCmdPipelineBarrier2
+//    calls as possible,
+//  - creates the transient images, one set per frame in flight, letting images whose lifetimes do not overlap share
+//    a memory block. Images only ever used as attachments are made transient and backed by lazily allocated memory
+//    where the device has it.
+// Imported resources (the swapchain image, persistent buffers, ...) are bound to concrete handles every frame.
+class RenderGraph {
+public:
+    struct Stats {
+        uint32_t live_passes;
+        uint32_t culled_passes;
+        uint32_t barrier_batches;
+        uint32_t barriers;
+        VkDeviceSize transient_bytes; // per frame, after aliasing
+        VkDeviceSize unaliased_bytes; // what the transients would need with one allocation each
+    };
+
+    RenderGraph(Device& device, uint32_t frame_count);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph&) = delete;
+    void operator=(const RenderGraph&) = delete;
+
+    RenderResource create_image(const std::string& name, VkFormat format, VkExtent2D extent);
+    // `initial_stages` are the stages the image's previous contents were produced in (for the swapchain image, the
+    // stage the acquire semaphore is waited on). The image is left in `final_layout` at the end of the frame.
+    RenderResource import_image(const std::string& name, VkFormat format, VkExtent2D extent,
+        VkImageLayout initial_layout, VkPipelineStageFlags2 initial_stages, VkImageLayout final_layout);
+    RenderResource import_buffer(const std::string& name,
+        VkPipelineStageFlags2 initial_stages = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        VkAccessFlags2 initial_access = VK_ACCESS_2_MEMORY_WRITE_BIT);
+
+    uint32_t add_pass(const std::string& name, const std::function<void(RenderPassBuilder&)>& setup,
+        std::function<void(VkCommandBuffer)> execute);
+
+    void compile();
+    // Destroy everything compile() created and forget all passes and resources.
+    void reset();
+
+    // Valid after compile() for passes with attachments; pipelines drawn in the pass are created against it.
+    VkRenderPass render_pass(uint32_t pass) { return m_passes[pass].render_pass; }
+    bool is_live(uint32_t pass) { return m_passes[pass].live; }
+    const Stats& stats() { return m_stats; }
+
+    void bind_image(RenderResource image, VkImage handle, VkImageView view);
+    void bind_buffer(RenderResource buffer, VkBuffer handle);
+    // The physical resource for the frame being executed; usable from pass callbacks.
+    VkImage image(RenderResource image);
+    VkImageView image_view(RenderResource image);
+    VkBuffer buffer(RenderResource buffer);
+
+    void execute(VkCommandBuffer command_buffer, uint32_t frame_index);
+
+private:
+    friend class RenderPassBuilder;
+
+    static constexpr uint32_t NONE = ~0u;
+
+    struct Access {
+        RenderResource resource;
+        VkPipelineStageFlags2 stages;
+        VkAccessFlags2 access;
+        VkImageLayout layout;
+        bool write;
+    };
+
+    struct Attachment {
+        RenderResource resource;
+        VkAttachmentLoadOp load_op;
+        VkAttachmentStoreOp store_op;
+        VkClearValue clear;
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<Access> accesses;
+        std::vector<Attachment> color_attachments;
+        Attachment depth_attachment { NONE };
+        bool side_effect = false;
+        std::function<void(VkCommandBuffer)> execute;
+
+        bool live = false;
+        VkRenderPass render_pass = VK_NULL_HANDLE;
+        VkExtent2D extent {};
+        std::vector<VkClearValue> clear_values;
+        std::map<std::vector<VkImageView>, VkFramebuffer> framebuffers;
+    };
+
+    struct Resource {
+        std::string name;
+        bool is_image;
+        bool imported;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent {};
+        VkImageUsageFlags usage = 0;
+
+        // Imported resources: the state they arrive in and the layout they must leave in.
+        VkImageLayout initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkPipelineStageFlags2 initial_stages = 0;
+        VkAccessFlags2 initial_access = 0;
+        VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+        VkImage bound_image = VK_NULL_HANDLE;
+        VkImageView bound_view = VK_NULL_HANDLE;
+        VkBuffer bound_buffer = VK_NULL_HANDLE;
+
+        // Transient images: lifetime in live-pass order and the memory block they were placed in.
+        uint32_t first_use = NONE;
+        uint32_t last_use = NONE;
+        VkPipelineStageFlags2 last_stages = 0;
+        VkAccessFlags2 last_access = 0;
+        uint32_t block = NONE;
+        VkMemoryRequirements requirements {};
+        std::vector<VkImage> images;
+        std::vector<VkImageView> views;
+    };
+
+    struct Barrier {
+        RenderResource resource;
+        VkPipelineStageFlags2 src_stages;
+        VkAccessFlags2 src_access;
+        VkPipelineStageFlags2 dst_stages;
+        VkAccessFlags2 dst_access;
+        VkImageLayout old_layout;
+        VkImageLayout new_layout;
+        uint32_t earliest; // first position it may be recorded at
+        uint32_t deadline; // position of the pass that needs it
+    };
+
+    struct BarrierBatch {
+        uint32_t position; // index into m_order; m_order.size() means after the last pass
+        std::vector<Barrier> barriers;
+    };
+
+    struct MemoryBlock {
+        uint32_t memory_type;
+        VkDeviceSize size;
+        std::vector<RenderResource> residents;
+        std::vector<VkDeviceMemory> memory;
+    };
+
+    bool reads_previous(const Pass& pass, const Access& access);
+    void cull_passes();
+    void compute_lifetimes();
+    void create_render_passes();
+    void create_transients();
+    void compute_barriers();
+    void batch_barriers(std::vector<Barrier>& barriers);
+    void record_batch(VkCommandBuffer command_buffer, const BarrierBatch& batch);
+    VkFramebuffer framebuffer(Pass& pass);
+    VkImageAspectFlags aspect(const Resource& resource);
+
+    Device& m_device;
+    uint32_t m_frame_count;
+    uint32_t m_frame_index = 0;
+    bool m_compiled = false;
+
+    std::vector<Pass> m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<uint32_t> m_order; // live passes in submission order
+    std::vector<BarrierBatch> m_batches;
+    std::vector<MemoryBlock> m_blocks;
+    Stats m_stats {};
+};
+
+} // namespace Simulation
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "ComputePipeline.hpp"
+#include "Device.hpp"
+#include "ParticleSimulation.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// One independent run of a parameter sweep.
+struct Scenario {
+    std::string name;
+    uint32_t particle_count;
+    uint32_t steps;
+    float dt;
+    float strength; // attractor strength
+    uint32_t seed;
+};
+
+// Written in front of the final particles of each scenario, followed by particle_count ParticleSimulation::Particle;
+// as there, each position's w is the particle's specific energy after the last step.
+struct ScenarioResultHeader {
+    static constexpr uint32_t MAGIC = 0x52534353; // "SCSR"
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t particle_count;
+    uint32_t steps;
+    float dt;
+    float strength;
+    uint32_t seed;
+    uint32_t padding;
+};
+
+// Runs many scenarios on one device at once instead of one process each. Every scenario's particles are packed
+// into one pair of shared state buffers and a single dispatch per tick advances all of them, indexed through a
+// per-scenario parameter table. Ticks are recorded in chunks on the compute queue, two chunks in flight, so the
+// CPU only records while the GPU works.
+class ScenarioBatch {
+public:
+    // One scenario per line: `name particles steps dt strength seed`. Blank lines and lines starting with '#' are
+    // skipped.
+    static std::vector<Scenario> load(const std::string& path);
+
+    ScenarioBatch(Device& device, std::vector<Scenario> scenarios);
+    ~ScenarioBatch();
+
+    ScenarioBatch(const ScenarioBatch&) = delete;
+    void operator=(const ScenarioBatch&) = delete;
+
+    // Blocks until every scenario has taken all of its steps.
+    void run();
+    // One `<name>.particles` file per scenario in `directory`, which must exist.
+    void write_results(const std::string& directory);
+
+    const std::vector<Scenario>& scenarios() { return m_scenarios; }
+
+private:
+    using Particle = ParticleSimulation::Particle;
+
+    struct GpuScenario {
+        glm::vec4 attractor; // xyz position, w strength
+        float dt;
+        uint32_t steps;
+        uint32_t first;
+        uint32_t count;
+    };
+
+    static constexpr uint32_t GROUP_SIZE_ID = 0;
+    static constexpr uint32_t TICKS_PER_CHUNK = 256;
+
+    void create_buffers();
+    void create_descriptors();
+    void create_command_buffers();
+    void upload_initial_state();
+    void record_chunk(VkCommandBuffer command_buffer, uint32_t first_tick, uint32_t tick_count);
+    void read_back();
+
+    Device& m_device;
+    std::vector<Scenario> m_scenarios;
+    std::vector<uint32_t> m_first; // offset of each scenario's particles
+    uint32_t m_total_count = 0;
+    uint32_t m_max_count = 0;
+    uint32_t m_max_steps = 0;
+
+    // Tick t reads m_state_buffers[t % 2] and writes the other.
+    VkBuffer m_state_buffers[2];
+    VkDeviceMemory m_state_memory[2];
+    VkBuffer m_scenario_buffer;
+    VkDeviceMemory m_scenario_memory;
+    VkBuffer m_readback_buffer;
+    VkDeviceMemory m_readback_memory;
+
+    VkDescriptorPool m_descriptor_pool;
+    VkDescriptorSetLayout m_set_layout;
+    VkDescriptorSet m_sets[2]; // m_sets[i] reads slot i and writes slot 1 - i
+    VkPipelineLayout m_pipeline_layout;
+    uint32_t m_group_size = 64;
+    std::unique_ptr<ComputePipeline> m_pipeline;
+
+    VkCommandPool m_command_pool;
+    VkCommandBuffer m_command_buffers[2];
+    uint64_t m_chunk_values[2] = {}; // compute timeline value of the chunk last submitted from each buffer
+    bool m_finished = false;
+};
+
+} // namespace Simulation
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Culling.hpp"
+#include "Device.hpp"
+#include "GpuCulling.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Simulation objects drawn as copies of one mesh: bodies on circular orbits around the attractor, spread well past
+// the particle disc so that most of them are off screen at any time. Each object is a bounding sphere, and the
+// instanced mesh pipeline places a unit-radius copy of the mesh on it (see Mesh::unit_push_constants()).
+//
+// step() moves the objects and refits their BVH. cull() tests the BVH against the view on the pool's threads and
+// writes the GpuInstances of the visible objects, compacted, straight into the frame's region of a mapped instance
+// buffer, so only those are drawn. write_instances() writes all of them instead, for culling on the GPU.
+class SceneObjects {
+public:
+    SceneObjects(Device& device, ThreadPool& pool, uint32_t count, uint32_t frames_in_flight);
+    ~SceneObjects();
+
+    SceneObjects(const SceneObjects&) = delete;
+    void operator=(const SceneObjects&) = delete;
+
+    void step(float dt);
+    // Returns the number of instances written for `frame_index`, whose region must no longer be in use by the GPU.
+    uint32_t cull(const glm::mat4& view_projection, uint32_t frame_index);
+    // Writes every object for `frame_index`, under the same condition.
+    void write_instances(uint32_t frame_index);
+
+    uint32_t count() { return m_count; }
+    VkBuffer instance_buffer() { return m_instance_buffer; }
+    VkDeviceSize instance_offset(uint32_t frame_index) { return sizeof(GpuInstance) * m_count * frame_index; }
+
+    // Binding 1, per instance, for pipelines that also use Mesh's binding 0. Only the bounding sphere is read, so
+    // GpuCulling::instance_buffer() can be bound there as well.
+    static VkVertexInputBindingDescription binding_description();
+    static VkVertexInputAttributeDescription attribute_description();
+
+private:
+    struct Orbit {
+        float radius;
+        float angle;
+        float angular_speed;
+        float height;
+    };
+
+    void place(uint32_t begin, uint32_t end);
+
+    Device& m_device;
+    ThreadPool& m_pool;
+    uint32_t m_count;
+
+    std::vector<Orbit> m_orbits;
+    std::vector<GpuInstance> m_instances;
+    AabbSoA m_boxes;
+    Bvh m_bvh;
+
+    // Persistently mapped, one region of m_count instances per frame in flight.
+    VkBuffer m_instance_buffer;
+    VkDeviceMemory m_instance_memory;
+    char* m_instance_mapped;
+};
+
+} // namespace Simulation
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Transport.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Simulation {
+
+// Transport between processes on one host through single-producer/single-consumer byte rings in POSIX shared
+// memory, one per ordered pair of ranks. Each rank creates the rings it reads and maps the ones it writes; the
+// constructor returns once every peer has attached, at which point the names are unlinked so nothing is left
+// behind if a rank dies.
+class SharedMemoryTransport : public Transport {
+public:
+    static constexpr uint64_t RING_BYTES = 8ull << 20;
+
+    explicit SharedMemoryTransport(const Transport::Options& options);
+    ~SharedMemoryTransport() override;
+
+    void send(uint32_t peer, uint32_t tag, const void* data, size_t size) override;
+
+private:
+    struct RingHeader {
+        std::atomic<uint32_t> ready;
+        std::atomic<uint32_t> attached;
+        std::atomic<uint32_t> closed;
+        alignas(64) std::atomic<uint64_t> head; // bytes written
+        alignas(64) std::atomic<uint64_t> tail; // bytes read
+    };
+    struct Ring {
+        RingHeader* header = nullptr;
+        char* data = nullptr;
+    };
+    struct FrameHeader {
+        uint32_t tag;
+        uint32_t padding;
+        uint64_t size;
+    };
+
+    static std::string ring_name(const std::string& session, uint32_t from, uint32_t to);
+    static size_t mapping_size() { return sizeof(RingHeader) + RING_BYTES; }
+
+    void write(Ring& ring, const void* data, size_t size);
+    bool read(Ring& ring, void* data, size_t size);
+    void receive_loop(uint32_t peer);
+
+    std::vector<Ring> m_incoming; // by sender rank
+    std::vector<Ring> m_outgoing; // by receiver rank
+    std::vector<std::thread> m_receivers;
+    std::atomic<bool> m_stopping { false };
+};
+
+} // namespace Simulation
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Values for a shader's specialization constants (`layout(constant_id = N) const ...` in GLSL, including
+// `local_size_x_id`). Shared between every stage of a pipeline; a stage simply ignores ids it does not declare.
+class SpecializationConstants {
+public:
+    // T must be a 4-byte scalar: uint32_t, int32_t, float, or VkBool32 for GLSL bools.
+    template <typename T>
+    void set(uint32_t constant_id, T value)
+    {
+        static_assert(sizeof(T) == 4 && std::is_trivially_copyable_v<T>, "specialization constants are 32-bit");
+        for (const auto& entry : m_entries) {
+            if (entry.constantID == constant_id) {
+                std::memcpy(m_data.data() + entry.offset, &value, sizeof(T));
+                return;
+            }
+        }
+        m_entries.push_back({ constant_id, static_cast<uint32_t>(m_data.size()), sizeof(T) });
+        m_data.resize(m_data.size() + sizeof(T));
+        std::memcpy(m_data.data() + m_entries.back().offset, &value, sizeof(T));
+    }
+
+    // The value of `constant_id` if it has been set, else `fallback`; e.g. to size dispatches for a specialized
+    // workgroup.
+    uint32_t get(uint32_t constant_id, uint32_t fallback) const;
+
+    bool empty() const { return m_entries.empty(); }
+    // Points into this object, so it is only valid until the next set() or until this object is gone. nullptr when
+    // empty, which is what Vulkan expects for an unspecialized stage.
+    const VkSpecializationInfo* info() const;
+    // Canonical "id=value ..." text, sorted by id.
+    std::string to_string() const;
+
+private:
+    std::vector<VkSpecializationMapEntry> m_entries;
+    std::vector<uint8_t> m_data;
+    mutable VkSpecializationInfo m_info {};
+};
+
+} // namespace Simulation
@@ -20,46 +20,47 @@ public:
     SwapChain(const SwapChain&) = delete;
     void operator=(const SwapChain&) = delete;
 
-    VkFramebuffer get_frame_buffer(int index) { return m_swap_chain_frame_buffers[index]; }
-    VkRenderPass get_render_pass() { return m_render_pass; }
+    VkImage get_image(int index) { return m_swap_chain_images[index]; }
     VkImageView get_image_view(int index) { return m_swap_chain_image_views[index]; }
     size_t image_count() { return m_swap_chain_images.size(); }
     VkFormat get_swap_chain_image_format() { return m_swap_chain_image_format; }
     VkExtent2D get_swap_chain_extent() { return m_swap_chain_extent; }
+    // Whether the images can be copied from, which frame capture needs; up to the surface.
+    bool supports_transfer_source() { return m_swap_chain_image_usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT; }
     uint32_t width() { return m_swap_chain_extent.width; }
     uint32_t height() { return m_swap_chain_extent.height; }
 
+    // Frames are numbered from 1 in submission order. A frame is complete once the graphics timeline has reached
+    // the value its submission signaled, which lets other subsystems reclaim per-frame resources without waiting.
+    uint64_t current_frame_serial() { return m_frame_serial + 1; }
+    uint64_t completed_frame_serial();
+
     float extent_aspect_ratio()
     {
         return static_cast<float>(m_swap_chain_extent.width) / static_cast<float>(m_swap_chain_extent.height);
     }
 
+    // Render passes, depth buffers and framebuffers are owned by the RenderGraph.
     VkFormat find_depth_format();
 
     VkResult accuire_next_image(uint32_t* image_index);
-    VkResult submit_command_buffers(const VkCommandBuffer* buffers, uint32_t* image_index);
+    // `waits` are extra semaphores the frame depends on, e.g. a compute timeline value for data it draws.
+    VkResult submit_command_buffers(const VkCommandBuffer* buffers, uint32_t* image_index,
+        const std::vector<VkSemaphoreSubmitInfo>& waits = {});
 
     void create_swap_chain();
     void create_image_views();
-    void create_depth_resources();
-    void create_render_pass();
-    void create_frame_buffers();
     void create_sync_objects();
 
     // Helper methods
-    VkSurfaceKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
+    VkSurfaceFormatKHR choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats);
     VkPresentModeKHR choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes);
-    VkExtent2D choose_swap_extent(const VkSurfaceCapabilities2EXT& capabilites);
+    VkExtent2D choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilites);
 
     VkFormat m_swap_chain_image_format;
+    VkImageUsageFlags m_swap_chain_image_usage;
     VkExtent2D m_swap_chain_extent;
 
-    std::vector<VkFramebuffer> m_swap_chain_frame_buffers;
-    VkRenderPass m_render_pass;
-
-    std::vector<VkImage> m_depth_images;
-    std::vector<VkDeviceMemory> m_depth_image_memorys;
-    std::vector<VkImageView> m_depth_image_views;
     std::vector<VkImage> m_swap_chain_images;
     std::vector<VkImageView> m_swap_chain_image_views;
 
@@ -70,10 +71,15 @@ public:
 
     std::vector<VkSemaphore> m_image_available_semaphores;
     std::vector<VkSemaphore> m_render_finished_semaphores;
-    std::vector<VkFence> m_in_flight_fences;
-    std::vector<VkFence> m_images_in_flight_fences;
+    // Graphics timeline values of the last submission per frame slot and per swapchain image.
+    uint64_t m_in_flight_values[MAX_FRAMES_IN_FLIGHT] = {};
+    std::vector<uint64_t> m_images_in_flight_values;
 
     size_t current_frame = 0;
+
+    uint64_t m_frame_serial = 0;
+    uint64_t m_completed_serial = 0;
+    uint64_t m_in_flight_serials[MAX_FRAMES_IN_FLIGHT] = {};
 };
 
 } // namespace Simulation
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Transport.hpp"
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Simulation {
+
+// Full mesh of TCP connections: every rank listens for the ranks above it and connects to the ranks below it,
+// retrying until they are up. One thread per connection reads length-prefixed frames into the mailboxes.
+class TcpTransport : public Transport {
+public:
+    explicit TcpTransport(const Transport::Options& options);
+    ~TcpTransport() override;
+
+    void send(uint32_t peer, uint32_t tag, const void* data, size_t size) override;
+
+private:
+    struct FrameHeader {
+        uint32_t tag;
+        uint32_t padding;
+        uint64_t size;
+    };
+
+    void connect_to(uint32_t peer, const std::string& host, uint16_t port);
+    void accept_from_higher_ranks(int listener);
+    void receive_loop(uint32_t peer);
+
+    std::vector<int> m_sockets; // by rank, -1 for self
+    std::vector<std::mutex> m_send_mutexes;
+    std::vector<std::thread> m_receivers;
+};
+
+} // namespace Simulation
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Simulation {
+
+// Fixed set of worker threads for data-parallel loops. parallel_for splits [0, count) into chunks that workers and
+// the calling thread claim from a shared counter, and returns once every chunk has run.
+class ThreadPool {
+public:
+    explicit ThreadPool(uint32_t thread_count = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    void operator=(const ThreadPool&) = delete;
+
+    // Number of threads that run chunks, including the caller.
+    uint32_t size() { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+    void parallel_for(uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& fn);
+
+private:
+    void worker_loop();
+    void run_chunks();
+
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_work_cv;
+    std::condition_variable m_done_cv;
+    bool m_stop = false;
+    uint64_t m_generation = 0;
+    uint32_t m_active = 0;
+
+    const std::function<void(uint32_t, uint32_t)>* m_fn = nullptr;
+    uint32_t m_count = 0;
+    uint32_t m_grain = 1;
+    std::atomic<uint32_t> m_next { 0 };
+};
+
+} // namespace Simulation
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// A semaphore whose payload only grows. Every submission to a queue signals the queue's next value, so "is frame,
+// tick or upload N done" is a single integer comparison, host waits need no fences, and another queue can wait for
+// the value directly.
+class TimelineSemaphore {
+public:
+    TimelineSemaphore(VkDevice device, uint64_t initial_value = 0);
+    ~TimelineSemaphore();
+
+    TimelineSemaphore(const TimelineSemaphore&) = delete;
+    void operator=(const TimelineSemaphore&) = delete;
+
+    VkSemaphore handle() { return m_semaphore; }
+
+    // Hand out the value the next submission will signal.
+    uint64_t reserve() { return ++m_last_reserved; }
+    uint64_t last_reserved() { return m_last_reserved; }
+
+    // Current payload; only asks the driver when the cached value is not already far enough.
+    uint64_t completed();
+    bool is_complete(uint64_t value) { return value <= m_completed || value <= completed(); }
+    void wait(uint64_t value);
+
+    VkSemaphoreSubmitInfo submit_info(uint64_t value, VkPipelineStageFlags2 stages)
+    {
+        return {
+            .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .semaphore = m_semaphore,
+            .value = value,
+            .stageMask = stages,
+        };
+    }
+
+private:
+    VkDevice m_device;
+    VkSemaphore m_semaphore;
+    uint64_t m_completed;
+    uint64_t m_last_reserved;
+};
+
+} // namespace Simulation
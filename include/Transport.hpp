@@ -0,0 +1,67 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Simulation {
+
+// Tagged, ordered point-to-point messages between the processes of one distributed run, numbered 0..ranks-1.
+// send() hands the bytes to the peer's side before returning; the peer's transport receives on its own threads
+// into per-sender mailboxes, so two ranks sending to each other at once never deadlock however large the
+// messages are. Messages from one sender arrive in the order sent.
+class Transport {
+public:
+    struct Options {
+        std::string kind = "shm"; // "tcp" or "shm"
+        uint32_t rank = 0;
+        uint32_t ranks = 1;
+        // tcp: rank r listens on base_port + r at hosts[r], or 127.0.0.1 for every rank when hosts is empty.
+        std::vector<std::string> hosts;
+        uint16_t base_port = 47000;
+        // shm: ranks of one run must agree on the session, which names the shared memory objects.
+        std::string session = "simulation";
+    };
+
+    static std::unique_ptr<Transport> create(const Options& options);
+
+    Transport(uint32_t rank, uint32_t ranks);
+    virtual ~Transport() = default;
+
+    Transport(const Transport&) = delete;
+    void operator=(const Transport&) = delete;
+
+    uint32_t rank() { return m_rank; }
+    uint32_t ranks() { return m_ranks; }
+
+    virtual void send(uint32_t peer, uint32_t tag, const void* data, size_t size) = 0;
+    // Blocks until the next message from `peer` arrives and throws if its tag is not `tag` or the peer is gone.
+    std::vector<uint8_t> receive(uint32_t peer, uint32_t tag);
+
+protected:
+    // For the receiving threads of derived transports.
+    void deliver(uint32_t peer, uint32_t tag, std::vector<uint8_t> payload);
+    void close(uint32_t peer);
+
+private:
+    struct Message {
+        uint32_t tag;
+        std::vector<uint8_t> payload;
+    };
+    struct Mailbox {
+        std::mutex mutex;
+        std::condition_variable arrived;
+        std::deque<Message> messages;
+        bool closed = false;
+    };
+
+    uint32_t m_rank;
+    uint32_t m_ranks;
+    std::vector<Mailbox> m_mailboxes;
+};
+
+} // namespace Simulation
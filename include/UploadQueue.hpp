@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Device.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// Streams host data into device-local buffers through a persistently mapped staging ring. Requests are split into
+// chunks that fit the free part of the ring and submitted without waiting; finished batches are retired by poll(),
+// which is also where completion callbacks run. Unlike Device::copy_buffer nothing here blocks the calling thread.
+class UploadQueue {
+public:
+    static constexpr VkDeviceSize DEFAULT_STAGING_SIZE = 16 * 1024 * 1024;
+    static constexpr uint32_t MAX_BATCHES = 8;
+
+    UploadQueue(Device& device, VkDeviceSize staging_size = DEFAULT_STAGING_SIZE);
+    ~UploadQueue();
+
+    UploadQueue(const UploadQueue&) = delete;
+    void operator=(const UploadQueue&) = delete;
+
+    // `src` is read while flush() stages it and must stay valid until the request has been fully staged;
+    // `on_complete` runs from poll() once the GPU copy of the last chunk has finished.
+    void enqueue(VkBuffer dst, VkDeviceSize dst_offset, const void* src, VkDeviceSize size,
+        std::function<void()> on_complete = {});
+
+    // Copy up to `budget` bytes of pending data into the ring and submit them as one batch.
+    void flush(VkDeviceSize budget = DEFAULT_STAGING_SIZE / 2);
+    // Retire batches the graphics timeline has passed.
+    void poll();
+    void wait_idle();
+
+    bool idle() { return m_requests.empty() && m_in_flight.empty(); }
+    // Graphics timeline value of the most recent batch. Work on another queue that reads uploaded data waits for it.
+    uint64_t submitted_value() { return m_submitted_value; }
+    uint64_t bytes_uploaded() { return m_bytes_uploaded; }
+
+private:
+    struct Request {
+        VkBuffer dst;
+        VkDeviceSize dst_offset;
+        const char* src;
+        VkDeviceSize size;
+        VkDeviceSize submitted;
+        std::function<void()> on_complete;
+    };
+
+    struct Batch {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        uint64_t value = 0;
+        VkDeviceSize ring_end = 0;
+        std::vector<std::function<void()>> callbacks;
+    };
+
+    Device& m_device;
+    VkCommandPool m_command_pool;
+
+    VkBuffer m_staging_buffer;
+    VkDeviceMemory m_staging_memory;
+    char* m_staging_mapped;
+    VkDeviceSize m_staging_size;
+    // Monotonic byte counters; the ring offset is the counter modulo m_staging_size.
+    VkDeviceSize m_head = 0;
+    VkDeviceSize m_tail = 0;
+
+    std::array<Batch, MAX_BATCHES> m_batches;
+    std::deque<uint32_t> m_free_batches;
+    std::deque<uint32_t> m_in_flight;
+    std::deque<Request> m_requests;
+
+    uint64_t m_submitted_value = 0;
+    uint64_t m_bytes_uploaded = 0;
+};
+
+} // namespace Simulation
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace Simulation {
+
+// CPU encoders for the compact vertex attribute encodings. Whatever the CPU writes with these the GPU reads back
+// through a matching decoder, so the pairs must stay in step:
+//   quantize_half     VK_FORMAT_R16*_SFLOAT vertex fetch; packHalf2x16() where a shader writes the same stream
+//   quantize_unorm16  VK_FORMAT_R16*_UNORM vertex fetch
+//   quantize_snorm16  VK_FORMAT_R16*_SNORM vertex fetch
+//   oct_encode        oct_decode() in mesh.vert
+
+// IEEE binary16, rounded to nearest even; out-of-range values become infinities.
+uint16_t quantize_half(float value);
+uint16_t quantize_unorm16(float value);
+int16_t quantize_snorm16(float value);
+// Unit normal to two values in [-1, 1].
+glm::vec2 oct_encode(glm::vec3 normal);
+
+// An index stream in the narrowest type that can address `vertex_count` vertices.
+struct IndexStream {
+    std::vector<char> bytes;
+    uint32_t index_size; // 2 or 4 bytes
+};
+IndexStream narrow_indices(const std::vector<uint32_t>& indices, size_t vertex_count);
+
+} // namespace Simulation
@@ -5,6 +5,7 @@
 #include <GLFW/glfw3.h>
 
 #include <string>
+#include <vector>
 
 namespace Simulation {
 class Window {
@@ -15,15 +16,33 @@ public:
     Window& operator=(const Window&) = delete;
 
     bool shouldClose() { return glfwWindowShouldClose(window); }
+    VkExtent2D get_extent() { return { static_cast<uint32_t>(m_width), static_cast<uint32_t>(m_height) }; }
 
     void create_window_surface(VkInstance instance, VkSurfaceKHR* surface);
 
+    // Whether any event that can change what is on screen (input, an exposed or restored window) arrived since the
+    // last call. Events are only delivered by glfwPollEvents() and friends.
+    bool take_changes();
+    // Keys pressed since the last call, in order.
+    std::vector<int> take_pressed_keys();
+    bool iconified() { return m_iconified; }
+
 private:
     void initWindow();
 
+    static void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    static void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
+    static void scroll_callback(GLFWwindow* window, double x_offset, double y_offset);
+    static void refresh_callback(GLFWwindow* window);
+    static void iconify_callback(GLFWwindow* window, int iconified);
+
     GLFWwindow* window;
     const int m_width;
     const int m_height;
     std::string m_name;
+
+    bool m_changed = true;
+    bool m_iconified = false;
+    std::vector<int> m_pressed_keys;
 };
 } // namespace Simulation
@@ -0,0 +1,24 @@
+#!/bin/sh
+# Runs one distributed simulation as local processes, e.g. from the build directory:
+#   ../scripts/run_distributed.sh 4 shm --particles 1000000 --ticks 500
+# Fails if any rank fails, which includes a rank seeing particles lost or duplicated.
+if [ $# -lt 2 ]; then
+    echo "usage: $0 RANKS TRANSPORT [simulationengine options...]" >&2
+    exit 2
+fi
+RANKS=$1
+TRANSPORT=$2
+shift 2
+BINARY=${SIMULATION_BINARY:-./simulationengine}
+
+PIDS=""
+for RANK in $(seq 0 $((RANKS - 1))); do
+    "$BINARY" --rank "$RANK" --ranks "$RANKS" --transport "$TRANSPORT" --session "simulation-$$" "$@" &
+    PIDS="$PIDS $!"
+done
+
+STATUS=0
+for PID in $PIDS; do
+    wait "$PID" || STATUS=1
+done
+exit $STATUS
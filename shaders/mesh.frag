@@ -0,0 +1,10 @@
+#version 450
+
+layout (location = 0) in vec3 in_normal;
+
+layout (location = 0) out vec4 outColor;
+
+void main() {
+  float light = max(dot(normalize(in_normal), normalize(vec3(0.4, -0.8, 0.4))), 0.0);
+  outColor = vec4(vec3(0.15 + 0.85 * light), 1.0);
+}
@@ -0,0 +1,19 @@
+// Vertex inputs and push constants shared by the mesh vertex shaders; see Mesh::PushConstants.
+
+layout (location = 0) in vec4 in_position; // unorm16 inside the mesh bounds
+layout (location = 1) in vec2 in_normal;   // octahedral snorm16
+
+layout (push_constant) uniform Push {
+  mat4 transform;
+  vec4 position_offset;
+  vec4 position_scale;
+} push;
+
+// Inverse of oct_encode() in VertexFormat.cpp.
+vec3 oct_decode(vec2 e) {
+  vec3 n = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0) {
+    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+  }
+  return normalize(n);
+}
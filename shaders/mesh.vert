@@ -0,0 +1,12 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "mesh.glsl"
+
+layout (location = 0) out vec3 out_normal;
+
+void main() {
+  vec3 position = push.position_offset.xyz + in_position.xyz * push.position_scale.xyz;
+  gl_Position = push.transform * vec4(position, 1.0);
+  out_normal = oct_decode(in_normal);
+}
@@ -0,0 +1,15 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "mesh.glsl"
+
+// Per instance: the sphere the unit-radius mesh is scaled and moved onto (see Mesh::unit_push_constants()).
+layout (location = 2) in vec4 in_sphere;
+
+layout (location = 0) out vec3 out_normal;
+
+void main() {
+  vec3 position = push.position_offset.xyz + in_position.xyz * push.position_scale.xyz;
+  gl_Position = push.transform * vec4(in_sphere.xyz + position * in_sphere.w, 1.0);
+  out_normal = oct_decode(in_normal);
+}
@@ -0,0 +1,15 @@
+#version 450
+
+layout (location = 0) in vec4 in_particle; // xyz position relative to the attractor, w speed
+
+layout (location = 0) out vec3 out_color;
+
+layout (push_constant) uniform Push {
+  mat4 transform;
+} push;
+
+void main() {
+  gl_Position = push.transform * vec4(in_particle.xyz, 1.0);
+  gl_PointSize = 1.0;
+  out_color = mix(vec3(0.2, 0.4, 1.0), vec3(1.0, 0.7, 0.3), clamp(in_particle.w * 2.0, 0.0, 1.0));
+}
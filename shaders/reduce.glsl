@@ -0,0 +1,90 @@
+// Body of reduce.comp and reduce_subgroup.comp, which differ only in SUBGROUPS.
+//
+// The first pass reduces a field of `count` elements of the source to one partial per workgroup; the final pass
+// reduces `count` partials with a single workgroup into four words of the results.
+layout (local_size_x_id = 0) in;
+
+layout (set = 0, binding = 0) readonly buffer Source { vec4 source[]; };
+layout (set = 0, binding = 1) buffer Partials { vec4 partials[]; };
+layout (set = 0, binding = 2) buffer Results { uint results[]; };
+
+layout (push_constant) uniform Push {
+  uint offset; // vec4s to the field of the first element, or to the first partial
+  uint stride; // vec4s between elements
+  uint count;
+  uint op; // 0 sum, 1 min, 2 max
+  uint use_length; // reduce length(field.xyz) in every component instead of the field
+  uint destination; // first partial of the pass, or results word of the final value
+  uint final_pass;
+} push;
+
+#if SUBGROUPS
+shared vec4 subgroup_values[gl_WorkGroupSize.x];
+#else
+shared vec4 values[gl_WorkGroupSize.x];
+#endif
+
+vec4 combine(vec4 a, vec4 b) {
+  if (push.op == 0) {
+    return a + b;
+  }
+  return push.op == 1 ? min(a, b) : max(a, b);
+}
+
+vec4 load(uint i) {
+  if (push.final_pass != 0) {
+    return partials[push.offset + i];
+  }
+  vec4 field = source[push.offset + i * push.stride];
+  return push.use_length != 0 ? vec4(length(field.xyz)) : field;
+}
+
+void main() {
+  float infinity = uintBitsToFloat(0x7f800000u);
+  vec4 value = vec4(push.op == 0 ? 0.0 : push.op == 1 ? infinity : -infinity);
+  uint grid_size = gl_WorkGroupSize.x * gl_NumWorkGroups.x;
+  for (uint i = gl_GlobalInvocationID.x; i < push.count; i += grid_size) {
+    value = combine(value, load(i));
+  }
+
+  // Every invocation gets here, so the subgroup operations see full subgroups.
+#if SUBGROUPS
+  if (push.op == 0) {
+    value = subgroupAdd(value);
+  } else if (push.op == 1) {
+    value = subgroupMin(value);
+  } else {
+    value = subgroupMax(value);
+  }
+  if (subgroupElect()) {
+    subgroup_values[gl_SubgroupID] = value;
+  }
+  barrier();
+  if (gl_LocalInvocationIndex == 0) {
+    for (uint s = 1; s < gl_NumSubgroups; s++) {
+      value = combine(value, subgroup_values[s]);
+    }
+  }
+#else
+  uint index = gl_LocalInvocationIndex;
+  values[index] = value;
+  barrier();
+  for (uint half_size = gl_WorkGroupSize.x / 2; half_size > 0; half_size /= 2) {
+    if (index < half_size) {
+      values[index] = combine(values[index], values[index + half_size]);
+    }
+    barrier();
+  }
+  value = values[0];
+#endif
+
+  if (gl_LocalInvocationIndex == 0) {
+    if (push.final_pass != 0) {
+      for (uint component = 0; component < 4; component++) {
+        results[push.destination + component] = floatBitsToUint(value[component]);
+      }
+    } else {
+      partials[push.destination + gl_WorkGroupID.x] = value;
+    }
+  }
+}
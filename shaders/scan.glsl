@@ -0,0 +1,72 @@
+// Body of scan.comp and scan_subgroup.comp, which differ only in SUBGROUPS.
+//
+// Inclusive prefix sum of `count` words of the results, in place, by a single workgroup that walks the range one
+// workgroup-sized chunk at a time and carries the running total between chunks.
+layout (local_size_x_id = 0) in;
+
+layout (set = 0, binding = 2) buffer Results { uint results[]; };
+
+layout (push_constant) uniform Push {
+  uint destination; // first word
+  uint count;
+} push;
+
+shared uint totals[gl_WorkGroupSize.x];
+shared uint carry;
+
+void main() {
+  uint index = gl_LocalInvocationIndex;
+  if (index == 0) {
+    carry = 0u;
+  }
+  barrier();
+
+  for (uint base = 0; base < push.count; base += gl_WorkGroupSize.x) {
+    uint i = base + index;
+    uint value = i < push.count ? results[push.destination + i] : 0u;
+#if SUBGROUPS
+    value = subgroupInclusiveAdd(value);
+    // The last subgroup is partial when the workgroup size is not a multiple of the subgroup size, and its total is
+    // then in the highest active invocation rather than in gl_SubgroupSize - 1.
+    bool full = gl_WorkGroupSize.x % gl_SubgroupSize == 0u || gl_SubgroupID + 1u < gl_NumSubgroups;
+    if (full) {
+      uint total = subgroupBroadcast(value, gl_SubgroupSize - 1u);
+      if (gl_SubgroupInvocationID == 0u) {
+        totals[gl_SubgroupID] = total;
+      }
+    } else if (gl_SubgroupInvocationID == subgroupMax(gl_SubgroupInvocationID)) {
+      totals[gl_SubgroupID] = value;
+    }
+    barrier();
+    if (index == 0) {
+      uint sum = 0u;
+      for (uint s = 0; s < gl_NumSubgroups; s++) {
+        uint total = totals[s];
+        totals[s] = sum;
+        sum += total;
+      }
+    }
+    barrier();
+    value += totals[gl_SubgroupID] + carry;
+#else
+    totals[index] = value;
+    barrier();
+    for (uint shift = 1; shift < gl_WorkGroupSize.x; shift *= 2) {
+      uint add = index >= shift ? totals[index - shift] : 0u;
+      barrier();
+      totals[index] += add;
+      barrier();
+    }
+    value = totals[index] + carry;
+#endif
+    if (i < push.count) {
+      results[push.destination + i] = value;
+    }
+    // Everyone has read the carry and the totals before they change for the next chunk.
+    barrier();
+    if (index == gl_WorkGroupSize.x - 1) {
+      carry = value;
+    }
+    barrier();
+  }
+}
@@ -0,0 +1,197 @@
+#include "AdaptiveSimulation.hpp"
+#include "Debug.hpp"
+#include "ParticleSimulation.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <stdexcept>
+
+namespace Simulation {
+
+AdaptiveSimulation::AdaptiveSimulation(ThreadPool& pool, const Config& config)
+    : m_pool { pool }
+    , m_config { config }
+{
+    if (m_config.max_level > 30) {
+        throw std::runtime_error("adaptive simulation supports at most 30 levels");
+    }
+
+    auto disc = ParticleSimulation::make_disc(m_config.particle_count, m_config.strength, m_config.seed);
+    m_particles.resize(disc.size());
+    for (size_t i = 0; i < disc.size(); i++) {
+        m_particles[i] = {
+            .position = glm::vec3(disc[i].position),
+            .id = static_cast<uint32_t>(i),
+            .velocity = glm::vec3(disc[i].velocity),
+            .padding = 0,
+        };
+    }
+    m_accelerations.resize(m_particles.size());
+    m_levels.assign(m_particles.size(), 0);
+
+    // Every particle starts a step here, so each gets forces, a level and its opening half kick.
+    uint32_t count = static_cast<uint32_t>(m_particles.size());
+    m_grid.build(m_particles, m_config.cutoff);
+    accelerate(count);
+    m_pool.parallel_for(count, 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            m_levels[i] = pick_level(m_particles[i], m_accelerations[i]);
+            float level_dt = m_config.dt / static_cast<float>(1u << m_levels[i]);
+            m_particles[i].velocity += m_accelerations[i] * (0.5f * level_dt);
+        }
+    });
+    sort_by_level();
+}
+
+uint32_t AdaptiveSimulation::level_count(uint32_t level)
+{
+    uint32_t slot = m_config.max_level - level;
+    return m_level_starts[slot + 1] - m_level_starts[slot];
+}
+
+glm::vec3 AdaptiveSimulation::acceleration(const DomainParticle& particle) const
+{
+    // Same forces as DistributedSimulation.
+    glm::vec3 offset = -particle.position;
+    float distance_sq = glm::dot(offset, offset) + 0.001f;
+    glm::vec3 result = m_config.strength * offset / (distance_sq * std::sqrt(distance_sq));
+
+    float cutoff_sq = m_config.cutoff * m_config.cutoff;
+    m_grid.for_each_near(particle.position, m_particles, [&](const DomainParticle& other) {
+        glm::vec3 away = particle.position - other.position;
+        float length_sq = glm::dot(away, away);
+        if (length_sq >= cutoff_sq || length_sq == 0.0f || other.id == particle.id) {
+            return;
+        }
+        float length = std::sqrt(length_sq);
+        result += m_config.stiffness * (1.0f - length / m_config.cutoff) * away / length;
+    });
+    return result;
+}
+
+uint32_t AdaptiveSimulation::pick_level(const DomainParticle& particle, const glm::vec3& acceleration) const
+{
+    float limit = m_config.dt;
+    float acceleration_length = glm::length(acceleration);
+    if (acceleration_length > 0.0f) {
+        limit = std::min(limit, m_config.accuracy * std::sqrt(m_config.cutoff / acceleration_length));
+    }
+    float speed = glm::length(particle.velocity);
+    if (speed > 0.0f) {
+        limit = std::min(limit, m_config.courant * m_config.cutoff / speed);
+    }
+
+    uint32_t level = 0;
+    while (level < m_config.max_level && m_config.dt / static_cast<float>(1u << level) > limit) {
+        level++;
+    }
+    return level;
+}
+
+void AdaptiveSimulation::accelerate(uint32_t end)
+{
+    m_pool.parallel_for(end, 1024, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+            m_accelerations[i] = acceleration(m_particles[i]);
+        }
+    });
+    m_force_evaluations += end;
+}
+
+bool AdaptiveSimulation::kick(uint32_t end, uint32_t substep)
+{
+    std::atomic<bool> changed { false };
+    m_pool.parallel_for(end, 1024, [&](uint32_t first, uint32_t last) {
+        bool chunk_changed = false;
+        for (uint32_t i = first; i < last; i++) {
+            // A level's steps end every 2^(max_level - level) substeps; finer levels are always allowed, since
+            // this particle's own step just ended.
+            uint32_t level = pick_level(m_particles[i], m_accelerations[i]);
+            while (substep % (1u << (m_config.max_level - level)) != 0) {
+                level++;
+            }
+            float half_steps = m_config.dt / static_cast<float>(1u << m_levels[i])
+                + m_config.dt / static_cast<float>(1u << level);
+            m_particles[i].velocity += m_accelerations[i] * (0.5f * half_steps);
+            chunk_changed |= level != m_levels[i];
+            m_levels[i] = level;
+        }
+        if (chunk_changed) {
+            changed.store(true, std::memory_order_relaxed);
+        }
+    });
+    return changed.load(std::memory_order_relaxed);
+}
+
+void AdaptiveSimulation::sort_by_level()
+{
+    uint32_t max_level = m_config.max_level;
+    m_level_starts.assign(max_level + 2, 0);
+    for (uint32_t level : m_levels) {
+        m_level_starts[max_level - level + 1]++;
+    }
+    for (uint32_t slot = 0; slot <= max_level; slot++) {
+        m_level_starts[slot + 1] += m_level_starts[slot];
+    }
+
+    std::vector<uint32_t> cursor(m_level_starts.begin(), m_level_starts.end() - 1);
+    std::vector<DomainParticle> particles(m_particles.size());
+    std::vector<glm::vec3> accelerations(m_particles.size());
+    std::vector<uint32_t> levels(m_particles.size());
+    for (size_t i = 0; i < m_particles.size(); i++) {
+        uint32_t slot = cursor[max_level - m_levels[i]]++;
+        particles[slot] = m_particles[i];
+        accelerations[slot] = m_accelerations[i];
+        levels[slot] = m_levels[i];
+    }
+    m_particles.swap(particles);
+    m_accelerations.swap(accelerations);
+    m_levels.swap(levels);
+}
+
+void AdaptiveSimulation::step()
+{
+    SIM_TRACE_ZONE("AdaptiveSimulation::step");
+    uint32_t count = static_cast<uint32_t>(m_particles.size());
+    uint32_t max_level = m_config.max_level;
+    uint32_t substeps = 1u << max_level;
+    float substep_dt = m_config.dt / static_cast<float>(substeps);
+
+    auto finest_level = [&] {
+        uint32_t slot = 0;
+        while (slot < max_level && m_level_starts[slot + 1] == 0) {
+            slot++;
+        }
+        return max_level - slot;
+    };
+    uint32_t finest = finest_level();
+
+    for (uint32_t substep = 1; substep <= substeps; substep++) {
+        m_pool.parallel_for(count, 4096, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                m_particles[i].position += m_particles[i].velocity * substep_dt;
+            }
+        });
+
+        // The coarsest level whose step ends after this substep; it and every finer level are active.
+        uint32_t coarsest = max_level - std::min(static_cast<uint32_t>(std::countr_zero(substep)), max_level);
+        uint32_t end = active_end(coarsest);
+        if (end == 0) {
+            continue;
+        }
+        // Inactive particles are neighbours too, so the grid covers everything at its drifted position.
+        m_grid.build(m_particles, m_config.cutoff);
+        accelerate(end);
+        if (kick(end, substep)) {
+            sort_by_level();
+            finest = std::max(finest, finest_level());
+        }
+    }
+
+    m_uniform_force_evaluations += static_cast<uint64_t>(count) << finest;
+    m_tick++;
+}
+
+} // namespace Simulation
@@ -1,13 +1,495 @@
 #include "Application.hpp"
+#include "Debug.hpp"
+#include "Logger.hpp"
+#include "Shaders.hpp"
+#include "TimelineSemaphore.hpp"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <span>
+#include <stdexcept>
 
 namespace Simulation {
 
+// The particle disc spans [-1, 1] in x and y; map its thin z range into the middle of the depth range.
+static glm::mat4 scene_view()
+{
+    glm::mat4 view { 1.0f };
+    view[2][2] = 0.5f;
+    view[3][2] = 0.5f;
+    return view;
+}
+
+Application::Application()
+{
+    create_pipeline_layout();
+    build_render_graph();
+    create_pipeline();
+    create_command_buffers();
+    m_particles.tune(m_tuner);
+}
+
+Application::~Application()
+{
+    vkDeviceWaitIdle(m_device.device());
+    m_capture.reset();
+    m_gpu_culling.reset();
+    m_objects.reset();
+    m_mesh.reset();
+    vkDestroyPipelineLayout(m_device.device(), m_pipeline_layout, nullptr);
+}
+
 void Application::run()
 {
+    bool idle = false;
     while (!m_window.shouldClose()) {
-        glfwPollEvents();
+        if (idle) {
+            glfwWaitEventsTimeout(IDLE_TIMEOUT);
+        } else {
+            m_limiter.wait();
+            glfwPollEvents();
+        }
+        handle_input();
+
+        if (!needs_frame()) {
+            if (m_capture) {
+                poll_capture();
+            }
+            idle = true;
+            continue;
+        }
+        if (idle) {
+            // Neither the idle time nor the frame pacing before it should carry over into the first frame.
+            m_limiter.reset();
+            m_last_frame_time = std::chrono::steady_clock::now();
+            idle = false;
+        }
+        draw_frame();
+    }
+
+    vkDeviceWaitIdle(m_device.device());
+}
+
+void Application::enable_capture(const std::string& path)
+{
+    if (!m_swap_chain.supports_transfer_source()) {
+        Logger::error(LogCategory::Capture, "not capturing to %s: this surface does not allow copying swapchain images",
+            path.c_str());
+        return;
+    }
+
+    VkExtent2D extent = m_swap_chain.get_swap_chain_extent();
+    VkDeviceSize frame_size = static_cast<VkDeviceSize>(extent.width) * extent.height
+        * FrameCapture::texel_size(m_swap_chain.get_swap_chain_image_format());
+    m_capture = std::make_unique<FrameCapture>(m_device, path, frame_size);
+
+    vkDeviceWaitIdle(m_device.device());
+    build_render_graph();
+}
+
+void Application::poll_capture()
+{
+    m_capture->poll(m_swap_chain.completed_frame_serial());
+    if (m_capture->failed() && !m_capture_failed) {
+        Logger::error(LogCategory::Capture, "capture stopped after %llu frames: the capture file could not be written",
+            static_cast<unsigned long long>(m_capture->captured_frames()));
+        m_capture_failed = true;
+    }
+}
+
+void Application::load_mesh(const std::string& path)
+{
+    m_mesh = std::make_unique<Mesh>(m_device, m_uploader, path);
+
+    if (!m_mesh_pipeline) {
+        auto pipeline_config = Pipeline::default_pipeline_config_info(m_swap_chain.width(), m_swap_chain.height());
+        pipeline_config.render_pass = m_graph.render_pass(m_scene_pass);
+        pipeline_config.pipeline_layout = m_pipeline_layout;
+        pipeline_config.binding_descriptions = Mesh::binding_descriptions();
+        pipeline_config.attribute_descriptions = Mesh::attribute_descriptions();
+        m_mesh_pipeline = std::make_unique<Pipeline>(m_device, Shaders::mesh_vert, Shaders::mesh_frag, pipeline_config);
+        m_mesh_pipeline_id = m_draw_queue.add_pipeline(*m_mesh_pipeline, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT);
+
+        pipeline_config.binding_descriptions.push_back(SceneObjects::binding_description());
+        pipeline_config.attribute_descriptions.push_back(SceneObjects::attribute_description());
+        m_instanced_mesh_pipeline = std::make_unique<Pipeline>(
+            m_device, Shaders::mesh_instanced_vert, Shaders::mesh_frag, pipeline_config);
+        m_instanced_mesh_pipeline_id
+            = m_draw_queue.add_pipeline(*m_instanced_mesh_pipeline, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT);
+    }
+}
+
+void Application::add_objects(uint32_t count)
+{
+    vkDeviceWaitIdle(m_device.device());
+    m_objects = std::make_unique<SceneObjects>(m_device, m_pool, count, SwapChain::MAX_FRAMES_IN_FLIGHT);
+    create_gpu_culling();
+}
+
+void Application::enable_gpu_culling()
+{
+    m_use_gpu_culling = true;
+    create_gpu_culling();
+}
+
+// Sized for the objects, so it is made again whenever they change; until then culling stays on the CPU.
+void Application::create_gpu_culling()
+{
+    if (!m_use_gpu_culling || !m_objects) {
+        return;
+    }
+
+    vkDeviceWaitIdle(m_device.device());
+    m_gpu_culling.reset();
+    if (!m_device.enabled_features().drawIndirectFirstInstance) {
+        Logger::warning(LogCategory::Performance, "no drawIndirectFirstInstance, culling objects on the CPU instead");
+        m_use_gpu_culling = false;
+    } else {
+        // One draw source: the mesh LOD being drawn.
+        m_gpu_culling = std::make_unique<GpuCulling>(m_device, m_swap_chain, m_objects->count(), 1);
+        m_gpu_culling->tune(m_tuner);
+        m_gpu_draw_source = {};
+        if (!m_gpu_culling->compact()) {
+            Logger::info(LogCategory::Performance, "no draw indirect count, culled objects keep empty draw commands");
+        }
+    }
+    build_render_graph();
+}
+
+void Application::enable_autotune(bool retune)
+{
+    m_tuner.set_tuning(true, retune);
+    vkDeviceWaitIdle(m_device.device());
+    m_particles.tune(m_tuner);
+    if (m_gpu_culling) {
+        m_gpu_culling->tune(m_tuner);
+    }
+}
+
+void Application::create_pipeline_layout()
+{
+    VkPushConstantRange push_constant_range = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(Mesh::PushConstants),
+    };
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 0,
+        .pSetLayouts = nullptr,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_constant_range,
+    };
+    if (vkCreatePipelineLayout(m_device.device(), &pipeline_layout_info, nullptr, &m_pipeline_layout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline layout!");
+    }
+}
+
+void Application::build_render_graph()
+{
+    m_graph.reset();
+
+    VkFormat format = m_swap_chain.get_swap_chain_image_format();
+    VkExtent2D extent = m_swap_chain.get_swap_chain_extent();
+    // Acquired images arrive with undefined contents once the acquire semaphore wait at color output has passed.
+    m_backbuffer = m_graph.import_image("backbuffer", format, extent, VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+    RenderResource depth = m_graph.create_image("depth", m_swap_chain.find_depth_format(), extent);
+
+    if (m_gpu_culling) {
+        m_graph.add_pass(
+            "cull", [&](RenderPassBuilder& pass) { pass.side_effect(); },
+            [this](VkCommandBuffer command_buffer) { record_gpu_cull(command_buffer); });
+    }
+
+    m_scene_pass = m_graph.add_pass(
+        "scene",
+        [&](RenderPassBuilder& pass) {
+            pass.color_attachment(m_backbuffer, VK_ATTACHMENT_LOAD_OP_CLEAR, { { 0.1f, 0.1f, 0.1f, 1.0f } });
+            pass.depth_attachment(depth, VK_ATTACHMENT_LOAD_OP_CLEAR);
+        },
+        [this](VkCommandBuffer command_buffer) { record_scene(command_buffer); });
+
+    if (m_gpu_culling) {
+        // Next frame's cull tests the objects against this frame's depth.
+        m_graph.add_pass(
+            "depth_pyramid",
+            [&](RenderPassBuilder& pass) {
+                pass.sampled(depth, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+                pass.side_effect();
+            },
+            [this, depth](VkCommandBuffer command_buffer) {
+                m_gpu_culling->record_depth_pyramid(command_buffer, static_cast<uint32_t>(m_swap_chain.current_frame),
+                    m_graph.image_view(depth));
+            });
+    }
+
+    if (m_capture) {
+        m_graph.add_pass(
+            "capture",
+            [&](RenderPassBuilder& pass) {
+                pass.transfer_read(m_backbuffer);
+                pass.side_effect();
+            },
+            [this, format, extent](VkCommandBuffer command_buffer) {
+                m_capture->record_image(command_buffer, m_graph.image(m_backbuffer),
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, format, extent, m_swap_chain.current_frame_serial());
+            });
+    }
+
+    m_graph.compile();
+}
+
+void Application::create_pipeline()
+{
+    auto pipeline_config = Pipeline::default_pipeline_config_info(m_swap_chain.width(), m_swap_chain.height());
+    pipeline_config.render_pass = m_graph.render_pass(m_scene_pass);
+    pipeline_config.pipeline_layout = m_pipeline_layout;
+    m_pipeline = std::make_unique<Pipeline>(
+        m_device, Shaders::simple_shader_vert, Shaders::simple_shader_frag, pipeline_config);
+    m_pipeline_id = m_draw_queue.add_pipeline(*m_pipeline, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT);
+
+    pipeline_config.input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    pipeline_config.binding_descriptions = m_particles.binding_descriptions();
+    pipeline_config.attribute_descriptions = m_particles.attribute_descriptions();
+    m_particle_pipeline = std::make_unique<Pipeline>(
+        m_device, Shaders::particles_vert, Shaders::particles_frag, pipeline_config);
+    m_particle_pipeline_id
+        = m_draw_queue.add_pipeline(*m_particle_pipeline, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT);
+}
+
+void Application::create_command_buffers()
+{
+    m_command_buffers.resize(SwapChain::MAX_FRAMES_IN_FLIGHT);
+
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_device.get_command_pool(),
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = static_cast<uint32_t>(m_command_buffers.size()),
+    };
+    if (vkAllocateCommandBuffers(m_device.device(), &alloc_info, m_command_buffers.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate command buffers!");
+    }
+}
+
+void Application::record_command_buffer(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+    SIM_TRACE_ZONE("Application::record_command_buffer");
+    VkCommandBufferBeginInfo begin_info = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+        throw std::runtime_error("failed to begin recording command buffer!");
+    }
+
+    uint32_t frame_index = static_cast<uint32_t>(m_swap_chain.current_frame);
+    m_profiler.begin_frame(command_buffer, frame_index);
+    uint32_t scope = m_profiler.begin_scope(command_buffer, "graphics");
+    m_particles.record_acquire(command_buffer);
+
+    m_graph.bind_image(m_backbuffer, m_swap_chain.get_image(image_index), m_swap_chain.get_image_view(image_index));
+    m_graph.execute(command_buffer, frame_index);
+    m_profiler.end_scope(command_buffer, scope);
+
+    if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to record command buffer!");
+    }
+}
+
+void Application::record_scene(VkCommandBuffer command_buffer)
+{
+    uint32_t frame_index = static_cast<uint32_t>(m_swap_chain.current_frame);
+    glm::mat4 view = scene_view();
+
+    DrawItem mesh_item;
+    bool mesh_resident = m_mesh && m_mesh->draw_item(0, mesh_item);
+    if (mesh_resident && m_objects) {
+        // One instanced draw of the objects the BVH finds in view, read from the instances the cull just wrote. With
+        // GPU culling they are drawn after the queue instead, from the commands record_gpu_cull() wrote.
+        m_visible_objects = m_gpu_culling ? 0 : m_objects->cull(view, frame_index);
+        if (m_visible_objects > 0) {
+            mesh_item.instance_buffer = m_objects->instance_buffer();
+            mesh_item.instance_offset = m_objects->instance_offset(frame_index);
+            mesh_item.instance_count = m_visible_objects;
+            Mesh::PushConstants push = m_mesh->unit_push_constants(view);
+            m_draw_queue.push(
+                DrawQueue::make_key(0, m_instanced_mesh_pipeline_id, 0, 0.0f), mesh_item, &push, sizeof(push));
+        }
+    } else if (mesh_resident) {
+        // Fit the mesh bounds into the viewport until there is a camera.
+        glm::vec3 center = (m_mesh->bounds_min() + m_mesh->bounds_max()) * 0.5f;
+        glm::vec3 size = m_mesh->bounds_max() - m_mesh->bounds_min();
+        float scale = 1.8f / std::max({ size.x, size.y, size.z, 1e-6f });
+        glm::mat4 transform { 1.0f };
+        transform[0][0] = scale;
+        transform[1][1] = scale;
+        transform[2][2] = 0.5f * scale;
+        transform[3] = glm::vec4(-center.x * scale, -center.y * scale, 0.5f - 0.5f * center.z * scale, 1.0f);
+
+        Mesh::PushConstants push = m_mesh->push_constants(transform);
+        m_draw_queue.push(DrawQueue::make_key(0, m_mesh_pipeline_id, 0, 0.0f), mesh_item, &push, sizeof(push));
+    } else {
+        m_draw_queue.push(DrawQueue::make_key(0, m_pipeline_id, 0, 0.0f), { .count = 3 });
+    }
+
+    glm::mat4 particle_transform = view;
+    particle_transform[3] = view * glm::vec4(m_particles.vertex_origin(), 1.0f);
+    m_draw_queue.push(DrawQueue::make_key(0, m_particle_pipeline_id, 0, 0.0f), m_particles.draw_item(),
+        &particle_transform, sizeof(particle_transform));
+
+    m_draw_queue.submit(command_buffer, frame_index);
+    if (m_gpu_culling && m_gpu_mesh_culled) {
+        record_gpu_draw(command_buffer);
+    }
+}
+
+void Application::record_gpu_cull(VkCommandBuffer command_buffer)
+{
+    uint32_t frame_index = static_cast<uint32_t>(m_swap_chain.current_frame);
+    m_gpu_mesh_culled = m_mesh && m_mesh->draw_item(0, m_gpu_mesh_item);
+    if (!m_gpu_mesh_culled) {
+        return;
+    }
+
+    // The index range changes when a finer LOD becomes resident.
+    GpuDrawSource source = {
+        .index_count = m_gpu_mesh_item.count,
+        .first_index = m_gpu_mesh_item.first,
+        .vertex_offset = m_gpu_mesh_item.base_vertex,
+        .padding = 0,
+    };
+    std::span<const GpuDrawSource> draw_sources;
+    if (source.index_count != m_gpu_draw_source.index_count || source.first_index != m_gpu_draw_source.first_index
+        || source.vertex_offset != m_gpu_draw_source.vertex_offset) {
+        m_gpu_draw_source = source;
+        draw_sources = { &m_gpu_draw_source, 1 };
+    }
+
+    m_objects->write_instances(frame_index);
+    m_gpu_culling->record_upload(command_buffer, m_objects->instance_buffer(),
+        m_objects->instance_offset(frame_index), m_objects->count(), draw_sources);
+    m_gpu_culling->record_cull(command_buffer, frame_index, scene_view(), m_objects->count(), true);
+}
+
+void Application::record_gpu_draw(VkCommandBuffer command_buffer)
+{
+    const DrawItem& item = m_gpu_mesh_item;
+    m_instanced_mesh_pipeline->bind(command_buffer);
+    // Every command's firstInstance is its object's index, so binding 1 reads the GpuInstances the cull tested.
+    VkBuffer buffers[] = { item.vertex_buffer, m_gpu_culling->instance_buffer() };
+    VkDeviceSize offsets[] = { item.vertex_offset, 0 };
+    vkCmdBindVertexBuffers(command_buffer, 0, 2, buffers, offsets);
+    vkCmdBindIndexBuffer(command_buffer, item.index_buffer, item.index_offset, item.index_type);
+    Mesh::PushConstants push = m_mesh->unit_push_constants(scene_view());
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+    m_gpu_culling->record_draw(command_buffer);
+}
+
+void Application::handle_input()
+{
+    for (int key : m_window.take_pressed_keys()) {
+        if (key == GLFW_KEY_SPACE) {
+            m_paused = !m_paused;
+            Logger::info(LogCategory::Simulation, "%s", m_paused ? "paused" : "resumed");
+        }
+    }
+}
+
+bool Application::needs_frame()
+{
+    // take_changes() has to be called every time so that a change is not carried into a later frame.
+    bool changed = m_window.take_changes();
+    if (m_window.iconified()) {
+        return false;
+    }
+    return changed || !m_paused || !m_uploader.idle();
+}
+
+void Application::draw_frame()
+{
+    SIM_TRACE_ZONE("Application::draw_frame");
+    uint32_t image_index;
+    auto result = m_swap_chain.accuire_next_image(&image_index);
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to acquire swap chain image!");
+    }
+
+    auto now = std::chrono::steady_clock::now();
+    float frame_seconds = std::chrono::duration<float>(now - m_last_frame_time).count();
+    m_last_frame_time = now;
+    // Read before the frame slot is re-recorded, and on every frame so that a trace gets all of them.
+    const auto& gpu_scopes = m_profiler.collect(static_cast<uint32_t>(m_swap_chain.current_frame));
+    if (m_print_stats) {
+        update_stats(frame_seconds, gpu_scopes);
+    }
+
+    if (m_capture) {
+        poll_capture();
+    }
+    m_uploader.poll();
+    m_uploader.flush();
+
+    // Runs on the compute queue while this frame draws the previous tick.
+    if (!m_paused) {
+        float dt = std::min(frame_seconds, 1.0f / 30.0f);
+        m_particles.step(dt);
+        if (m_objects) {
+            m_objects->step(dt);
+        }
+    }
+
+    // The acquire above waited for this frame slot's timeline value, so its command buffer is no longer in use.
+    VkCommandBuffer command_buffer = m_command_buffers[m_swap_chain.current_frame];
+    record_command_buffer(command_buffer, image_index);
+    result = m_swap_chain.submit_command_buffers(&command_buffer, &image_index, { m_particles.render_wait() });
+    m_particles.rendered(m_device.graphics_timeline().last_reserved());
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        throw std::runtime_error("failed to present swap chain image!");
+    }
+}
+
+// `gpu_scopes` are from the previous frame that used this frame slot.
+void Application::update_stats(float frame_seconds, const std::vector<GpuProfiler::Scope>& gpu_scopes)
+{
+    for (const auto& scope : gpu_scopes) {
+        m_stats_graphics_ms += scope.milliseconds;
+    }
+    m_stats_simulation_ms += m_particles.last_step_milliseconds();
+    m_stats_draw_calls += m_draw_queue.last_stats().draw_calls;
+    m_stats_state_changes += m_draw_queue.last_stats().state_changes();
+    m_stats_visible_objects += m_visible_objects;
+    m_stats_seconds += frame_seconds;
+    m_stats_frames++;
+
+    if (m_stats_seconds >= 2.0) {
+        Logger::info(LogCategory::Stats,
+            "frame %.3f ms, gpu graphics %.3f ms, simulation %.3f ms (%s), %.1f draw calls, %.1f state changes",
+            1000.0 * m_stats_seconds / m_stats_frames, m_stats_graphics_ms / m_stats_frames,
+            m_stats_simulation_ms / m_stats_frames, m_device.has_async_compute() ? "async compute" : "single queue",
+            static_cast<double>(m_stats_draw_calls) / m_stats_frames,
+            static_cast<double>(m_stats_state_changes) / m_stats_frames);
+        if (m_objects && !m_gpu_culling) {
+            Logger::info(LogCategory::Stats, "%.1f of %u objects drawn after culling",
+                static_cast<double>(m_stats_visible_objects) / m_stats_frames, m_objects->count());
+        }
+        const auto& diagnostics = m_particles.diagnostics();
+        if (diagnostics.tick != 0) {
+            Logger::info(LogCategory::Simulation,
+                "tick %llu: energy %.4f, momentum (%.4f, %.4f, %.4f), bounds (%.2f, %.2f, %.2f)-(%.2f, %.2f, %.2f), "
+                "speed max %.3f median %.3f",
+                static_cast<unsigned long long>(diagnostics.tick), diagnostics.energy, diagnostics.momentum.x,
+                diagnostics.momentum.y, diagnostics.momentum.z, diagnostics.bounds_min.x, diagnostics.bounds_min.y,
+                diagnostics.bounds_min.z, diagnostics.bounds_max.x, diagnostics.bounds_max.y, diagnostics.bounds_max.z,
+                diagnostics.max_speed, diagnostics.speed_percentile(0.5f));
+        }
+        m_stats_frames = 0;
+        m_stats_seconds = 0.0;
+        m_stats_graphics_ms = 0.0;
+        m_stats_simulation_ms = 0.0;
+        m_stats_draw_calls = 0;
+        m_stats_state_changes = 0;
+        m_stats_visible_objects = 0;
     }
 }
 } // namespace Simulation
@@ -0,0 +1,191 @@
+#include "Autotuner.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// SpecializationConstants::to_string() text back into (id, value) pairs; false unless every token is a pair of
+// 32-bit decimal numbers.
+static bool parse_constants(const std::string& text, std::vector<std::pair<uint32_t, uint32_t>>& values)
+{
+    values.clear();
+    std::istringstream tokens { text };
+    std::string token;
+    while (tokens >> token) {
+        size_t split = token.find('=');
+        if (split == std::string::npos) {
+            return false;
+        }
+        uint32_t id;
+        uint32_t value;
+        const char* end = token.data() + token.size();
+        auto parsed_id = std::from_chars(token.data(), token.data() + split, id);
+        auto parsed_value = std::from_chars(token.data() + split + 1, end, value);
+        if (parsed_id.ec != std::errc {} || parsed_id.ptr != token.data() + split || parsed_value.ec != std::errc {}
+            || parsed_value.ptr != end) {
+            return false;
+        }
+        values.emplace_back(id, value);
+    }
+    return true;
+}
+
+Autotuner::Autotuner(Device& device, const std::string& cache_path)
+    : m_device { device }
+    , m_cache_path { cache_path }
+    , m_profiler { device, 1, 1 }
+{
+    // Timings go stale when either the GPU or the driver build changes, so both UUIDs make up the key.
+    char uuid[4 * VK_UUID_SIZE + 1];
+    for (uint32_t i = 0; i < VK_UUID_SIZE; i++) {
+        std::snprintf(uuid + 2 * i, 3, "%02x", device.device_uuid()[i]);
+        std::snprintf(uuid + 2 * (VK_UUID_SIZE + i), 3, "%02x", device.driver_uuid()[i]);
+    }
+    m_device_key = std::string(device.properties.deviceName) + " " + uuid;
+    load();
+}
+
+void Autotuner::set_tuning(bool enabled, bool retune)
+{
+    m_tuning = enabled;
+    m_retune = retune;
+}
+
+bool Autotuner::needs_tuning(const std::string& kernel)
+{
+    bool cached = m_cache.count({ m_device_key, kernel }) != 0;
+    return m_tuning && m_profiler.supported() && (m_retune || !cached);
+}
+
+SpecializationConstants Autotuner::select(const std::string& kernel, std::span<const uint32_t> code,
+    VkPipelineLayout pipeline_layout, const std::vector<TuningParameter>& space, const RecordFn& record,
+    bool compute_queue, uint32_t repetitions)
+{
+    SpecializationConstants best;
+    for (const auto& parameter : space) {
+        if (parameter.values.empty()) {
+            throw std::runtime_error("tuning parameter " + parameter.name + " of " + kernel + " has no values");
+        }
+        best.set(parameter.constant_id, parameter.values.front());
+    }
+
+    auto cached = m_cache.find({ m_device_key, kernel });
+    if (cached != m_cache.end() && !(m_tuning && m_retune)) {
+        // load() only keeps entries that parse.
+        std::vector<std::pair<uint32_t, uint32_t>> values;
+        parse_constants(cached->second, values);
+        for (const auto& [id, value] : values) {
+            best.set(id, value);
+        }
+        return best;
+    }
+    if (!m_tuning || !m_profiler.supported()) {
+        return best;
+    }
+
+    // Walk every combination of parameter values like an odometer.
+    std::vector<size_t> choice(space.size(), 0);
+    double best_time = std::numeric_limits<double>::infinity();
+    while (true) {
+        SpecializationConstants variant;
+        for (size_t i = 0; i < space.size(); i++) {
+            variant.set(space[i].constant_id, space[i].values[choice[i]]);
+        }
+
+        double time = measure(code, pipeline_layout, variant, record, compute_queue, repetitions);
+        Logger::info(LogCategory::Tuning, "%s: %s -> %g ms", kernel.c_str(), variant.to_string().c_str(), time);
+        if (time < best_time) {
+            best_time = time;
+            best = variant;
+        }
+
+        size_t digit = 0;
+        while (digit < space.size() && ++choice[digit] == space[digit].values.size()) {
+            choice[digit++] = 0;
+        }
+        if (digit == space.size()) {
+            break;
+        }
+    }
+
+    if (best_time < std::numeric_limits<double>::infinity()) {
+        m_cache[{ m_device_key, kernel }] = best.to_string();
+        save();
+    }
+    return best;
+}
+
+// Median of `repetitions` timed runs after one warm-up run. Variants the driver refuses to build (e.g. a workgroup
+// larger than the device allows) never win.
+double Autotuner::measure(std::span<const uint32_t> code, VkPipelineLayout pipeline_layout,
+    const SpecializationConstants& constants, const RecordFn& record, bool compute_queue, uint32_t repetitions)
+{
+    std::unique_ptr<ComputePipeline> pipeline;
+    try {
+        pipeline = std::make_unique<ComputePipeline>(m_device, code, pipeline_layout, constants);
+    } catch (const std::runtime_error&) {
+        return std::numeric_limits<double>::infinity();
+    }
+
+    std::vector<double> times;
+    for (uint32_t run = 0; run <= repetitions; run++) {
+        VkCommandBuffer command_buffer = m_device.begin_single_time_commands(compute_queue);
+        m_profiler.begin_frame(command_buffer, 0);
+        uint32_t scope = m_profiler.begin_scope(command_buffer, "variant");
+        record(command_buffer, *pipeline, constants);
+        m_profiler.end_scope(command_buffer, scope);
+        m_device.end_single_time_commands(command_buffer, compute_queue);
+
+        const auto& results = m_profiler.collect(0, true);
+        if (run > 0 && !results.empty()) {
+            times.push_back(results[0].milliseconds);
+        }
+    }
+
+    if (times.empty()) {
+        return std::numeric_limits<double>::infinity();
+    }
+    std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+    return times[times.size() / 2];
+}
+
+// One "device<TAB>kernel<TAB>id=value ..." line per tuned kernel.
+void Autotuner::load()
+{
+    std::ifstream file { m_cache_path };
+    std::string line;
+    std::vector<std::pair<uint32_t, uint32_t>> values;
+    for (uint32_t line_number = 1; std::getline(file, line); line_number++) {
+        size_t first = line.find('\t');
+        size_t second = first == std::string::npos ? first : line.find('\t', first + 1);
+        // A hand-edited or truncated cache costs a re-measurement, not startup.
+        if (second == std::string::npos || !parse_constants(line.substr(second + 1), values)) {
+            Logger::warning(LogCategory::Tuning, "%s:%u: ignoring malformed entry", m_cache_path.c_str(), line_number);
+            continue;
+        }
+        m_cache[{ line.substr(0, first), line.substr(first + 1, second - first - 1) }] = line.substr(second + 1);
+    }
+}
+
+void Autotuner::save()
+{
+    std::ofstream file { m_cache_path, std::ios::trunc };
+    if (!file) {
+        Logger::warning(LogCategory::Tuning, "cannot write %s", m_cache_path.c_str());
+        return;
+    }
+    for (const auto& [key, constants] : m_cache) {
+        file << key.first << '\t' << key.second << '\t' << constants << '\n';
+    }
+}
+
+} // namespace Simulation
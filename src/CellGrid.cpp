@@ -0,0 +1,61 @@
+#include "CellGrid.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
+
+namespace Simulation {
+
+void CellGrid::build(const std::vector<DomainParticle>& particles, float cutoff)
+{
+    glm::vec3 min { FLT_MAX };
+    glm::vec3 max { -FLT_MAX };
+    for (const auto& particle : particles) {
+        min = glm::min(min, particle.position);
+        max = glm::max(max, particle.position);
+    }
+    if (particles.empty()) {
+        min = max = glm::vec3(0.0f);
+    }
+
+    glm::vec3 size = max - min;
+    for (int axis = 0; axis < 3; axis++) {
+        dims[axis] = std::clamp(static_cast<int>(size[axis] / cutoff), 1, MAX_CELLS_PER_AXIS);
+    }
+    origin = min;
+    cell_size = glm::max(size / glm::vec3(dims), glm::vec3(cutoff));
+
+    uint32_t cell_count = static_cast<uint32_t>(dims.x * dims.y * dims.z);
+    starts.assign(cell_count + 1, 0);
+    std::vector<uint32_t> cells(particles.size());
+    for (size_t i = 0; i < particles.size(); i++) {
+        glm::ivec3 cell = cell_of(particles[i].position);
+        cells[i] = static_cast<uint32_t>((cell.z * dims.y + cell.y) * dims.x + cell.x);
+        starts[cells[i] + 1]++;
+    }
+    for (uint32_t cell = 0; cell < cell_count; cell++) {
+        starts[cell + 1] += starts[cell];
+    }
+    std::vector<uint32_t> cursor(starts.begin(), starts.end() - 1);
+    order.resize(particles.size());
+    for (uint32_t i = 0; i < particles.size(); i++) {
+        order[cursor[cells[i]]++] = i;
+    }
+}
+
+void CellGrid::sort(std::vector<DomainParticle>& particles)
+{
+    std::vector<DomainParticle> sorted(particles.size());
+    for (size_t slot = 0; slot < order.size(); slot++) {
+        sorted[slot] = particles[order[slot]];
+    }
+    particles.swap(sorted);
+    std::iota(order.begin(), order.end(), 0u);
+}
+
+glm::ivec3 CellGrid::cell_of(const glm::vec3& position) const
+{
+    return glm::clamp(glm::ivec3(glm::floor((position - origin) / cell_size)), glm::ivec3(0), dims - 1);
+}
+
+} // namespace Simulation
@@ -0,0 +1,55 @@
+#include "ComputePipeline.hpp"
+#include "Debug.hpp"
+
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+ComputePipeline::ComputePipeline(Device& device, std::span<const uint32_t> code, VkPipelineLayout pipeline_layout,
+    const SpecializationConstants& specialization)
+    : m_device(device)
+{
+    SIM_TRACE_ZONE("ComputePipeline::ComputePipeline");
+    create_compute_pipeline(code, pipeline_layout, specialization);
+}
+
+ComputePipeline::~ComputePipeline()
+{
+    vkDestroyShaderModule(m_device.device(), m_shader_module, nullptr);
+    vkDestroyPipeline(m_device.device(), m_pipeline, nullptr);
+}
+
+void ComputePipeline::create_compute_pipeline(
+    std::span<const uint32_t> code, VkPipelineLayout pipeline_layout, const SpecializationConstants& specialization)
+{
+    VkShaderModuleCreateInfo module_info {};
+    module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    module_info.codeSize = code.size_bytes();
+    module_info.pCode = code.data();
+
+    if (vkCreateShaderModule(m_device.device(), &module_info, nullptr, &m_shader_module) != VK_SUCCESS) {
+        throw std::runtime_error("error creating shader module");
+    }
+
+    VkComputePipelineCreateInfo pipeline_info {};
+    pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipeline_info.stage.module = m_shader_module;
+    pipeline_info.stage.pName = "main";
+    pipeline_info.stage.pSpecializationInfo = specialization.info();
+    pipeline_info.layout = pipeline_layout;
+    pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+    pipeline_info.basePipelineIndex = -1;
+
+    if (vkCreateComputePipelines(m_device.device(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &m_pipeline)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline");
+    }
+}
+
+void ComputePipeline::bind(VkCommandBuffer command_buffer)
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+}
+} // namespace Simulation
@@ -0,0 +1,307 @@
+#include "ConstraintSolver.hpp"
+#include "Debug.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+
+namespace Simulation {
+
+static constexpr uint32_t ROW_GRAIN = 1024;
+static constexpr uint32_t BODY_GRAIN = 4096;
+
+ConstraintSolver::ConstraintSolver(ThreadPool& pool, const Config& config)
+    : m_pool { pool }
+    , m_config { config }
+{
+}
+
+uint32_t ConstraintSolver::add_body(const glm::vec3& position, float inverse_mass)
+{
+    m_x.push_back(position.x);
+    m_y.push_back(position.y);
+    m_z.push_back(position.z);
+    m_px.push_back(position.x);
+    m_py.push_back(position.y);
+    m_pz.push_back(position.z);
+    m_vx.push_back(0.0f);
+    m_vy.push_back(0.0f);
+    m_vz.push_back(0.0f);
+    m_inverse_mass.push_back(inverse_mass);
+    m_island.push_back(NO_ISLAND);
+    m_islands_dirty = true;
+    return body_count() - 1;
+}
+
+void ConstraintSolver::add_distance(uint32_t a, uint32_t b, float compliance)
+{
+    if (a >= body_count() || b >= body_count() || a == b) {
+        throw std::runtime_error("invalid distance constraint bodies");
+    }
+    float rest_length = glm::length(position(a) - position(b));
+    m_constraints.push_back({ .a = a, .b = b, .rest_length = rest_length, .compliance = compliance });
+    m_islands_dirty = true;
+}
+
+void ConstraintSolver::wake(uint32_t body)
+{
+    uint32_t island = m_islands_dirty ? NO_ISLAND : m_island[body];
+    if (island != NO_ISLAND && m_island_asleep[island]) {
+        m_island_asleep[island] = 0;
+        m_island_still_steps[island] = 0;
+        m_batches_dirty = true;
+    }
+}
+
+bool ConstraintSolver::asleep(uint32_t body)
+{
+    if (m_islands_dirty) {
+        return m_inverse_mass[body] == 0.0f;
+    }
+    return m_island[body] == NO_ISLAND || m_island_asleep[m_island[body]];
+}
+
+void ConstraintSolver::build_islands()
+{
+    // Union-find over dynamic bodies only: a static anchor shared by two islands does not join them, since nothing
+    // solved in one can move it.
+    std::vector<uint32_t> parent(body_count());
+    std::iota(parent.begin(), parent.end(), 0u);
+    auto find = [&](uint32_t body) {
+        while (parent[body] != body) {
+            parent[body] = parent[parent[body]];
+            body = parent[body];
+        }
+        return body;
+    };
+    for (const auto& constraint : m_constraints) {
+        if (m_inverse_mass[constraint.a] != 0.0f && m_inverse_mass[constraint.b] != 0.0f) {
+            parent[find(constraint.a)] = find(constraint.b);
+        }
+    }
+
+    std::vector<uint32_t> island_of_root(body_count(), NO_ISLAND);
+    uint32_t islands = 0;
+    for (uint32_t body = 0; body < body_count(); body++) {
+        if (m_inverse_mass[body] == 0.0f) {
+            m_island[body] = NO_ISLAND;
+            continue;
+        }
+        uint32_t& island = island_of_root[find(body)];
+        if (island == NO_ISLAND) {
+            island = islands++;
+        }
+        m_island[body] = island;
+    }
+
+    m_island_asleep.assign(islands, 0);
+    m_island_still_steps.assign(islands, 0);
+    m_islands_dirty = false;
+    m_batches_dirty = true;
+}
+
+void ConstraintSolver::build_batches()
+{
+    m_awake_bodies.clear();
+    for (uint32_t body = 0; body < body_count(); body++) {
+        if (m_island[body] != NO_ISLAND && !m_island_asleep[m_island[body]]) {
+            m_awake_bodies.push_back(body);
+        }
+    }
+
+    // Greedy coloring in insertion order. solve_rows() never writes static bodies, so they do not constrain the
+    // colors.
+    std::vector<uint64_t> used(body_count(), 0);
+    std::vector<uint8_t> colors(m_constraints.size(), MAX_COLORS);
+    uint32_t counts[MAX_COLORS] = {};
+    uint32_t color_count = 0;
+    for (size_t i = 0; i < m_constraints.size(); i++) {
+        const auto& constraint = m_constraints[i];
+        uint32_t island = m_island[constraint.a] != NO_ISLAND ? m_island[constraint.a] : m_island[constraint.b];
+        if (island == NO_ISLAND || m_island_asleep[island]) {
+            continue;
+        }
+        uint64_t taken = used[constraint.a] | used[constraint.b];
+        if (taken == ~0ull) {
+            throw std::runtime_error("constraint graph needs more than 64 colors");
+        }
+        uint32_t color = static_cast<uint32_t>(std::countr_one(taken));
+        colors[i] = static_cast<uint8_t>(color);
+        counts[color]++;
+        color_count = std::max(color_count, color + 1);
+        for (uint32_t body : { constraint.a, constraint.b }) {
+            if (m_inverse_mass[body] != 0.0f) {
+                used[body] |= 1ull << color;
+            }
+        }
+    }
+
+    m_color_starts.assign(color_count + 1, 0);
+    for (uint32_t color = 0; color < color_count; color++) {
+        m_color_starts[color + 1] = m_color_starts[color] + counts[color];
+    }
+    uint32_t rows = m_color_starts[color_count];
+    m_rows.a.resize(rows);
+    m_rows.b.resize(rows);
+    m_rows.rest_length.resize(rows);
+    m_rows.compliance.resize(rows);
+    m_rows.lambda.resize(rows);
+
+    std::vector<uint32_t> next(m_color_starts.begin(), m_color_starts.end() - 1);
+    for (size_t i = 0; i < m_constraints.size(); i++) {
+        if (colors[i] == MAX_COLORS) {
+            continue;
+        }
+        uint32_t row = next[colors[i]]++;
+        m_rows.a[row] = m_constraints[i].a;
+        m_rows.b[row] = m_constraints[i].b;
+        m_rows.rest_length[row] = m_constraints[i].rest_length;
+        m_rows.compliance[row] = m_constraints[i].compliance;
+    }
+    m_batches_dirty = false;
+}
+
+void ConstraintSolver::step(float dt)
+{
+    SIM_TRACE_ZONE("ConstraintSolver::step");
+    if (m_islands_dirty) {
+        build_islands();
+    }
+    if (m_batches_dirty) {
+        build_batches();
+    }
+    uint32_t awake = awake_body_count();
+    if (awake == 0) {
+        return;
+    }
+
+    glm::vec3 dv = m_config.gravity * dt;
+    m_pool.parallel_for(awake, BODY_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t body = m_awake_bodies[i];
+            m_px[body] = m_x[body];
+            m_py[body] = m_y[body];
+            m_pz[body] = m_z[body];
+            m_vx[body] += dv.x;
+            m_vy[body] += dv.y;
+            m_vz[body] += dv.z;
+            m_x[body] += m_vx[body] * dt;
+            m_y[body] += m_vy[body] * dt;
+            m_z[body] += m_vz[body] * dt;
+        }
+    });
+
+    std::fill(m_rows.lambda.begin(), m_rows.lambda.end(), 0.0f);
+    float inverse_dt_squared = 1.0f / (dt * dt);
+    for (uint32_t iteration = 0; iteration < m_config.iterations; iteration++) {
+        for (uint32_t color = 0; color < color_count(); color++) {
+            uint32_t first = m_color_starts[color];
+            m_pool.parallel_for(m_color_starts[color + 1] - first, ROW_GRAIN, [&](uint32_t begin, uint32_t end) {
+                solve_rows(first + begin, first + end, inverse_dt_squared);
+            });
+        }
+        // Each body has at most one ground contact, so all of them form one more color.
+        m_pool.parallel_for(awake, BODY_GRAIN, [&](uint32_t begin, uint32_t end) { solve_ground(begin, end); });
+    }
+
+    float inverse_dt = 1.0f / dt;
+    m_pool.parallel_for(awake, BODY_GRAIN, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            uint32_t body = m_awake_bodies[i];
+            m_vx[body] = (m_x[body] - m_px[body]) * inverse_dt;
+            m_vy[body] = (m_y[body] - m_py[body]) * inverse_dt;
+            m_vz[body] = (m_z[body] - m_pz[body]) * inverse_dt;
+        }
+    });
+
+    update_sleep();
+}
+
+void ConstraintSolver::solve_rows(uint32_t begin, uint32_t end, float inverse_dt_squared)
+{
+    for (uint32_t row = begin; row < end; row++) {
+        uint32_t a = m_rows.a[row];
+        uint32_t b = m_rows.b[row];
+        float wa = m_inverse_mass[a];
+        float wb = m_inverse_mass[b];
+        float dx = m_x[a] - m_x[b];
+        float dy = m_y[a] - m_y[b];
+        float dz = m_z[a] - m_z[b];
+        float length = std::sqrt(dx * dx + dy * dy + dz * dz);
+        if (length < 1e-9f) {
+            continue;
+        }
+
+        float alpha = m_rows.compliance[row] * inverse_dt_squared;
+        float error = length - m_rows.rest_length[row];
+        float delta_lambda = (-error - alpha * m_rows.lambda[row]) / (wa + wb + alpha);
+        m_rows.lambda[row] += delta_lambda;
+
+        // Static ends are shared by rows of the same color (see build_batches()), so they must not even be
+        // stored to unchanged.
+        float scale = delta_lambda / length;
+        if (wa != 0.0f) {
+            m_x[a] += wa * scale * dx;
+            m_y[a] += wa * scale * dy;
+            m_z[a] += wa * scale * dz;
+        }
+        if (wb != 0.0f) {
+            m_x[b] -= wb * scale * dx;
+            m_y[b] -= wb * scale * dy;
+            m_z[b] -= wb * scale * dz;
+        }
+    }
+}
+
+void ConstraintSolver::solve_ground(uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; i++) {
+        uint32_t body = m_awake_bodies[i];
+        if (m_y[body] >= m_config.radius) {
+            continue;
+        }
+        m_y[body] = m_config.radius;
+        m_x[body] -= (m_x[body] - m_px[body]) * m_config.friction;
+        m_z[body] -= (m_z[body] - m_pz[body]) * m_config.friction;
+    }
+}
+
+void ConstraintSolver::update_sleep()
+{
+    std::vector<uint8_t> moving(island_count(), 0);
+    float limit = m_config.sleep_speed * m_config.sleep_speed;
+    for (uint32_t body : m_awake_bodies) {
+        if (m_vx[body] * m_vx[body] + m_vy[body] * m_vy[body] + m_vz[body] * m_vz[body] > limit) {
+            moving[m_island[body]] = 1;
+        }
+    }
+
+    bool fell_asleep = false;
+    for (uint32_t island = 0; island < island_count(); island++) {
+        if (m_island_asleep[island]) {
+            continue;
+        }
+        if (moving[island]) {
+            m_island_still_steps[island] = 0;
+        } else if (++m_island_still_steps[island] >= m_config.sleep_steps) {
+            m_island_asleep[island] = 1;
+            fell_asleep = true;
+        }
+    }
+    if (!fell_asleep) {
+        return;
+    }
+
+    for (uint32_t body : m_awake_bodies) {
+        if (m_island_asleep[m_island[body]]) {
+            m_vx[body] = 0.0f;
+            m_vy[body] = 0.0f;
+            m_vz[body] = 0.0f;
+        }
+    }
+    m_batches_dirty = true;
+}
+
+} // namespace Simulation
@@ -0,0 +1,339 @@
+#include "Culling.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#    include <immintrin.h>
+#endif
+
+namespace Simulation {
+
+void AabbSoA::resize(uint32_t count)
+{
+    min_x.resize(count);
+    min_y.resize(count);
+    min_z.resize(count);
+    max_x.resize(count);
+    max_y.resize(count);
+    max_z.resize(count);
+}
+
+void AabbSoA::set(uint32_t index, const glm::vec3& min, const glm::vec3& max)
+{
+    min_x[index] = min.x;
+    min_y[index] = min.y;
+    min_z[index] = min.z;
+    max_x[index] = max.x;
+    max_y[index] = max.y;
+    max_z[index] = max.z;
+}
+
+Frustum Frustum::from_matrix(const glm::mat4& m)
+{
+    auto row = [&m](int i) { return glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]); };
+
+    Frustum frustum;
+    frustum.planes[0] = row(3) + row(0); // left
+    frustum.planes[1] = row(3) - row(0); // right
+    frustum.planes[2] = row(3) + row(1); // bottom
+    frustum.planes[3] = row(3) - row(1); // top
+    frustum.planes[4] = row(2); // near, depth is [0, 1]
+    frustum.planes[5] = row(3) - row(2); // far
+
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+void Bvh::build(const AabbSoA& boxes)
+{
+    uint32_t count = boxes.size();
+    m_order.resize(count);
+    std::iota(m_order.begin(), m_order.end(), 0u);
+
+    std::vector<glm::vec3> centers(count);
+    for (uint32_t i = 0; i < count; i++) {
+        centers[i] = glm::vec3(boxes.min_x[i] + boxes.max_x[i], boxes.min_y[i] + boxes.max_y[i],
+                         boxes.min_z[i] + boxes.max_z[i])
+            * 0.5f;
+    }
+
+    m_nodes.clear();
+    m_nodes.reserve(2 * (count / LEAF_SIZE + 1));
+    m_nodes.push_back({});
+    build_node(0, 0, count, centers);
+
+    refit(boxes);
+    m_built_area = m_area;
+}
+
+void Bvh::build_node(uint32_t node, uint32_t begin, uint32_t end, const std::vector<glm::vec3>& centers)
+{
+    if (end - begin <= LEAF_SIZE) {
+        m_nodes[node].first = begin;
+        m_nodes[node].count = end - begin;
+        return;
+    }
+
+    glm::vec3 lo = centers[m_order[begin]];
+    glm::vec3 hi = lo;
+    for (uint32_t i = begin + 1; i < end; i++) {
+        lo = glm::min(lo, centers[m_order[i]]);
+        hi = glm::max(hi, centers[m_order[i]]);
+    }
+    glm::vec3 extent = hi - lo;
+    int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+
+    // Median split keeps the tree balanced, which matters more than split quality when it is refit, not rebuilt.
+    uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(m_order.begin() + begin, m_order.begin() + mid, m_order.begin() + end,
+        [&](uint32_t a, uint32_t b) { return centers[a][axis] < centers[b][axis]; });
+
+    uint32_t left = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back({});
+    m_nodes.push_back({});
+    m_nodes[node].first = left;
+    m_nodes[node].count = 0;
+
+    build_node(left, begin, mid, centers);
+    build_node(left + 1, mid, end, centers);
+}
+
+void Bvh::refit(const AabbSoA& boxes)
+{
+    uint32_t count = object_count();
+    if (boxes.size() != count) {
+        throw std::runtime_error("bvh refit with a different object count, rebuild instead");
+    }
+
+    // Leaves start anywhere, so the last one may load up to three boxes past the end.
+    uint32_t padded = count + 3;
+    m_leaf_boxes.resize(padded);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t src = m_order[i];
+        m_leaf_boxes.min_x[i] = boxes.min_x[src];
+        m_leaf_boxes.min_y[i] = boxes.min_y[src];
+        m_leaf_boxes.min_z[i] = boxes.min_z[src];
+        m_leaf_boxes.max_x[i] = boxes.max_x[src];
+        m_leaf_boxes.max_y[i] = boxes.max_y[src];
+        m_leaf_boxes.max_z[i] = boxes.max_z[src];
+    }
+    for (uint32_t i = count; i < padded; i++) {
+        m_leaf_boxes.set(i, glm::vec3(0.0f), glm::vec3(0.0f));
+    }
+
+    // Children are always stored after their parent, so one reverse sweep refits bottom up.
+    for (uint32_t n = static_cast<uint32_t>(m_nodes.size()); n-- > 0;) {
+        Node& node = m_nodes[n];
+        if (node.count == 0 && node.first > n) {
+            const Node& a = m_nodes[node.first];
+            const Node& b = m_nodes[node.first + 1];
+            node.min = glm::min(a.min, b.min);
+            node.max = glm::max(a.max, b.max);
+            continue;
+        }
+
+        if (node.count == 0) {
+            node.min = node.max = glm::vec3(0.0f);
+            continue;
+        }
+
+        uint32_t i = node.first;
+        node.min = { m_leaf_boxes.min_x[i], m_leaf_boxes.min_y[i], m_leaf_boxes.min_z[i] };
+        node.max = { m_leaf_boxes.max_x[i], m_leaf_boxes.max_y[i], m_leaf_boxes.max_z[i] };
+        for (i++; i < node.first + node.count; i++) {
+            node.min = glm::min(
+                node.min, glm::vec3(m_leaf_boxes.min_x[i], m_leaf_boxes.min_y[i], m_leaf_boxes.min_z[i]));
+            node.max = glm::max(
+                node.max, glm::vec3(m_leaf_boxes.max_x[i], m_leaf_boxes.max_y[i], m_leaf_boxes.max_z[i]));
+        }
+    }
+
+    m_area = 0.0f;
+    for (const Node& node : m_nodes) {
+        m_area += surface_area(node);
+    }
+}
+
+float Bvh::surface_area(const Node& node) const
+{
+    glm::vec3 d = node.max - node.min;
+    return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+}
+
+bool Bvh::needs_rebuild() const
+{
+    // Refitting never changes the topology, so once objects have drifted far from where they were grouped the
+    // nodes (and with them the tests a cull visits) grow. The root alone misses objects that move past each other
+    // inside a fixed region, e.g. on orbits, so all nodes count. Twice the built area is a cheap trigger.
+    return !m_nodes.empty() && m_area > 2.0f * m_built_area + 1e-6f;
+}
+
+enum class Containment {
+    OUTSIDE,
+    INTERSECTS,
+    INSIDE,
+};
+
+static Containment classify(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max)
+{
+    Containment result = Containment::INSIDE;
+    for (const auto& plane : frustum.planes) {
+        glm::vec3 positive { plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y,
+            plane.z >= 0.0f ? max.z : min.z };
+        glm::vec3 negative { plane.x >= 0.0f ? min.x : max.x, plane.y >= 0.0f ? min.y : max.y,
+            plane.z >= 0.0f ? min.z : max.z };
+        if (glm::dot(glm::vec3(plane), positive) + plane.w < 0.0f)
+            return Containment::OUTSIDE;
+        if (glm::dot(glm::vec3(plane), negative) + plane.w < 0.0f)
+            result = Containment::INTERSECTS;
+    }
+    return result;
+}
+
+void Bvh::accept_all(const Node& node, std::vector<uint32_t>& visible) const
+{
+    if (node.count > 0) {
+        visible.insert(visible.end(), m_order.begin() + node.first, m_order.begin() + node.first + node.count);
+        return;
+    }
+    accept_all(m_nodes[node.first], visible);
+    accept_all(m_nodes[node.first + 1], visible);
+}
+
+void Bvh::cull_node(const Frustum& frustum, uint32_t index, std::vector<uint32_t>& visible) const
+{
+    const Node& node = m_nodes[index];
+    switch (classify(frustum, node.min, node.max)) {
+    case Containment::OUTSIDE:
+        return;
+    case Containment::INSIDE:
+        accept_all(node, visible);
+        return;
+    case Containment::INTERSECTS:
+        break;
+    }
+
+    if (node.count > 0) {
+        cull_leaf(frustum, node, visible);
+    } else {
+        cull_node(frustum, node.first, visible);
+        cull_node(frustum, node.first + 1, visible);
+    }
+}
+
+void Bvh::cull_leaf(const Frustum& frustum, const Node& leaf, std::vector<uint32_t>& visible) const
+{
+    uint32_t end = leaf.first + leaf.count;
+
+#if defined(__SSE2__)
+    // Four boxes per iteration: for each plane the box corner furthest along the normal is max(n * min, n * max)
+    // per axis, and the box is outside when even that corner is behind the plane.
+    for (uint32_t i = leaf.first; i < end; i += 4) {
+        __m128 min_x = _mm_loadu_ps(&m_leaf_boxes.min_x[i]);
+        __m128 min_y = _mm_loadu_ps(&m_leaf_boxes.min_y[i]);
+        __m128 min_z = _mm_loadu_ps(&m_leaf_boxes.min_z[i]);
+        __m128 max_x = _mm_loadu_ps(&m_leaf_boxes.max_x[i]);
+        __m128 max_y = _mm_loadu_ps(&m_leaf_boxes.max_y[i]);
+        __m128 max_z = _mm_loadu_ps(&m_leaf_boxes.max_z[i]);
+
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const auto& plane : frustum.planes) {
+            __m128 nx = _mm_set1_ps(plane.x);
+            __m128 ny = _mm_set1_ps(plane.y);
+            __m128 nz = _mm_set1_ps(plane.z);
+            __m128 dx = _mm_max_ps(_mm_mul_ps(nx, min_x), _mm_mul_ps(nx, max_x));
+            __m128 dy = _mm_max_ps(_mm_mul_ps(ny, min_y), _mm_mul_ps(ny, max_y));
+            __m128 dz = _mm_max_ps(_mm_mul_ps(nz, min_z), _mm_mul_ps(nz, max_z));
+            __m128 distance = _mm_add_ps(_mm_add_ps(dx, dy), _mm_add_ps(dz, _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, _mm_setzero_ps()));
+        }
+
+        uint32_t lanes = std::min(end - i, 4u);
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside)) & ((1u << lanes) - 1);
+        while (mask != 0) {
+            uint32_t lane = static_cast<uint32_t>(__builtin_ctz(mask));
+            visible.push_back(m_order[i + lane]);
+            mask &= mask - 1;
+        }
+    }
+#else
+    for (uint32_t i = leaf.first; i < end; i++) {
+        glm::vec3 min { m_leaf_boxes.min_x[i], m_leaf_boxes.min_y[i], m_leaf_boxes.min_z[i] };
+        glm::vec3 max { m_leaf_boxes.max_x[i], m_leaf_boxes.max_y[i], m_leaf_boxes.max_z[i] };
+        if (classify(frustum, min, max) != Containment::OUTSIDE) {
+            visible.push_back(m_order[i]);
+        }
+    }
+#endif
+}
+
+uint32_t Bvh::cull(const Frustum& frustum, ThreadPool& pool, void* dst, uint32_t capacity,
+    const void* src_instances, uint32_t stride) const
+{
+    if (m_order.empty())
+        return 0;
+
+    // Expand the top of the tree until there are a few subtrees per thread to balance over.
+    std::vector<uint32_t> roots { 0 };
+    uint32_t target = pool.size() * 4;
+    while (roots.size() < target) {
+        std::vector<uint32_t> next;
+        for (uint32_t index : roots) {
+            const Node& node = m_nodes[index];
+            if (node.count > 0) {
+                next.push_back(index);
+            } else {
+                next.push_back(node.first);
+                next.push_back(node.first + 1);
+            }
+        }
+        if (next.size() == roots.size())
+            break;
+        roots = std::move(next);
+    }
+
+    uint32_t task_count = static_cast<uint32_t>(roots.size());
+    std::vector<std::vector<uint32_t>> visible(task_count);
+    pool.parallel_for(task_count, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; t++) {
+            cull_node(frustum, roots[t], visible[t]);
+        }
+    });
+
+    std::vector<uint32_t> offsets(task_count + 1, 0);
+    for (uint32_t t = 0; t < task_count; t++) {
+        offsets[t + 1] = offsets[t] + static_cast<uint32_t>(visible[t].size());
+    }
+    uint32_t total = std::min(offsets[task_count], capacity);
+
+    // Each task writes its own disjoint range of the output, so the scatter needs no synchronisation.
+    char* out = static_cast<char*>(dst);
+    const char* src = static_cast<const char*>(src_instances);
+    pool.parallel_for(task_count, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t t = begin; t < end; t++) {
+            uint32_t first = offsets[t];
+            uint32_t count = std::min(static_cast<uint32_t>(visible[t].size()), total - std::min(first, total));
+            if (count == 0) {
+                continue;
+            }
+            if (src == nullptr) {
+                std::memcpy(out + static_cast<size_t>(first) * sizeof(uint32_t), visible[t].data(),
+                    count * sizeof(uint32_t));
+                continue;
+            }
+            for (uint32_t k = 0; k < count; k++) {
+                std::memcpy(out + static_cast<size_t>(first + k) * stride,
+                    src + static_cast<size_t>(visible[t][k]) * stride, stride);
+            }
+        }
+    });
+
+    return total;
+}
+
+} // namespace Simulation
@@ -0,0 +1,163 @@
+#include "Debug.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace Simulation {
+
+static void write_string(std::ofstream& file, const std::string& text)
+{
+    file << '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            file << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            file << ' ';
+        } else {
+            file << c;
+        }
+    }
+    file << '"';
+}
+
+// A complete ("X") event; Chrome trace times are microseconds, the fraction keeps nanoseconds.
+static void write_event(std::ofstream& file, const std::string& name, uint32_t pid, uint32_t tid, uint64_t begin,
+    uint64_t end, uint64_t base)
+{
+    char times[96];
+    std::snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", (begin - base) * 1e-3, (end - begin) * 1e-3);
+    file << ",\n{\"ph\":\"X\",\"name\":";
+    write_string(file, name);
+    file << ",\"pid\":" << pid << ",\"tid\":" << tid << ',' << times << '}';
+}
+
+static void write_metadata(std::ofstream& file, const char* kind, uint32_t pid, uint32_t tid, const std::string& name)
+{
+    file << ",\n{\"ph\":\"M\",\"name\":\"" << kind << "\",\"pid\":" << pid << ",\"tid\":" << tid
+         << ",\"args\":{\"name\":";
+    write_string(file, name);
+    file << "}}";
+}
+
+Trace& Trace::instance()
+{
+    static Trace trace;
+    return trace;
+}
+
+Trace::ThreadBuffer& Trace::thread_buffer()
+{
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& slot = m_threads.emplace_back(std::make_unique<ThreadBuffer>());
+        slot->id = static_cast<uint32_t>(m_threads.size());
+        slot->name = "thread " + std::to_string(slot->id);
+        buffer = slot.get();
+    }
+    return *buffer;
+}
+
+void Trace::set_thread_name(const std::string& name)
+{
+    ThreadBuffer& buffer = thread_buffer();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    buffer.name = name;
+}
+
+void Trace::record(const char* name, uint64_t begin, uint64_t end)
+{
+    ThreadBuffer& buffer = thread_buffer();
+    // Only this thread writes the count, so a relaxed load sees its own latest value.
+    uint32_t index = buffer.count.load(std::memory_order_relaxed);
+    uint32_t chunk = index / CHUNK_EVENTS;
+    if (chunk == MAX_CHUNKS) {
+        buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (index % CHUNK_EVENTS == 0) {
+        buffer.chunks[chunk] = std::make_unique<Event[]>(CHUNK_EVENTS);
+    }
+    buffer.chunks[chunk][index % CHUNK_EVENTS] = { name, begin, end };
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void Trace::record_gpu(const std::string& track, const std::string& name, uint64_t begin, uint64_t end)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_gpu_events.size() >= MAX_GPU_EVENTS) {
+        m_gpu_dropped++;
+        return;
+    }
+    m_gpu_events.push_back({ track, name, begin, end });
+}
+
+uint64_t Trace::write(const std::string& path)
+{
+    std::ofstream file { path, std::ios::trunc };
+    if (!file) {
+        throw std::runtime_error("failed to open trace file " + path);
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<uint32_t> counts;
+    uint64_t base = ~0ull;
+    for (const auto& buffer : m_threads) {
+        counts.push_back(buffer->count.load(std::memory_order_acquire));
+        for (uint32_t i = 0; i < counts.back(); i++) {
+            base = std::min(base, buffer->chunks[i / CHUNK_EVENTS][i % CHUNK_EVENTS].begin);
+        }
+    }
+    for (const auto& event : m_gpu_events) {
+        base = std::min(base, event.begin);
+    }
+
+    constexpr uint32_t CPU_PID = 1;
+    constexpr uint32_t GPU_PID = 2;
+    file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    file << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << CPU_PID << ",\"args\":{\"name\":\"CPU\"}}";
+    write_metadata(file, "process_name", GPU_PID, 0, "GPU");
+
+    uint64_t written = 0;
+    for (size_t t = 0; t < m_threads.size(); t++) {
+        const ThreadBuffer& buffer = *m_threads[t];
+        write_metadata(file, "thread_name", CPU_PID, buffer.id, buffer.name);
+        for (uint32_t i = 0; i < counts[t]; i++) {
+            const Event& event = buffer.chunks[i / CHUNK_EVENTS][i % CHUNK_EVENTS];
+            write_event(file, event.name, CPU_PID, buffer.id, event.begin, event.end, base);
+        }
+        written += counts[t];
+    }
+
+    std::vector<std::string> tracks;
+    for (const auto& event : m_gpu_events) {
+        auto track = std::find(tracks.begin(), tracks.end(), event.track);
+        if (track == tracks.end()) {
+            track = tracks.insert(track, event.track);
+            write_metadata(file, "thread_name", GPU_PID, static_cast<uint32_t>(tracks.size()), event.track);
+        }
+        uint32_t tid = static_cast<uint32_t>(track - tracks.begin()) + 1;
+        write_event(file, event.name, GPU_PID, tid, event.begin, event.end, base);
+    }
+    written += m_gpu_events.size();
+
+    file << "\n]}\n";
+    if (!file) {
+        throw std::runtime_error("failed to write trace file " + path);
+    }
+    return written;
+}
+
+uint64_t Trace::dropped()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t dropped = m_gpu_dropped;
+    for (const auto& buffer : m_threads) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+} // namespace Simulation
@@ -1,8 +1,11 @@
 #include "Device.hpp"
+#include "Debug.hpp"
+#include "Logger.hpp"
+#include "TimelineSemaphore.hpp"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
 #include <cstring>
-#include <iostream>
 #include <set>
 #include <unordered_set>
 #include <vulkan/vulkan_core.h>
@@ -13,7 +16,18 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(VkDebugUtilsMessageSeverityF
     VkDebugUtilsMessageTypeFlagsEXT messageType, const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
     void* pUserData)
 {
-    std::cerr << "validation layer: " << pCallbackData->pMessage << std::endl;
+    // Called on whichever thread made the Vulkan call, so this must not wait on I/O.
+    LogCategory category = messageType & VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT ? LogCategory::Performance
+                                                                                         : LogCategory::Validation;
+    LogSeverity severity = LogSeverity::Debug;
+    if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT) {
+        severity = LogSeverity::Error;
+    } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT) {
+        severity = LogSeverity::Warning;
+    } else if (messageSeverity & VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT) {
+        severity = LogSeverity::Info;
+    }
+    Logger::instance().log(severity, category, "%s", pCallbackData->pMessage);
     return VK_FALSE;
 }
 
@@ -35,35 +49,56 @@ void destroy_debug_utils_messenger_ext(
     if (func != nullptr) {
         return func(instance, debug_messenger, allocator);
     }
-    std::cerr << "failed to destory debug utils messenger EXT\n";
+    Logger::error(LogCategory::Device, "failed to destroy debug utils messenger");
 }
 
 Device::Device(Window& window)
-    : m_window { window }
+    : m_window { &window }
+{
+    init();
+}
+
+Device::Device()
+    : m_window { nullptr }
+{
+    m_device_ext.clear();
+    init();
+}
+
+void Device::init()
 {
+    SIM_TRACE_ZONE("Device::init");
     create_instance();
     setup_debug_messenger();
     create_surface();
     pick_physcial_device();
     create_logical_device();
     create_command_pool();
+    m_graphics_timeline = std::make_unique<TimelineSemaphore>(m_device);
+    m_compute_timeline = std::make_unique<TimelineSemaphore>(m_device);
 }
 
 Device::~Device()
 {
+    m_graphics_timeline.reset();
+    m_compute_timeline.reset();
     vkDestroyCommandPool(m_device, m_command_pool, nullptr);
+    vkDestroyCommandPool(m_device, m_compute_command_pool, nullptr);
     vkDestroyDevice(m_device, nullptr);
 
     if (enable_validation_layers) {
         destroy_debug_utils_messenger_ext(m_instance, m_debug_messenger, nullptr);
     }
 
-    vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    if (m_surface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
+    }
     vkDestroyInstance(m_instance, nullptr);
 }
 
 void Device::create_instance()
 {
+    SIM_TRACE_ZONE("Device::create_instance");
     if (enable_validation_layers && !check_validation_layer_support()) {
         throw std::runtime_error("validation layers requests, but not available!");
     }
@@ -74,7 +109,7 @@ void Device::create_instance()
         .applicationVersion = VK_MAKE_VERSION(0, 0, 1),
         .pEngineName = "No Engine",
         .engineVersion = VK_MAKE_VERSION(0, 0, 1),
-        .apiVersion = VK_API_VERSION_1_0,
+        .apiVersion = VK_API_VERSION_1_3,
     };
 
     auto extensions = get_required_ext();
@@ -103,6 +138,7 @@ void Device::create_instance()
 
 void Device::pick_physcial_device()
 {
+    SIM_TRACE_ZONE("Device::pick_physcial_device");
     uint32_t device_count = 0;
     vkEnumeratePhysicalDevices(m_instance, &device_count, nullptr);
     if (device_count == 0) {
@@ -123,16 +159,39 @@ void Device::pick_physcial_device()
         throw std::runtime_error("failed to find a suitable GPU with Vulkan support");
     }
 
-    vkGetPhysicalDeviceProperties(m_physical_device, &properties);
-    std::cout << "physical device: " << properties.deviceName << std::endl;
+    VkPhysicalDeviceVulkan11Properties properties_11 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES,
+    };
+    VkPhysicalDeviceProperties2 properties_2 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &properties_11,
+    };
+    vkGetPhysicalDeviceProperties2(m_physical_device, &properties_2);
+    properties = properties_2.properties;
+    std::memcpy(m_device_uuid, properties_11.deviceUUID, VK_UUID_SIZE);
+    std::memcpy(m_driver_uuid, properties_11.driverUUID, VK_UUID_SIZE);
+    VkSubgroupFeatureFlags arithmetic
+        = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    m_subgroup_arithmetic = (properties_11.subgroupSupportedStages & VK_SHADER_STAGE_COMPUTE_BIT)
+        && (properties_11.subgroupSupportedOperations & arithmetic) == arithmetic;
+    Logger::info(LogCategory::Device, "physical device: %s", properties.deviceName);
+
+    m_calibrated_timestamps
+        = check_optional_ext_support(m_physical_device, VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)
+        && supports_monotonic_time_domain(m_physical_device);
+    if (m_calibrated_timestamps) {
+        m_device_ext.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+    }
 }
 
 void Device::create_logical_device()
 {
+    SIM_TRACE_ZONE("Device::create_logical_device");
     QueueFamilyIndicies indicies = find_queue_families(m_physical_device);
 
     std::vector<VkDeviceQueueCreateInfo> create_info_queue;
-    std::set<uint32_t> unique_que_familes = { indicies.graphics_family, indicies.present_family };
+    std::set<uint32_t> unique_que_familes
+        = { indicies.graphics_family, indicies.present_family, indicies.compute_family };
 
     float queue_priority = 1.0f;
     for (uint32_t family : unique_que_familes) {
@@ -145,13 +204,42 @@ void Device::create_logical_device()
         create_info_queue.push_back(create_info);
     }
 
-    VkPhysicalDeviceFeatures device_featues = { .samplerAnisotropy = VK_TRUE };
+    // GPU-driven rendering wants these when the device has them; everything else keeps working without.
+    // Timeline semaphores and synchronization2 are required, is_device_suitable() has checked for them.
+    VkPhysicalDeviceVulkan12Features supported_12 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+    VkPhysicalDeviceFeatures2 supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &supported_12,
+    };
+    vkGetPhysicalDeviceFeatures2(m_physical_device, &supported);
+    m_enabled_features = {
+        .multiDrawIndirect = supported.features.multiDrawIndirect,
+        .drawIndirectFirstInstance = supported.features.drawIndirectFirstInstance,
+        .samplerAnisotropy = VK_TRUE,
+    };
+    m_draw_indirect_count = supported_12.drawIndirectCount;
+
+    VkPhysicalDeviceVulkan13Features features_13 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .synchronization2 = VK_TRUE,
+    };
+    VkPhysicalDeviceVulkan12Features features_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &features_13,
+        .drawIndirectCount = supported_12.drawIndirectCount,
+        .timelineSemaphore = VK_TRUE,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features_12,
+        .features = m_enabled_features,
+    };
 
     VkDeviceCreateInfo create_info = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+        .pNext = &features,
         .queueCreateInfoCount = static_cast<uint32_t>(create_info_queue.size()),
         .pQueueCreateInfos = create_info_queue.data(),
-        .pEnabledFeatures = &device_featues,
     };
     create_info.ppEnabledExtensionNames = m_device_ext.data();
     create_info.enabledExtensionCount = static_cast<uint32_t>(m_device_ext.size());
@@ -167,12 +255,22 @@ void Device::create_logical_device()
         throw std::runtime_error("failed to create logical device");
     }
 
+    if (m_calibrated_timestamps) {
+        m_get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(
+            vkGetDeviceProcAddr(m_device, "vkGetCalibratedTimestampsEXT"));
+    }
+
     vkGetDeviceQueue(m_device, indicies.graphics_family, 0, &m_graphics_queue);
     vkGetDeviceQueue(m_device, indicies.present_family, 0, &m_present_queue);
+    vkGetDeviceQueue(m_device, indicies.compute_family, 0, &m_compute_queue);
+    m_graphics_family = indicies.graphics_family;
+    m_compute_family = indicies.compute_family;
+    Logger::info(LogCategory::Device, "compute queue: %s", has_async_compute() ? "async" : "shared with graphics");
 }
 
 void Device::create_command_pool()
 {
+    SIM_TRACE_ZONE("Device::create_command_pool");
     QueueFamilyIndicies indicies = find_physical_queue_families();
 
     VkCommandPoolCreateInfo pool_info = {
@@ -183,9 +281,19 @@ void Device::create_command_pool()
     if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_command_pool) != VK_SUCCESS) {
         throw std::runtime_error("failed to create command pool");
     }
+    pool_info.queueFamilyIndex = indicies.compute_family;
+    if (vkCreateCommandPool(m_device, &pool_info, nullptr, &m_compute_command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute command pool");
+    }
 }
 
-void Device::create_surface() { m_window.create_window_surface(m_instance, &m_surface); }
+void Device::create_surface()
+{
+    SIM_TRACE_ZONE("Device::create_surface");
+    if (!headless()) {
+        m_window->create_window_surface(m_instance, &m_surface);
+    }
+}
 
 bool Device::is_device_suitable(VkPhysicalDevice device)
 {
@@ -195,15 +303,33 @@ bool Device::is_device_suitable(VkPhysicalDevice device)
 
     bool swap_chain_adequate = false;
 
-    if (ext_supported) {
+    if (headless()) {
+        swap_chain_adequate = true;
+    } else if (ext_supported) {
         SwapChainSupportDetails details = query_swap_chain_support(device);
         swap_chain_adequate = !details.formats.empty() && !details.present_modes.empty();
     }
 
-    VkPhysicalDeviceFeatures supported_featues;
-    vkGetPhysicalDeviceFeatures(device, &supported_featues);
+    VkPhysicalDeviceProperties props;
+    vkGetPhysicalDeviceProperties(device, &props);
+    if (props.apiVersion < VK_API_VERSION_1_3) {
+        return false;
+    }
+
+    VkPhysicalDeviceVulkan13Features features_13 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
+    VkPhysicalDeviceVulkan12Features features_12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &features_13,
+    };
+    VkPhysicalDeviceFeatures2 supported_featues = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features_12,
+    };
+    vkGetPhysicalDeviceFeatures2(device, &supported_featues);
 
-    return indicies.is_complete() && ext_supported && swap_chain_adequate && supported_featues.samplerAnisotropy;
+    return indicies.is_complete() && ext_supported && swap_chain_adequate
+        && supported_featues.features.samplerAnisotropy && features_12.timelineSemaphore
+        && features_13.synchronization2;
 }
 
 void Device::populate_debug_messanger_create_info(VkDebugUtilsMessengerCreateInfoEXT& create_info)
@@ -220,6 +346,7 @@ void Device::populate_debug_messanger_create_info(VkDebugUtilsMessengerCreateInf
 
 void Device::setup_debug_messenger()
 {
+    SIM_TRACE_ZONE("Device::setup_debug_messenger");
     if (!enable_validation_layers)
         return;
     VkDebugUtilsMessengerCreateInfoEXT create_info;
@@ -255,11 +382,13 @@ bool Device::check_validation_layer_support()
 
 std::vector<const char*> Device::get_required_ext()
 {
-    uint32_t glfw_ext_count = 0;
-    const char** glfw_ext;
-    glfw_ext = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
-
-    std::vector<const char*> extensions(glfw_ext, glfw_ext + glfw_ext_count);
+    std::vector<const char*> extensions;
+    if (!headless()) {
+        uint32_t glfw_ext_count = 0;
+        const char** glfw_ext;
+        glfw_ext = glfwGetRequiredInstanceExtensions(&glfw_ext_count);
+        extensions.assign(glfw_ext, glfw_ext + glfw_ext_count);
+    }
 
     if (enable_validation_layers) {
         extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -304,6 +433,56 @@ bool Device::check_device_ext_support(VkPhysicalDevice device)
     return required_ext.empty();
 }
 
+bool Device::check_optional_ext_support(VkPhysicalDevice device, const char* extension)
+{
+    uint32_t ext_count = 0;
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &ext_count, nullptr);
+
+    std::vector<VkExtensionProperties> available_ext(ext_count);
+    vkEnumerateDeviceExtensionProperties(device, nullptr, &ext_count, available_ext.data());
+
+    for (const auto& ext : available_ext) {
+        if (strcmp(ext.extensionName, extension) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool Device::supports_monotonic_time_domain(VkPhysicalDevice device)
+{
+    auto get_time_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+        vkGetInstanceProcAddr(m_instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+    if (get_time_domains == nullptr) {
+        return false;
+    }
+
+    uint32_t domain_count = 0;
+    get_time_domains(device, &domain_count, nullptr);
+    std::vector<VkTimeDomainEXT> domains(domain_count);
+    get_time_domains(device, &domain_count, domains.data());
+    return std::find(domains.begin(), domains.end(), VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT) != domains.end();
+}
+
+bool Device::calibrate_timestamps(uint64_t& gpu_ticks, uint64_t& cpu_nanoseconds)
+{
+    if (m_get_calibrated_timestamps == nullptr) {
+        return false;
+    }
+
+    VkCalibratedTimestampInfoEXT infos[2] = {
+        { .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT },
+        { .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT },
+    };
+    uint64_t timestamps[2];
+    uint64_t max_deviation;
+    if (m_get_calibrated_timestamps(m_device, 2, infos, timestamps, &max_deviation) != VK_SUCCESS) {
+        return false;
+    }
+    gpu_ticks = timestamps[0];
+    cpu_nanoseconds = timestamps[1];
+    return true;
+}
+
 QueueFamilyIndicies Device::find_queue_families(VkPhysicalDevice device)
 {
     QueueFamilyIndicies indicies;
@@ -320,8 +499,11 @@ QueueFamilyIndicies Device::find_queue_families(VkPhysicalDevice device)
             indicies.graphics_family = i;
             indicies.graphics_family_has_value = true;
         }
-        VkBool32 present_support = false;
-        vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &present_support);
+        // Headless devices never present; the graphics family stands in so the queue setup stays the same.
+        VkBool32 present_support = headless() && (que.queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        if (!headless()) {
+            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &present_support);
+        }
         if (que.queueCount > 0 && present_support) {
             indicies.present_family = i;
             indicies.present_family_has_value = true;
@@ -330,6 +512,17 @@ QueueFamilyIndicies Device::find_queue_families(VkPhysicalDevice device)
             break;
         i++;
     }
+
+    // Compute work only overlaps graphics work when it goes to a queue of its own family.
+    indicies.compute_family = indicies.graphics_family;
+    for (uint32_t family = 0; family < queue_family_count; family++) {
+        VkQueueFlags flags = queue_family_prop[family].queueFlags;
+        if (queue_family_prop[family].queueCount > 0 && (flags & VK_QUEUE_COMPUTE_BIT)
+            && !(flags & VK_QUEUE_GRAPHICS_BIT)) {
+            indicies.compute_family = family;
+            break;
+        }
+    }
     return indicies;
 }
 
@@ -381,7 +574,7 @@ uint32_t Device::find_memory_type(uint32_t type_filter, VkMemoryPropertyFlags pr
     VkPhysicalDeviceMemoryProperties mem_props;
     vkGetPhysicalDeviceMemoryProperties(m_physical_device, &mem_props);
     for (uint32_t i = 0; i < mem_props.memoryTypeCount; ++i) {
-        if ((type_filter & (i << i) && (mem_props.memoryTypes[i].propertyFlags & properties) == properties)) {
+        if ((type_filter & (1 << i)) && (mem_props.memoryTypes[i].propertyFlags & properties) == properties) {
             return i;
         }
     }
@@ -417,12 +610,12 @@ void Device::create_buffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemory
     vkBindBufferMemory(m_device, buffer, buffer_memory, 0);
 }
 
-VkCommandBuffer Device::begin_single_time_commands()
+VkCommandBuffer Device::begin_single_time_commands(bool compute_queue)
 {
     VkCommandBufferAllocateInfo alloc_info {};
     alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandPool = m_command_pool;
+    alloc_info.commandPool = compute_queue ? m_compute_command_pool : m_command_pool;
     alloc_info.commandBufferCount = 1;
 
     VkCommandBuffer command_buffer;
@@ -436,19 +629,62 @@ VkCommandBuffer Device::begin_single_time_commands()
     return command_buffer;
 }
 
-void Device::end_single_time_commands(VkCommandBuffer command_buffer)
+void Device::end_single_time_commands(VkCommandBuffer command_buffer, bool compute_queue)
 {
     vkEndCommandBuffer(command_buffer);
 
-    VkSubmitInfo submit_info {};
-    submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &command_buffer;
+    // Only this submission is waited for, frames already in flight keep running.
+    if (compute_queue) {
+        m_compute_timeline->wait(submit_compute({ command_buffer }));
+        vkFreeCommandBuffers(m_device, m_compute_command_pool, 1, &command_buffer);
+    } else {
+        m_graphics_timeline->wait(submit_graphics({ command_buffer }));
+        vkFreeCommandBuffers(m_device, m_command_pool, 1, &command_buffer);
+    }
+}
 
-    vkQueueSubmit(m_graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-    vkQueueWaitIdle(m_graphics_queue);
+uint64_t Device::submit_graphics(const std::vector<VkCommandBuffer>& command_buffers,
+    const std::vector<VkSemaphoreSubmitInfo>& waits, const std::vector<VkSemaphoreSubmitInfo>& signals)
+{
+    return submit(m_graphics_queue, *m_graphics_timeline, command_buffers, waits, signals);
+}
 
-    vkFreeCommandBuffers(m_device, m_command_pool, 1, &command_buffer);
+uint64_t Device::submit_compute(const std::vector<VkCommandBuffer>& command_buffers,
+    const std::vector<VkSemaphoreSubmitInfo>& waits, const std::vector<VkSemaphoreSubmitInfo>& signals)
+{
+    return submit(m_compute_queue, *m_compute_timeline, command_buffers, waits, signals);
+}
+
+uint64_t Device::submit(VkQueue queue, TimelineSemaphore& timeline,
+    const std::vector<VkCommandBuffer>& command_buffers, const std::vector<VkSemaphoreSubmitInfo>& waits,
+    const std::vector<VkSemaphoreSubmitInfo>& signals)
+{
+    std::vector<VkCommandBufferSubmitInfo> buffer_infos;
+    buffer_infos.reserve(command_buffers.size());
+    for (VkCommandBuffer command_buffer : command_buffers) {
+        buffer_infos.push_back({
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .commandBuffer = command_buffer,
+        });
+    }
+
+    uint64_t value = timeline.reserve();
+    std::vector<VkSemaphoreSubmitInfo> signal_infos = signals;
+    signal_infos.push_back(timeline.submit_info(value, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT));
+
+    VkSubmitInfo2 submit_info = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .waitSemaphoreInfoCount = static_cast<uint32_t>(waits.size()),
+        .pWaitSemaphoreInfos = waits.data(),
+        .commandBufferInfoCount = static_cast<uint32_t>(buffer_infos.size()),
+        .pCommandBufferInfos = buffer_infos.data(),
+        .signalSemaphoreInfoCount = static_cast<uint32_t>(signal_infos.size()),
+        .pSignalSemaphoreInfos = signal_infos.data(),
+    };
+    if (vkQueueSubmit2(queue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit command buffers");
+    }
+    return value;
 }
 
 void Device::copy_buffer(VkBuffer src, VkBuffer dest, VkDeviceSize size)
@@ -488,10 +724,14 @@ void Device::copy_buffer_to_image(VkBuffer buffer, VkImage image, uint32_t width
 void Device::create_image_with_info(
     const VkImageCreateInfo& image_info, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory)
 {
+    if (vkCreateImage(m_device, &image_info, nullptr, &image) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create image");
+    }
+
     VkMemoryRequirements meme_req;
     vkGetImageMemoryRequirements(m_device, image, &meme_req);
 
-    VkMemoryAllocateInfo alloc_info;
+    VkMemoryAllocateInfo alloc_info {};
     alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
     alloc_info.allocationSize = meme_req.size;
     alloc_info.memoryTypeIndex = find_memory_type(meme_req.memoryTypeBits, properties);
@@ -504,4 +744,11 @@ void Device::create_image_with_info(
         throw std::runtime_error("failed to bind image memeory");
     }
 }
+
+void Device::cmd_draw_indexed_indirect_count(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize offset,
+    VkBuffer count_buffer, VkDeviceSize count_offset, uint32_t max_draw_count, uint32_t stride)
+{
+    vkCmdDrawIndexedIndirectCount(
+        command_buffer, buffer, offset, count_buffer, count_offset, max_draw_count, stride);
+}
 } // namespace Simulation
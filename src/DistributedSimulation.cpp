@@ -0,0 +1,276 @@
+#include "DistributedSimulation.hpp"
+#include "Debug.hpp"
+#include "ParticleSimulation.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace Simulation {
+
+template <typename T>
+static std::vector<T> unpack(const std::vector<uint8_t>& bytes)
+{
+    std::vector<T> values(bytes.size() / sizeof(T));
+    std::memcpy(values.data(), bytes.data(), values.size() * sizeof(T));
+    return values;
+}
+
+DistributedSimulation::DistributedSimulation(Transport& transport, ThreadPool& pool, const Config& config)
+    : m_transport { transport }
+    , m_pool { pool }
+    , m_config { config }
+{
+    // Each rank generates its share of the disc, then the first rebalance sends every particle to its owner.
+    uint32_t ranks = m_transport.ranks();
+    uint32_t rank = m_transport.rank();
+    uint32_t share = m_config.particle_count / ranks;
+    uint32_t remainder = m_config.particle_count % ranks;
+    uint32_t first_id = rank * share + std::min(rank, remainder);
+    auto disc = ParticleSimulation::make_disc(share + (rank < remainder ? 1 : 0), m_config.strength,
+        m_config.seed + rank);
+    m_particles.resize(disc.size());
+    for (size_t i = 0; i < disc.size(); i++) {
+        m_particles[i] = {
+            .position = glm::vec3(disc[i].position),
+            .id = first_id + static_cast<uint32_t>(i),
+            .velocity = glm::vec3(disc[i].velocity),
+            .padding = 0,
+        };
+    }
+
+    for (uint32_t cut = 1; cut < ranks; cut++) {
+        m_cuts.push_back(m_config.extent * (2.0f * cut / ranks - 1.0f));
+    }
+    rebalance();
+}
+
+float DistributedSimulation::slab_begin()
+{
+    uint32_t rank = m_transport.rank();
+    return rank == 0 ? -std::numeric_limits<float>::infinity() : m_cuts[rank - 1];
+}
+
+float DistributedSimulation::slab_end()
+{
+    uint32_t rank = m_transport.rank();
+    return rank + 1 == m_transport.ranks() ? std::numeric_limits<float>::infinity() : m_cuts[rank];
+}
+
+uint32_t DistributedSimulation::owner(float x)
+{
+    return static_cast<uint32_t>(std::upper_bound(m_cuts.begin(), m_cuts.end(), x) - m_cuts.begin());
+}
+
+glm::vec3 DistributedSimulation::acceleration(const DomainParticle& particle, bool with_halo) const
+{
+    // Same softened pull as particles.comp.
+    glm::vec3 offset = -particle.position;
+    float distance_sq = glm::dot(offset, offset) + 0.001f;
+    glm::vec3 result = m_config.strength * offset / (distance_sq * std::sqrt(distance_sq));
+
+    float cutoff_sq = m_config.cutoff * m_config.cutoff;
+    auto repel = [&](const DomainParticle& other) {
+        glm::vec3 away = particle.position - other.position;
+        float length_sq = glm::dot(away, away);
+        if (length_sq >= cutoff_sq || length_sq == 0.0f || other.id == particle.id) {
+            return;
+        }
+        float length = std::sqrt(length_sq);
+        result += m_config.stiffness * (1.0f - length / m_config.cutoff) * away / length;
+    };
+    m_local_grid.for_each_near(particle.position, m_particles, repel);
+    if (with_halo) {
+        m_halo_grid.for_each_near(particle.position, m_halo, repel);
+    }
+    return result;
+}
+
+void DistributedSimulation::accelerate(const std::vector<uint32_t>& indices, bool with_halo)
+{
+    m_pool.parallel_for(static_cast<uint32_t>(indices.size()), 1024, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            m_accelerations[indices[i]] = acceleration(m_particles[indices[i]], with_halo);
+        }
+    });
+}
+
+void DistributedSimulation::step()
+{
+    SIM_TRACE_ZONE("DistributedSimulation::step");
+    uint32_t rank = m_transport.rank();
+    bool has_left = rank > 0;
+    bool has_right = rank + 1 < m_transport.ranks();
+    float begin = slab_begin();
+    float end = slab_end();
+    float cutoff = m_config.cutoff;
+
+    m_local_grid.build(m_particles, cutoff);
+    m_local_grid.sort(m_particles);
+
+    // Particles within the cutoff of an edge are the neighbour's halo, and the only ones that need it.
+    std::vector<DomainParticle> left_halo;
+    std::vector<DomainParticle> right_halo;
+    m_interior.clear();
+    m_edge.clear();
+    for (uint32_t i = 0; i < m_particles.size(); i++) {
+        float x = m_particles[i].position.x;
+        bool near_left = has_left && x < begin + cutoff;
+        bool near_right = has_right && x >= end - cutoff;
+        if (near_left) {
+            left_halo.push_back(m_particles[i]);
+        }
+        if (near_right) {
+            right_halo.push_back(m_particles[i]);
+        }
+        (near_left || near_right ? m_edge : m_interior).push_back(i);
+    }
+    if (has_left) {
+        m_transport.send(rank - 1, TAG_HALO, left_halo.data(), left_halo.size() * sizeof(DomainParticle));
+    }
+    if (has_right) {
+        m_transport.send(rank + 1, TAG_HALO, right_halo.data(), right_halo.size() * sizeof(DomainParticle));
+    }
+
+    m_accelerations.resize(m_particles.size());
+    accelerate(m_interior, false);
+
+    auto wait_start = std::chrono::steady_clock::now();
+    m_halo.clear();
+    auto receive_halo = [&](uint32_t peer) {
+        auto received = unpack<DomainParticle>(m_transport.receive(peer, TAG_HALO));
+        m_halo.insert(m_halo.end(), received.begin(), received.end());
+    };
+    if (has_left) {
+        receive_halo(rank - 1);
+    }
+    if (has_right) {
+        receive_halo(rank + 1);
+    }
+    m_halo_wait_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - wait_start).count();
+
+    m_halo_grid.build(m_halo, cutoff);
+    accelerate(m_edge, true);
+
+    float dt = m_config.dt;
+    m_pool.parallel_for(static_cast<uint32_t>(m_particles.size()), 4096, [&](uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; i++) {
+            m_particles[i].velocity += m_accelerations[i] * dt;
+            m_particles[i].position += m_particles[i].velocity * dt;
+        }
+    });
+
+    migrate(false);
+    m_tick++;
+    if (m_config.rebalance_interval != 0 && m_tick % m_config.rebalance_interval == 0) {
+        rebalance();
+    }
+}
+
+void DistributedSimulation::migrate(bool all_ranks)
+{
+    uint32_t rank = m_transport.rank();
+    uint32_t ranks = m_transport.ranks();
+    std::vector<uint32_t> peers;
+    for (uint32_t peer = 0; peer < ranks; peer++) {
+        if (peer != rank && (all_ranks || peer + 1 == rank || peer == rank + 1)) {
+            peers.push_back(peer);
+        }
+    }
+
+    // A particle that moved past a neighbour's slab in one tick reaches its owner over the following ticks.
+    std::vector<std::vector<DomainParticle>> outgoing(ranks);
+    size_t kept = 0;
+    for (const auto& particle : m_particles) {
+        uint32_t destination = owner(particle.position.x);
+        if (destination == rank) {
+            m_particles[kept++] = particle;
+            continue;
+        }
+        if (!all_ranks) {
+            destination = destination < rank ? rank - 1 : rank + 1;
+        }
+        outgoing[destination].push_back(particle);
+    }
+    m_particles.resize(kept);
+
+    for (uint32_t peer : peers) {
+        m_transport.send(
+            peer, TAG_MIGRATE, outgoing[peer].data(), outgoing[peer].size() * sizeof(DomainParticle));
+    }
+    for (uint32_t peer : peers) {
+        auto received = unpack<DomainParticle>(m_transport.receive(peer, TAG_MIGRATE));
+        m_particles.insert(m_particles.end(), received.begin(), received.end());
+    }
+}
+
+std::vector<uint64_t> DistributedSimulation::all_reduce_sum(std::vector<uint64_t> values)
+{
+    uint32_t ranks = m_transport.ranks();
+    size_t bytes = values.size() * sizeof(uint64_t);
+    if (m_transport.rank() != 0) {
+        m_transport.send(0, TAG_REDUCE, values.data(), bytes);
+        return unpack<uint64_t>(m_transport.receive(0, TAG_BROADCAST));
+    }
+
+    for (uint32_t peer = 1; peer < ranks; peer++) {
+        auto received = unpack<uint64_t>(m_transport.receive(peer, TAG_REDUCE));
+        if (received.size() != values.size()) {
+            throw std::runtime_error("mismatched reduction from rank " + std::to_string(peer));
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            values[i] += received[i];
+        }
+    }
+    for (uint32_t peer = 1; peer < ranks; peer++) {
+        m_transport.send(peer, TAG_BROADCAST, values.data(), bytes);
+    }
+    return values;
+}
+
+uint64_t DistributedSimulation::global_count() { return all_reduce_sum({ m_particles.size() })[0]; }
+
+void DistributedSimulation::rebalance()
+{
+    uint32_t ranks = m_transport.ranks();
+    float extent = m_config.extent;
+    float bin_width = 2.0f * extent / HISTOGRAM_BINS;
+
+    std::vector<uint64_t> histogram(HISTOGRAM_BINS);
+    for (const auto& particle : m_particles) {
+        int bin = static_cast<int>(std::floor((particle.position.x + extent) / bin_width));
+        histogram[std::clamp(bin, 0, static_cast<int>(HISTOGRAM_BINS) - 1)]++;
+    }
+    histogram = all_reduce_sum(std::move(histogram));
+
+    // Every rank computes the same cuts from the same histogram, interpolating within the bin that crosses each
+    // quantile. Slabs stay at least a cutoff wide so the halo only ever comes from direct neighbours.
+    uint64_t total = 0;
+    for (uint64_t count : histogram) {
+        total += count;
+    }
+    uint64_t below = 0;
+    uint32_t bin = 0;
+    for (uint32_t cut = 1; cut < ranks; cut++) {
+        double target = static_cast<double>(total) * cut / ranks;
+        while (bin < HISTOGRAM_BINS && below + histogram[bin] < target) {
+            below += histogram[bin++];
+        }
+        float x = extent;
+        if (bin < HISTOGRAM_BINS) {
+            double fraction = histogram[bin] == 0 ? 0.0 : (target - below) / histogram[bin];
+            x = -extent + bin_width * (bin + static_cast<float>(fraction));
+        }
+        if (cut > 1) {
+            x = std::max(x, m_cuts[cut - 2] + m_config.cutoff);
+        }
+        m_cuts[cut - 1] = x;
+    }
+
+    migrate(true);
+}
+
+} // namespace Simulation
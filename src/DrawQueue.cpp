@@ -0,0 +1,301 @@
+#include "DrawQueue.hpp"
+#include "Debug.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+static constexpr uint32_t DEPTH_BITS = 32;
+static constexpr uint32_t MATERIAL_SHIFT = DEPTH_BITS;
+static constexpr uint32_t PIPELINE_SHIFT = MATERIAL_SHIFT + DrawQueue::MATERIAL_BITS;
+static constexpr uint32_t PASS_SHIFT = PIPELINE_SHIFT + DrawQueue::PIPELINE_BITS;
+static_assert(PASS_SHIFT + DrawQueue::PASS_BITS == 64);
+
+static constexpr VkDeviceSize INDIRECT_REGION_SIZE
+    = sizeof(VkDrawIndexedIndirectCommand) * DrawQueue::MAX_INDIRECT_COMMANDS;
+// Fewer keys than this per thread are not worth handing to the pool.
+static constexpr uint32_t SORT_CHUNK_MIN = 16 * 1024;
+
+DrawQueue::DrawQueue(Device& device, ThreadPool& pool, uint32_t frames_in_flight)
+    : m_device { device }
+    , m_pool { pool }
+    , m_multi_draw { device.enabled_features().multiDrawIndirect == VK_TRUE }
+{
+    m_device.create_buffer(INDIRECT_REGION_SIZE * frames_in_flight, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_indirect_buffer,
+        m_indirect_memory);
+    void* mapped;
+    if (vkMapMemory(m_device.device(), m_indirect_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map draw queue indirect buffer");
+    }
+    m_indirect_mapped = static_cast<uint8_t*>(mapped);
+}
+
+DrawQueue::~DrawQueue()
+{
+    vkDestroyBuffer(m_device.device(), m_indirect_buffer, nullptr);
+    vkFreeMemory(m_device.device(), m_indirect_memory, nullptr);
+}
+
+uint64_t DrawQueue::make_key(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, bool back_to_front)
+{
+    if (pass >> PASS_BITS || pipeline >> PIPELINE_BITS || material >> MATERIAL_BITS) {
+        throw std::runtime_error("draw key field out of range");
+    }
+    // Non-negative floats order like their bit patterns.
+    uint32_t depth_bits = std::bit_cast<uint32_t>(depth > 0.0f ? depth : 0.0f);
+    if (back_to_front) {
+        depth_bits = ~depth_bits;
+    }
+    return static_cast<uint64_t>(pass) << PASS_SHIFT | static_cast<uint64_t>(pipeline) << PIPELINE_SHIFT
+        | static_cast<uint64_t>(material) << MATERIAL_SHIFT | depth_bits;
+}
+
+uint32_t DrawQueue::add_pipeline(Pipeline& pipeline, VkPipelineLayout layout, VkShaderStageFlags push_stages)
+{
+    if (m_pipelines.size() >> PIPELINE_BITS) {
+        throw std::runtime_error("too many pipelines in draw queue");
+    }
+    m_pipelines.push_back({ .pipeline = &pipeline, .layout = layout, .push_stages = push_stages });
+    return static_cast<uint32_t>(m_pipelines.size() - 1);
+}
+
+uint32_t DrawQueue::add_material(VkDescriptorSet descriptor_set)
+{
+    if (m_materials.size() >> MATERIAL_BITS) {
+        throw std::runtime_error("too many materials in draw queue");
+    }
+    m_materials.push_back(descriptor_set);
+    return static_cast<uint32_t>(m_materials.size() - 1);
+}
+
+void DrawQueue::push(uint64_t key, const DrawItem& item, const void* push_constants, uint32_t push_size)
+{
+    uint32_t push_offset = static_cast<uint32_t>(m_push_data.size());
+    auto bytes = static_cast<const uint8_t*>(push_constants);
+    m_push_data.insert(m_push_data.end(), bytes, bytes + push_size);
+
+    m_keys.push_back(key);
+    m_order.push_back(static_cast<uint32_t>(m_entries.size()));
+    m_entries.push_back({ .item = item, .push_offset = push_offset, .push_size = push_size });
+}
+
+void DrawQueue::sort()
+{
+    uint32_t count = static_cast<uint32_t>(m_keys.size());
+    m_scratch_keys.resize(count);
+    m_scratch_order.resize(count);
+
+    // Bits that are the same in every key need no pass; usually that is most of the pass and pipeline bytes.
+    uint64_t any = 0;
+    uint64_t all = ~0ull;
+    for (uint64_t key : m_keys) {
+        any |= key;
+        all &= key;
+    }
+    uint64_t varying = any ^ all;
+
+    uint32_t chunks = std::clamp(count / SORT_CHUNK_MIN, 1u, m_pool.size());
+    uint32_t chunk_size = (count + chunks - 1) / chunks;
+    std::vector<uint32_t> offsets(chunks * 256);
+    for (uint32_t shift = 0; shift < 64; shift += 8) {
+        if (((varying >> shift) & 0xFF) == 0) {
+            continue;
+        }
+
+        std::fill(offsets.begin(), offsets.end(), 0u);
+        m_pool.parallel_for(chunks, 1, [&](uint32_t first_chunk, uint32_t last_chunk) {
+            for (uint32_t chunk = first_chunk; chunk < last_chunk; chunk++) {
+                uint32_t* counts = &offsets[chunk * 256];
+                for (uint32_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); i++) {
+                    counts[(m_keys[i] >> shift) & 0xFF]++;
+                }
+            }
+        });
+
+        // Digit-major, chunk-minor, so equal digits keep their order across chunks and the sort stays stable.
+        uint32_t total = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            for (uint32_t chunk = 0; chunk < chunks; chunk++) {
+                uint32_t digit_count = offsets[chunk * 256 + digit];
+                offsets[chunk * 256 + digit] = total;
+                total += digit_count;
+            }
+        }
+
+        m_pool.parallel_for(chunks, 1, [&](uint32_t first_chunk, uint32_t last_chunk) {
+            for (uint32_t chunk = first_chunk; chunk < last_chunk; chunk++) {
+                uint32_t* cursors = &offsets[chunk * 256];
+                for (uint32_t i = chunk * chunk_size; i < std::min(count, (chunk + 1) * chunk_size); i++) {
+                    uint32_t slot = cursors[(m_keys[i] >> shift) & 0xFF]++;
+                    m_scratch_keys[slot] = m_keys[i];
+                    m_scratch_order[slot] = m_order[i];
+                }
+            }
+        });
+        m_keys.swap(m_scratch_keys);
+        m_order.swap(m_scratch_order);
+    }
+}
+
+bool DrawQueue::same_state(const Entry& a, const Entry& b)
+{
+    return a.item.vertex_buffer == b.item.vertex_buffer && a.item.vertex_offset == b.item.vertex_offset
+        && a.item.instance_buffer == b.item.instance_buffer && a.item.instance_offset == b.item.instance_offset
+        && a.item.index_buffer == b.item.index_buffer
+        && (a.item.index_buffer == VK_NULL_HANDLE
+            || (a.item.index_offset == b.item.index_offset && a.item.index_type == b.item.index_type))
+        && a.push_size == b.push_size
+        && std::memcmp(m_push_data.data() + a.push_offset, m_push_data.data() + b.push_offset, a.push_size) == 0;
+}
+
+void DrawQueue::submit(VkCommandBuffer command_buffer, uint32_t frame_index)
+{
+    SIM_TRACE_ZONE("DrawQueue::submit");
+    m_stats = { .draws = static_cast<uint32_t>(m_keys.size()) };
+    sort();
+
+    uint32_t bound_pipeline = ~0u;
+    uint32_t bound_material = ~0u;
+    const Entry* bound_vertices = nullptr;
+    const Entry* bound_instances = nullptr;
+    const Entry* bound_indices = nullptr;
+    const Entry* bound_push = nullptr;
+
+    VkDeviceSize indirect_offset = INDIRECT_REGION_SIZE * frame_index;
+    VkDeviceSize indirect_end = indirect_offset + INDIRECT_REGION_SIZE;
+    std::vector<DrawItem> draws;
+
+    for (size_t begin = 0; begin < m_keys.size();) {
+        // A run shares pass, pipeline, material, buffers and push constants; only depth and geometry differ.
+        const Entry& run = m_entries[m_order[begin]];
+        uint64_t state_key = m_keys[begin] >> MATERIAL_SHIFT;
+        size_t end = begin + 1;
+        while (end < m_keys.size() && m_keys[end] >> MATERIAL_SHIFT == state_key
+            && same_state(run, m_entries[m_order[end]])) {
+            end++;
+        }
+
+        uint32_t pipeline = static_cast<uint32_t>(state_key >> (PIPELINE_SHIFT - MATERIAL_SHIFT))
+            & ((1u << PIPELINE_BITS) - 1);
+        uint32_t material = static_cast<uint32_t>(state_key) & ((1u << MATERIAL_BITS) - 1);
+        if (pipeline >= m_pipelines.size() || material >= m_materials.size()) {
+            throw std::runtime_error("draw key names an unknown pipeline or material");
+        }
+        const PipelineSlot& slot = m_pipelines[pipeline];
+        if (pipeline != bound_pipeline) {
+            slot.pipeline->bind(command_buffer);
+            m_stats.pipeline_binds++;
+            // Descriptor sets and push constants only survive a switch between compatible layouts.
+            if (bound_pipeline == ~0u || m_pipelines[bound_pipeline].layout != slot.layout) {
+                bound_material = ~0u;
+                bound_push = nullptr;
+            }
+            bound_pipeline = pipeline;
+        }
+        if (material != 0 && material != bound_material) {
+            vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, slot.layout, 0, 1,
+                &m_materials[material], 0, nullptr);
+            m_stats.descriptor_binds++;
+            bound_material = material;
+        }
+
+        const DrawItem& item = run.item;
+        if (item.vertex_buffer != VK_NULL_HANDLE
+            && !(bound_vertices && bound_vertices->item.vertex_buffer == item.vertex_buffer
+                && bound_vertices->item.vertex_offset == item.vertex_offset)) {
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &item.vertex_buffer, &item.vertex_offset);
+            m_stats.buffer_binds++;
+            bound_vertices = &run;
+        }
+        if (item.instance_buffer != VK_NULL_HANDLE
+            && !(bound_instances && bound_instances->item.instance_buffer == item.instance_buffer
+                && bound_instances->item.instance_offset == item.instance_offset)) {
+            vkCmdBindVertexBuffers(command_buffer, 1, 1, &item.instance_buffer, &item.instance_offset);
+            m_stats.buffer_binds++;
+            bound_instances = &run;
+        }
+        bool indexed = item.index_buffer != VK_NULL_HANDLE;
+        if (indexed
+            && !(bound_indices && bound_indices->item.index_buffer == item.index_buffer
+                && bound_indices->item.index_offset == item.index_offset
+                && bound_indices->item.index_type == item.index_type)) {
+            vkCmdBindIndexBuffer(command_buffer, item.index_buffer, item.index_offset, item.index_type);
+            m_stats.buffer_binds++;
+            bound_indices = &run;
+        }
+        const uint8_t* push_data = m_push_data.data() + run.push_offset;
+        if (run.push_size != 0
+            && !(bound_push && bound_push->push_size == run.push_size
+                && std::memcmp(m_push_data.data() + bound_push->push_offset, push_data, run.push_size) == 0)) {
+            vkCmdPushConstants(command_buffer, slot.layout, slot.push_stages, 0, run.push_size, push_data);
+            m_stats.push_constant_updates++;
+            bound_push = &run;
+        }
+
+        // Same geometry with consecutive instances becomes one instanced draw.
+        draws.clear();
+        for (size_t i = begin; i < end; i++) {
+            const DrawItem& next = m_entries[m_order[i]].item;
+            if (!draws.empty()) {
+                DrawItem& last = draws.back();
+                if (last.count == next.count && last.first == next.first && last.base_vertex == next.base_vertex
+                    && last.first_instance + last.instance_count == next.first_instance) {
+                    last.instance_count += next.instance_count;
+                    continue;
+                }
+            }
+            draws.push_back(next);
+        }
+
+        VkDeviceSize stride = indexed ? sizeof(VkDrawIndexedIndirectCommand) : sizeof(VkDrawIndirectCommand);
+        VkDeviceSize size = stride * draws.size();
+        if (draws.size() > 1 && m_multi_draw && indirect_offset + size <= indirect_end) {
+            uint8_t* commands = m_indirect_mapped + indirect_offset;
+            for (size_t i = 0; i < draws.size(); i++) {
+                const DrawItem& draw = draws[i];
+                if (indexed) {
+                    VkDrawIndexedIndirectCommand command = { draw.count, draw.instance_count, draw.first,
+                        draw.base_vertex, draw.first_instance };
+                    std::memcpy(commands + i * stride, &command, sizeof(command));
+                } else {
+                    VkDrawIndirectCommand command = { draw.count, draw.instance_count, draw.first,
+                        draw.first_instance };
+                    std::memcpy(commands + i * stride, &command, sizeof(command));
+                }
+            }
+            uint32_t draw_count = static_cast<uint32_t>(draws.size());
+            if (indexed) {
+                vkCmdDrawIndexedIndirect(command_buffer, m_indirect_buffer, indirect_offset, draw_count,
+                    static_cast<uint32_t>(stride));
+            } else {
+                vkCmdDrawIndirect(command_buffer, m_indirect_buffer, indirect_offset, draw_count,
+                    static_cast<uint32_t>(stride));
+            }
+            indirect_offset += size;
+            m_stats.draw_calls++;
+        } else {
+            for (const DrawItem& draw : draws) {
+                if (indexed) {
+                    vkCmdDrawIndexed(command_buffer, draw.count, draw.instance_count, draw.first, draw.base_vertex,
+                        draw.first_instance);
+                } else {
+                    vkCmdDraw(command_buffer, draw.count, draw.instance_count, draw.first, draw.first_instance);
+                }
+                m_stats.draw_calls++;
+            }
+        }
+        begin = end;
+    }
+
+    m_keys.clear();
+    m_order.clear();
+    m_entries.clear();
+    m_push_data.clear();
+}
+
+} // namespace Simulation
@@ -0,0 +1,389 @@
+#include "FrameCapture.hpp"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+static size_t round_up(size_t value, size_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+static bool is_aligned(const void* ptr, size_t alignment)
+{
+    return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+FrameSink::FrameSink(const std::string& path, std::atomic<uint32_t>* slot_states)
+    : m_slot_states { slot_states }
+{
+    m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (m_fd >= 0) {
+        m_direct_io = true;
+    } else {
+        // tmpfs and some network filesystems reject O_DIRECT, fall back to the page cache.
+        m_fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+    if (m_fd < 0) {
+        throw std::runtime_error("failed to open capture file " + path);
+    }
+
+    m_bounce_size = 4 * 1024 * 1024;
+    m_bounce_buffer = std::aligned_alloc(BLOCK_SIZE, m_bounce_size);
+    if (m_bounce_buffer == nullptr) {
+        close(m_fd);
+        throw std::runtime_error("failed to allocate capture bounce buffer");
+    }
+
+    m_thread = std::thread(&FrameSink::writer_loop, this);
+}
+
+FrameSink::~FrameSink()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+
+    close(m_fd);
+    std::free(m_bounce_buffer);
+}
+
+void FrameSink::push(const Record& record)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.push_back(record);
+    }
+    m_cv.notify_one();
+}
+
+void FrameSink::writer_loop()
+{
+    for (;;) {
+        Record record;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_cv.wait(lock, [this] { return m_stop || !m_queue.empty(); });
+            if (m_queue.empty())
+                return;
+            record = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        if (!m_failed.load(std::memory_order_relaxed) && !write_record(record)) {
+            m_failed.store(true, std::memory_order_relaxed);
+        }
+        // Hand the slot back to the ring (FrameCapture::SLOT_FREE).
+        m_slot_states[record.slot].store(0, std::memory_order_release);
+    }
+}
+
+bool FrameSink::write_record(const Record& record)
+{
+    std::memset(m_bounce_buffer, 0, BLOCK_SIZE);
+    std::memcpy(m_bounce_buffer, &record.header, sizeof(record.header));
+    if (!write_fully(m_bounce_buffer, BLOCK_SIZE))
+        return false;
+
+    // Slots are allocated at padded_size, so reading the tail padding out of the mapped buffer stays in bounds.
+    if (!m_direct_io || is_aligned(record.data, BLOCK_SIZE)) {
+        return write_fully(record.data, record.header.padded_size);
+    }
+
+    const char* src = static_cast<const char*>(record.data);
+    size_t remaining = record.header.padded_size;
+    while (remaining > 0) {
+        size_t chunk = std::min(remaining, m_bounce_size);
+        std::memcpy(m_bounce_buffer, src, chunk);
+        if (!write_fully(m_bounce_buffer, chunk))
+            return false;
+        src += chunk;
+        remaining -= chunk;
+    }
+    return true;
+}
+
+bool FrameSink::write_fully(const void* data, size_t size)
+{
+    const char* ptr = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = write(m_fd, ptr, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0) {
+            Logger::error(LogCategory::Capture, "frame sink: write failed: %s",
+                written < 0 ? std::strerror(errno) : "no progress");
+            return false;
+        }
+        ptr += written;
+        size -= static_cast<size_t>(written);
+        m_bytes_written.fetch_add(static_cast<uint64_t>(written), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+FrameCapture::FrameCapture(Device& device, const std::string& path, VkDeviceSize slot_size, uint32_t slot_count)
+    : m_device { device }
+    , m_slot_size { round_up(slot_size, FrameSink::BLOCK_SIZE) }
+    , m_slots(slot_count)
+    , m_slot_states(slot_count)
+    , m_sink { path, m_slot_states.data() }
+{
+    for (auto& slot : m_slots) {
+        try {
+            m_device.create_buffer(m_slot_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, slot.buffer, slot.memory);
+        } catch (const std::runtime_error&) {
+            vkDestroyBuffer(m_device.device(), slot.buffer, nullptr);
+            m_device.create_buffer(m_slot_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, slot.buffer, slot.memory);
+            m_coherent = true;
+        }
+
+        if (vkMapMemory(m_device.device(), slot.memory, 0, VK_WHOLE_SIZE, 0, &slot.mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map readback buffer");
+        }
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    vkDeviceWaitIdle(m_device.device());
+    poll(UINT64_MAX);
+
+    // Wait for the writer to give every slot back before the memory goes away.
+    for (auto& state : m_slot_states) {
+        while (state.load(std::memory_order_acquire) == SLOT_WRITING) {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& slot : m_slots) {
+        vkUnmapMemory(m_device.device(), slot.memory);
+        vkDestroyBuffer(m_device.device(), slot.buffer, nullptr);
+        vkFreeMemory(m_device.device(), slot.memory, nullptr);
+    }
+}
+
+int FrameCapture::acquire_slot()
+{
+    if (m_sink.failed())
+        return -1;
+    for (uint32_t i = 0; i < m_slots.size(); i++) {
+        uint32_t index = (m_next_slot + i) % m_slots.size();
+        if (m_slot_states[index].load(std::memory_order_acquire) == SLOT_FREE) {
+            m_next_slot = (index + 1) % m_slots.size();
+            return static_cast<int>(index);
+        }
+    }
+    m_dropped++;
+    return -1;
+}
+
+bool FrameCapture::record_image(VkCommandBuffer command_buffer, VkImage image, VkImageLayout layout,
+    VkFormat format, VkExtent2D extent, uint64_t frame)
+{
+    VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * texel_size(format);
+    if (size > m_slot_size) {
+        throw std::runtime_error("captured image does not fit in a readback slot");
+    }
+
+    int index = acquire_slot();
+    if (index < 0)
+        return false;
+    Slot& slot = m_slots[index];
+
+    VkImageSubresourceRange range = {
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .baseMipLevel = 0,
+        .levelCount = 1,
+        .baseArrayLayer = 0,
+        .layerCount = 1,
+    };
+
+    VkImageMemoryBarrier2 to_transfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+        .oldLayout = layout,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = range,
+    };
+    // Callers that already moved the image to TRANSFER_SRC (e.g. a RenderGraph transfer read) need no transitions.
+    bool transition = layout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    if (transition) {
+        VkDependencyInfo dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .imageMemoryBarrierCount = 1,
+            .pImageMemoryBarriers = &to_transfer,
+        };
+        vkCmdPipelineBarrier2(command_buffer, &dependency);
+    }
+
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .imageOffset = { 0, 0, 0 },
+        .imageExtent = { extent.width, extent.height, 1 },
+    };
+    vkCmdCopyImageToBuffer(
+        command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1, &region);
+
+    VkImageMemoryBarrier2 to_original = to_transfer;
+    to_original.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    to_original.srcAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+    to_original.dstStageMask = VK_PIPELINE_STAGE_2_NONE;
+    to_original.dstAccessMask = VK_ACCESS_2_NONE;
+    to_original.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    to_original.newLayout = layout;
+
+    VkBufferMemoryBarrier2 to_host = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = slot.buffer,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers = &to_host,
+        .imageMemoryBarrierCount = transition ? 1u : 0u,
+        .pImageMemoryBarriers = &to_original,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    slot.header = {
+        .magic = CaptureRecordHeader::MAGIC,
+        .version = 1,
+        .frame = frame,
+        .width = extent.width,
+        .height = extent.height,
+        .format = static_cast<uint32_t>(format),
+        .row_pitch = extent.width * texel_size(format),
+        .payload_size = size,
+        .padded_size = round_up(size, FrameSink::BLOCK_SIZE),
+    };
+    m_slot_states[index].store(SLOT_RECORDED, std::memory_order_relaxed);
+    m_captured++;
+    return true;
+}
+
+bool FrameCapture::record_buffer(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize size, uint64_t frame)
+{
+    if (size > m_slot_size) {
+        throw std::runtime_error("captured buffer does not fit in a readback slot");
+    }
+
+    int index = acquire_slot();
+    if (index < 0)
+        return false;
+    Slot& slot = m_slots[index];
+
+    VkMemoryBarrier2 to_transfer = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_MEMORY_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &to_transfer,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = size };
+    vkCmdCopyBuffer(command_buffer, buffer, slot.buffer, 1, &region);
+
+    VkMemoryBarrier2 to_host = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+    };
+    dependency.pMemoryBarriers = &to_host;
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    slot.header = {
+        .magic = CaptureRecordHeader::MAGIC,
+        .version = 1,
+        .frame = frame,
+        .width = 0,
+        .height = 0,
+        .format = static_cast<uint32_t>(VK_FORMAT_UNDEFINED),
+        .row_pitch = 0,
+        .payload_size = size,
+        .padded_size = round_up(size, FrameSink::BLOCK_SIZE),
+    };
+    m_slot_states[index].store(SLOT_RECORDED, std::memory_order_relaxed);
+    m_captured++;
+    return true;
+}
+
+void FrameCapture::poll(uint64_t completed_frame)
+{
+    for (uint32_t i = 0; i < m_slots.size(); i++) {
+        if (m_slot_states[i].load(std::memory_order_relaxed) != SLOT_RECORDED
+            || m_slots[i].header.frame > completed_frame)
+            continue;
+
+        if (!m_coherent) {
+            VkMappedMemoryRange range = {
+                .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                .memory = m_slots[i].memory,
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            };
+            vkInvalidateMappedMemoryRanges(m_device.device(), 1, &range);
+        }
+
+        m_slot_states[i].store(SLOT_WRITING, std::memory_order_relaxed);
+        m_sink.push({ .header = m_slots[i].header, .data = m_slots[i].mapped, .slot = i });
+    }
+}
+
+uint32_t FrameCapture::texel_size(VkFormat format)
+{
+    switch (format) {
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_B8G8R8A8_UNORM:
+    case VK_FORMAT_B8G8R8A8_SRGB:
+    case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_UINT:
+        return 4;
+    case VK_FORMAT_R16G16B16A16_SFLOAT:
+    case VK_FORMAT_R32G32_SFLOAT:
+        return 8;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        throw std::runtime_error("unsupported capture format");
+    }
+}
+
+} // namespace Simulation
@@ -0,0 +1,45 @@
+#include "FrameLimiter.hpp"
+
+#include <stdexcept>
+#include <thread>
+
+namespace Simulation {
+
+FrameLimiter::FrameLimiter(double frames_per_second)
+{
+    set_rate(frames_per_second);
+}
+
+void FrameLimiter::set_rate(double frames_per_second)
+{
+    if (!(frames_per_second >= 0.0)) {
+        throw std::runtime_error("frame rate must not be negative!");
+    }
+
+    m_rate = frames_per_second;
+    m_interval = frames_per_second > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frames_per_second))
+        : Clock::duration {};
+    reset();
+}
+
+void FrameLimiter::wait()
+{
+    if (m_interval == Clock::duration {}) {
+        return;
+    }
+
+    auto now = Clock::now();
+    if (now < m_next) {
+        if (m_next - now > SPIN_MARGIN) {
+            std::this_thread::sleep_until(m_next - SPIN_MARGIN);
+        }
+        while (Clock::now() < m_next) {
+            std::this_thread::yield();
+        }
+    }
+
+    m_next = now - m_next < m_interval ? m_next + m_interval : now + m_interval;
+}
+
+} // namespace Simulation
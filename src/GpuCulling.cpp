@@ -0,0 +1,549 @@
+#include "GpuCulling.hpp"
+#include "Culling.hpp"
+#include "Shaders.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+static void memory_barrier(VkCommandBuffer command_buffer, VkPipelineStageFlags2 src_stages,
+    VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access)
+{
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = src_stages,
+        .srcAccessMask = src_access,
+        .dstStageMask = dst_stages,
+        .dstAccessMask = dst_access,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+static uint32_t previous_power_of_two(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+GpuCulling::GpuCulling(Device& device, SwapChain& swap_chain, uint32_t max_instances, uint32_t max_draw_sources)
+    : m_device { device }
+    , m_swap_chain { swap_chain }
+    , m_max_instances { max_instances }
+{
+    if (!m_device.enabled_features().drawIndirectFirstInstance) {
+        throw std::runtime_error("GPU culling needs drawIndirectFirstInstance");
+    }
+    m_compact = m_device.supports_draw_indirect_count();
+
+    create_buffers(max_draw_sources);
+    create_depth_pyramid();
+    create_descriptors();
+    create_pipelines();
+}
+
+GpuCulling::~GpuCulling()
+{
+    VkDevice device = m_device.device();
+
+    m_cull_pipeline.reset();
+    m_pyramid_pipeline.reset();
+    vkDestroyPipelineLayout(device, m_cull_layout, nullptr);
+    vkDestroyPipelineLayout(device, m_pyramid_layout, nullptr);
+    vkDestroyDescriptorPool(device, m_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_cull_set_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_pyramid_set_layout, nullptr);
+
+    vkDestroySampler(device, m_sampler, nullptr);
+    for (auto view : m_pyramid_level_views) {
+        vkDestroyImageView(device, view, nullptr);
+    }
+    vkDestroyImageView(device, m_pyramid_view, nullptr);
+    vkDestroyImage(device, m_pyramid_image, nullptr);
+    vkFreeMemory(device, m_pyramid_memory, nullptr);
+
+    vkUnmapMemory(device, m_uniform_memory);
+    std::array<std::pair<VkBuffer, VkDeviceMemory>, 5> buffers = { {
+        { m_instance_buffer, m_instance_memory },
+        { m_draw_source_buffer, m_draw_source_memory },
+        { m_command_buffer, m_command_memory },
+        { m_count_buffer, m_count_memory },
+        { m_uniform_buffer, m_uniform_memory },
+    } };
+    for (auto& [buffer, memory] : buffers) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        vkFreeMemory(device, memory, nullptr);
+    }
+}
+
+void GpuCulling::create_buffers(uint32_t max_draw_sources)
+{
+    m_device.create_buffer(sizeof(GpuInstance) * m_max_instances,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_instance_buffer, m_instance_memory);
+    m_device.create_buffer(sizeof(GpuDrawSource) * max_draw_sources,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_draw_source_buffer, m_draw_source_memory);
+    m_device.create_buffer(sizeof(VkDrawIndexedIndirectCommand) * m_max_instances,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_command_buffer, m_command_memory);
+    m_device.create_buffer(sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_count_buffer, m_count_memory);
+
+    VkDeviceSize alignment = m_device.properties.limits.minUniformBufferOffsetAlignment;
+    m_uniform_stride = (sizeof(CullData) + alignment - 1) / alignment * alignment;
+    m_device.create_buffer(m_uniform_stride * SwapChain::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_uniform_buffer,
+        m_uniform_memory);
+    void* mapped;
+    if (vkMapMemory(m_device.device(), m_uniform_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map cull uniform buffer");
+    }
+    m_uniform_mapped = static_cast<char*>(mapped);
+}
+
+void GpuCulling::create_depth_pyramid()
+{
+    VkExtent2D extent = m_swap_chain.get_swap_chain_extent();
+    m_pyramid_extent = { previous_power_of_two(extent.width), previous_power_of_two(extent.height) };
+    m_pyramid_levels = 1;
+    while ((m_pyramid_extent.width >> m_pyramid_levels) > 0 || (m_pyramid_extent.height >> m_pyramid_levels) > 0) {
+        m_pyramid_levels++;
+    }
+
+    VkImageCreateInfo image_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .extent = { m_pyramid_extent.width, m_pyramid_extent.height, 1 },
+        .mipLevels = m_pyramid_levels,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    m_device.create_image_with_info(image_info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_pyramid_image, m_pyramid_memory);
+
+    VkImageViewCreateInfo view_info = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = m_pyramid_image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R32_SFLOAT,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_pyramid_levels, 0, 1 },
+    };
+    if (vkCreateImageView(m_device.device(), &view_info, nullptr, &m_pyramid_view) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid view");
+    }
+
+    m_pyramid_level_views.resize(m_pyramid_levels);
+    for (uint32_t level = 0; level < m_pyramid_levels; level++) {
+        view_info.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+        if (vkCreateImageView(m_device.device(), &view_info, nullptr, &m_pyramid_level_views[level]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create depth pyramid view");
+        }
+    }
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_NEAREST,
+        .minFilter = VK_FILTER_NEAREST,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .minLod = 0.0f,
+        .maxLod = static_cast<float>(m_pyramid_levels),
+    };
+    if (vkCreateSampler(m_device.device(), &sampler_info, nullptr, &m_sampler) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid sampler");
+    }
+
+    // The pyramid lives in GENERAL for its whole life; move it there once so the cull descriptor is always valid.
+    VkCommandBuffer command_buffer = m_device.begin_single_time_commands();
+    VkImageMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = m_pyramid_image,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, m_pyramid_levels, 0, 1 },
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+    m_device.end_single_time_commands(command_buffer);
+}
+
+void GpuCulling::create_descriptors()
+{
+    std::array<VkDescriptorSetLayoutBinding, 6> cull_bindings = { {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 5, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+    std::array<VkDescriptorSetLayoutBinding, 2> pyramid_bindings = { {
+        { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(cull_bindings.size()),
+        .pBindings = cull_bindings.data(),
+    };
+    if (vkCreateDescriptorSetLayout(m_device.device(), &layout_info, nullptr, &m_cull_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor set layout");
+    }
+    layout_info.bindingCount = static_cast<uint32_t>(pyramid_bindings.size());
+    layout_info.pBindings = pyramid_bindings.data();
+    if (vkCreateDescriptorSetLayout(m_device.device(), &layout_info, nullptr, &m_pyramid_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid descriptor set layout");
+    }
+
+    uint32_t frames = SwapChain::MAX_FRAMES_IN_FLIGHT;
+    uint32_t pyramid_sets = frames + m_pyramid_levels - 1;
+    std::array<VkDescriptorPoolSize, 4> pool_sizes = { {
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frames },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, frames },
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frames + pyramid_sets },
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, pyramid_sets },
+    } };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = frames + pyramid_sets,
+        .poolSizeCount = static_cast<uint32_t>(pool_sizes.size()),
+        .pPoolSizes = pool_sizes.data(),
+    };
+    if (vkCreateDescriptorPool(m_device.device(), &pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull descriptor pool");
+    }
+
+    m_cull_sets.resize(frames);
+    std::vector<VkDescriptorSetLayout> cull_layouts(frames, m_cull_set_layout);
+    m_pyramid_sets.resize(pyramid_sets);
+    std::vector<VkDescriptorSetLayout> pyramid_layouts(pyramid_sets, m_pyramid_set_layout);
+
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = frames,
+        .pSetLayouts = cull_layouts.data(),
+    };
+    if (vkAllocateDescriptorSets(m_device.device(), &alloc_info, m_cull_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate cull descriptor sets");
+    }
+    alloc_info.descriptorSetCount = pyramid_sets;
+    alloc_info.pSetLayouts = pyramid_layouts.data();
+    if (vkAllocateDescriptorSets(m_device.device(), &alloc_info, m_pyramid_sets.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate depth pyramid descriptor sets");
+    }
+
+    std::array<VkDescriptorBufferInfo, 4> storage_infos = { {
+        { m_instance_buffer, 0, VK_WHOLE_SIZE },
+        { m_draw_source_buffer, 0, VK_WHOLE_SIZE },
+        { m_command_buffer, 0, VK_WHOLE_SIZE },
+        { m_count_buffer, 0, VK_WHOLE_SIZE },
+    } };
+    VkDescriptorImageInfo pyramid_info = { m_sampler, m_pyramid_view, VK_IMAGE_LAYOUT_GENERAL };
+
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        VkDescriptorBufferInfo uniform_info = { m_uniform_buffer, m_uniform_stride * frame, sizeof(CullData) };
+        std::array<VkWriteDescriptorSet, 3> writes = { {
+            { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_cull_sets[frame],
+                .dstBinding = 0,
+                .descriptorCount = static_cast<uint32_t>(storage_infos.size()),
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = storage_infos.data() },
+            { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_cull_sets[frame],
+                .dstBinding = 4,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &pyramid_info },
+            { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_cull_sets[frame],
+                .dstBinding = 5,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .pBufferInfo = &uniform_info },
+        } };
+        vkUpdateDescriptorSets(m_device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+
+    // Level 0 reads the depth buffer, which is only known when recording; see record_depth_pyramid().
+    for (uint32_t i = 0; i < pyramid_sets; i++) {
+        uint32_t level = i < frames ? 0 : i - frames + 1;
+
+        VkDescriptorImageInfo src_info = { m_sampler, level == 0 ? VK_NULL_HANDLE : m_pyramid_level_views[level - 1],
+            VK_IMAGE_LAYOUT_GENERAL };
+        VkDescriptorImageInfo dst_info = { VK_NULL_HANDLE, m_pyramid_level_views[level], VK_IMAGE_LAYOUT_GENERAL };
+
+        std::array<VkWriteDescriptorSet, 2> writes = { {
+            { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_pyramid_sets[i],
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                .pImageInfo = &src_info },
+            { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_pyramid_sets[i],
+                .dstBinding = 1,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                .pImageInfo = &dst_info },
+        } };
+        uint32_t first_write = level == 0 ? 1 : 0;
+        vkUpdateDescriptorSets(m_device.device(), static_cast<uint32_t>(writes.size()) - first_write,
+            writes.data() + first_write, 0, nullptr);
+    }
+}
+
+void GpuCulling::create_pipelines()
+{
+    VkPipelineLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_cull_set_layout,
+    };
+    if (vkCreatePipelineLayout(m_device.device(), &layout_info, nullptr, &m_cull_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create cull pipeline layout");
+    }
+
+    VkPushConstantRange push_range = { VK_SHADER_STAGE_COMPUTE_BIT, 0, 4 * sizeof(int32_t) };
+    layout_info.pSetLayouts = &m_pyramid_set_layout;
+    layout_info.pushConstantRangeCount = 1;
+    layout_info.pPushConstantRanges = &push_range;
+    if (vkCreatePipelineLayout(m_device.device(), &layout_info, nullptr, &m_pyramid_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create depth pyramid pipeline layout");
+    }
+
+    m_cull_specialization.set(CULL_GROUP_SIZE_ID, m_cull_group_size);
+    m_cull_pipeline = std::make_unique<ComputePipeline>(
+        m_device, Shaders::cull_comp, m_cull_layout, m_cull_specialization);
+
+    SpecializationConstants pyramid_specialization;
+    pyramid_specialization.set(0, PYRAMID_TILE);
+    pyramid_specialization.set(1, PYRAMID_TILE);
+    m_pyramid_pipeline = std::make_unique<ComputePipeline>(
+        m_device, Shaders::depth_pyramid_comp, m_pyramid_layout, pyramid_specialization);
+}
+
+void GpuCulling::tune(Autotuner& tuner)
+{
+    const VkPhysicalDeviceLimits& limits = m_device.properties.limits;
+    std::vector<uint32_t> group_sizes;
+    for (uint32_t size : { 64u, 32u, 128u, 256u, 512u }) {
+        if (size <= limits.maxComputeWorkGroupSize[0] && size <= limits.maxComputeWorkGroupInvocations) {
+            group_sizes.push_back(size);
+        }
+    }
+    std::vector<TuningParameter> space = { { "group_size", CULL_GROUP_SIZE_ID, group_sizes } };
+
+    if (tuner.needs_tuning("cull")) {
+        fill_synthetic_instances();
+        // An identity view-projection keeps roughly half of the synthetic spheres, so both paths of the shader run.
+        write_cull_data(0, glm::mat4 { 1.0f }, m_max_instances, m_compact ? FLAG_COMPACT : 0u);
+    }
+
+    auto record = [&](VkCommandBuffer command_buffer, ComputePipeline& pipeline,
+                      const SpecializationConstants& constants) {
+        dispatch_cull(command_buffer, pipeline, 0, m_max_instances,
+            constants.get(CULL_GROUP_SIZE_ID, m_cull_group_size));
+    };
+    m_cull_specialization = tuner.select("cull", Shaders::cull_comp, m_cull_layout, space, record);
+    m_cull_group_size = m_cull_specialization.get(CULL_GROUP_SIZE_ID, m_cull_group_size);
+    m_cull_pipeline = std::make_unique<ComputePipeline>(
+        m_device, Shaders::cull_comp, m_cull_layout, m_cull_specialization);
+}
+
+void GpuCulling::fill_synthetic_instances()
+{
+    std::vector<GpuInstance> instances(m_max_instances);
+    uint32_t state = 0x9e3779b9u;
+    auto next = [&]() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<float>(state) / 4294967296.0f;
+    };
+    for (auto& instance : instances) {
+        instance = {
+            .bounding_sphere = glm::vec4(next() * 4.0f - 2.0f, next() * 4.0f - 2.0f, next() * 2.0f - 0.5f, 0.05f),
+            .draw = 0,
+        };
+    }
+
+    VkDeviceSize size = sizeof(GpuInstance) * instances.size();
+    VkBuffer staging;
+    VkDeviceMemory staging_memory;
+    m_device.create_buffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, staging_memory);
+    void* mapped;
+    vkMapMemory(m_device.device(), staging_memory, 0, size, 0, &mapped);
+    std::memcpy(mapped, instances.data(), size);
+    vkUnmapMemory(m_device.device(), staging_memory);
+
+    m_device.copy_buffer(staging, m_instance_buffer, size);
+    vkDestroyBuffer(m_device.device(), staging, nullptr);
+    vkFreeMemory(m_device.device(), staging_memory, nullptr);
+}
+
+void GpuCulling::record_upload(VkCommandBuffer command_buffer, VkBuffer source, VkDeviceSize offset,
+    uint32_t instance_count, std::span<const GpuDrawSource> draw_sources)
+{
+    instance_count = std::min(instance_count, m_max_instances);
+    if (instance_count == 0 && draw_sources.empty()) {
+        return;
+    }
+
+    VkPipelineStageFlags2 readers
+        = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT;
+    memory_barrier(command_buffer, readers, VK_ACCESS_2_NONE, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+        VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    if (instance_count > 0) {
+        VkBufferCopy region = { offset, 0, sizeof(GpuInstance) * instance_count };
+        vkCmdCopyBuffer(command_buffer, source, m_instance_buffer, 1, &region);
+    }
+    if (!draw_sources.empty()) {
+        vkCmdUpdateBuffer(
+            command_buffer, m_draw_source_buffer, 0, draw_sources.size_bytes(), draw_sources.data());
+    }
+    memory_barrier(command_buffer, VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, readers,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+}
+
+void GpuCulling::record_cull(VkCommandBuffer command_buffer, uint32_t frame_index, const glm::mat4& view_projection,
+    uint32_t instance_count, bool occlusion)
+{
+    m_instance_count = std::min(instance_count, m_max_instances);
+    write_cull_data(frame_index, view_projection, m_instance_count,
+        (occlusion && m_pyramid_valid ? FLAG_OCCLUSION : 0u) | (m_compact ? FLAG_COMPACT : 0u));
+    dispatch_cull(command_buffer, *m_cull_pipeline, frame_index, m_instance_count, m_cull_group_size);
+
+    memory_barrier(command_buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
+
+void GpuCulling::write_cull_data(
+    uint32_t frame_index, const glm::mat4& view_projection, uint32_t instance_count, uint32_t flags)
+{
+    CullData data = {
+        .view_projection = view_projection,
+        .planes = {},
+        .pyramid_size = glm::vec2(m_pyramid_extent.width, m_pyramid_extent.height),
+        .instance_count = instance_count,
+        .flags = flags,
+    };
+    Frustum frustum = Frustum::from_matrix(view_projection);
+    std::memcpy(data.planes, frustum.planes, sizeof(data.planes));
+    std::memcpy(m_uniform_mapped + m_uniform_stride * frame_index, &data, sizeof(data));
+}
+
+void GpuCulling::dispatch_cull(VkCommandBuffer command_buffer, ComputePipeline& pipeline, uint32_t frame_index,
+    uint32_t instance_count, uint32_t group_size)
+{
+    // Last frame's indirect draw reads the count and commands, so it must be done before either is rewritten.
+    memory_barrier(command_buffer, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+        VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(command_buffer, m_count_buffer, 0, sizeof(uint32_t), 0);
+    // Chained through the clear, this also keeps the command writes behind last frame's draw.
+    memory_barrier(command_buffer, VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+
+    pipeline.bind(command_buffer);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_layout, 0, 1,
+        &m_cull_sets[frame_index], 0, nullptr);
+    vkCmdDispatch(command_buffer, ComputePipeline::group_count(instance_count, group_size), 1, 1);
+}
+
+void GpuCulling::record_draw(VkCommandBuffer command_buffer)
+{
+    uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+    if (m_compact) {
+        m_device.cmd_draw_indexed_indirect_count(
+            command_buffer, m_command_buffer, 0, m_count_buffer, 0, m_instance_count, stride);
+    } else if (m_device.enabled_features().multiDrawIndirect) {
+        vkCmdDrawIndexedIndirect(command_buffer, m_command_buffer, 0, m_instance_count, stride);
+    } else {
+        for (uint32_t i = 0; i < m_instance_count; i++) {
+            vkCmdDrawIndexedIndirect(command_buffer, m_command_buffer, i * stride, 1, stride);
+        }
+    }
+}
+
+void GpuCulling::record_depth_pyramid(VkCommandBuffer command_buffer, uint32_t frame_index, VkImageView depth_view)
+{
+    // The frame's previous use of its level 0 set has completed by the time it is recorded again. Rewritten every
+    // time, since a rebuilt render graph may have destroyed the last view and handed out its handle again.
+    VkDescriptorImageInfo src_info = { m_sampler, depth_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = m_pyramid_sets[frame_index],
+        .dstBinding = 0,
+        .descriptorCount = 1,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .pImageInfo = &src_info,
+    };
+    vkUpdateDescriptorSets(m_device.device(), 1, &write, 0, nullptr);
+
+    // The previous cull may still be sampling the pyramid that is about to be overwritten.
+    memory_barrier(command_buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE,
+        VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_NONE);
+
+    m_pyramid_pipeline->bind(command_buffer);
+
+    VkExtent2D depth_extent = m_swap_chain.get_swap_chain_extent();
+    int32_t src_width = static_cast<int32_t>(depth_extent.width);
+    int32_t src_height = static_cast<int32_t>(depth_extent.height);
+
+    for (uint32_t level = 0; level < m_pyramid_levels; level++) {
+        int32_t dst_width = std::max(1, static_cast<int32_t>(m_pyramid_extent.width >> level));
+        int32_t dst_height = std::max(1, static_cast<int32_t>(m_pyramid_extent.height >> level));
+        int32_t push[4] = { src_width, src_height, dst_width, dst_height };
+
+        VkDescriptorSet set = level == 0 ? m_pyramid_sets[frame_index]
+                                         : m_pyramid_sets[SwapChain::MAX_FRAMES_IN_FLIGHT + level - 1];
+        vkCmdBindDescriptorSets(
+            command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramid_layout, 0, 1, &set, 0, nullptr);
+        vkCmdPushConstants(command_buffer, m_pyramid_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), push);
+        vkCmdDispatch(command_buffer, ComputePipeline::group_count(dst_width, PYRAMID_TILE),
+            ComputePipeline::group_count(dst_height, PYRAMID_TILE), 1);
+
+        memory_barrier(command_buffer, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+        src_width = dst_width;
+        src_height = dst_height;
+    }
+
+    m_pyramid_valid = true;
+}
+
+} // namespace Simulation
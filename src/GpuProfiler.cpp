@@ -0,0 +1,113 @@
+#include "GpuProfiler.hpp"
+#include "Debug.hpp"
+
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+GpuProfiler::GpuProfiler(Device& device, uint32_t frame_count, uint32_t max_scopes)
+    : m_device { device }
+    , m_supported { device.properties.limits.timestampComputeAndGraphics == VK_TRUE }
+    , m_period_ms { device.properties.limits.timestampPeriod * 1e-6 }
+    , m_max_scopes { max_scopes }
+    , m_frames(frame_count)
+{
+    if (!m_supported) {
+        return;
+    }
+
+    VkQueryPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = max_scopes * 2,
+    };
+    for (auto& frame : m_frames) {
+        if (vkCreateQueryPool(m_device.device(), &pool_info, nullptr, &frame.pool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create timestamp query pool");
+        }
+    }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+    if (!m_supported) {
+        return;
+    }
+    for (auto& frame : m_frames) {
+        vkDestroyQueryPool(m_device.device(), frame.pool, nullptr);
+    }
+}
+
+void GpuProfiler::begin_frame(VkCommandBuffer command_buffer, uint32_t frame_index)
+{
+    m_current = frame_index;
+    Frame& frame = m_frames[frame_index];
+    frame.names.clear();
+    if (m_supported) {
+        vkCmdResetQueryPool(command_buffer, frame.pool, 0, m_max_scopes * 2);
+    }
+}
+
+uint32_t GpuProfiler::begin_scope(VkCommandBuffer command_buffer, const std::string& name)
+{
+    Frame& frame = m_frames[m_current];
+    if (!m_supported || frame.names.size() >= m_max_scopes) {
+        return ~0u;
+    }
+
+    uint32_t scope = static_cast<uint32_t>(frame.names.size());
+    frame.names.push_back(name);
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT, frame.pool, scope * 2);
+    return scope;
+}
+
+void GpuProfiler::end_scope(VkCommandBuffer command_buffer, uint32_t scope)
+{
+    if (scope == ~0u) {
+        return;
+    }
+    vkCmdWriteTimestamp2(command_buffer, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_frames[m_current].pool, scope * 2 + 1);
+}
+
+const std::vector<GpuProfiler::Scope>& GpuProfiler::collect(uint32_t frame_index, bool wait)
+{
+    Frame& frame = m_frames[frame_index];
+    frame.results.clear();
+    if (!m_supported || frame.names.empty()) {
+        return frame.results;
+    }
+
+    std::vector<uint64_t> timestamps(frame.names.size() * 2);
+    VkQueryResultFlags flags = VK_QUERY_RESULT_64_BIT | (wait ? VK_QUERY_RESULT_WAIT_BIT : 0);
+    VkResult result = vkGetQueryPoolResults(m_device.device(), frame.pool, 0,
+        static_cast<uint32_t>(timestamps.size()), timestamps.size() * sizeof(uint64_t), timestamps.data(),
+        sizeof(uint64_t), flags);
+    if (result != VK_SUCCESS) {
+        return frame.results;
+    }
+
+    for (size_t i = 0; i < frame.names.size(); i++) {
+        double elapsed = static_cast<double>(timestamps[i * 2 + 1] - timestamps[i * 2]) * m_period_ms;
+        frame.results.push_back({ frame.names[i], elapsed });
+    }
+
+#ifdef SIM_ENABLE_TRACING
+    // Each scope name becomes a row of the trace's GPU process, placed on the CPU timeline through a fresh
+    // calibration. Without calibrated timestamps there is no common clock, so nothing is exported.
+    uint64_t gpu_ticks, cpu_nanoseconds;
+    if (Trace::instance().enabled() && m_device.calibrate_timestamps(gpu_ticks, cpu_nanoseconds)) {
+        auto to_cpu = [&](uint64_t ticks) {
+            double delta = static_cast<double>(static_cast<int64_t>(ticks - gpu_ticks)) * m_period_ms * 1e6;
+            return cpu_nanoseconds + static_cast<int64_t>(delta);
+        };
+        for (size_t i = 0; i < frame.names.size(); i++) {
+            Trace::instance().record_gpu(
+                frame.names[i], frame.names[i], to_cpu(timestamps[i * 2]), to_cpu(timestamps[i * 2 + 1]));
+        }
+    }
+#endif
+    return frame.results;
+}
+
+} // namespace Simulation
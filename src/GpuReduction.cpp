@@ -0,0 +1,365 @@
+#include "GpuReduction.hpp"
+#include "Shaders.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+GpuReduction::GpuReduction(Device& device, uint32_t slots, uint32_t max_words, uint32_t max_reductions)
+    : m_device { device }
+    , m_slots { slots }
+    , m_max_words { max_words }
+    , m_max_reductions { max_reductions }
+    , m_subgroups { device.supports_subgroup_arithmetic() }
+{
+    // A power of two, which the shared memory reductions rely on.
+    const VkPhysicalDeviceLimits& limits = m_device.properties.limits;
+    uint32_t limit = std::min(limits.maxComputeWorkGroupInvocations, limits.maxComputeWorkGroupSize[0]);
+    m_group_size = 256;
+    while (m_group_size > limit) {
+        m_group_size /= 2;
+    }
+
+    create_buffers();
+    create_layouts();
+
+    SpecializationConstants specialization;
+    specialization.set(GROUP_SIZE_ID, m_group_size);
+    m_reduce = std::make_unique<ComputePipeline>(m_device,
+        m_subgroups ? std::span<const uint32_t>(Shaders::reduce_subgroup_comp) : Shaders::reduce_comp,
+        m_pipeline_layout, specialization);
+    m_histogram =
+        std::make_unique<ComputePipeline>(m_device, Shaders::histogram_comp, m_pipeline_layout, specialization);
+    m_scan = std::make_unique<ComputePipeline>(m_device,
+        m_subgroups ? std::span<const uint32_t>(Shaders::scan_subgroup_comp) : Shaders::scan_comp, m_pipeline_layout,
+        specialization);
+
+    add_source(m_partials);
+}
+
+GpuReduction::~GpuReduction()
+{
+    VkDevice device = m_device.device();
+    m_reduce.reset();
+    m_histogram.reset();
+    m_scan.reset();
+    vkDestroyDescriptorPool(device, m_descriptor_pool, nullptr);
+    vkDestroyPipelineLayout(device, m_pipeline_layout, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_set_layout, nullptr);
+    vkUnmapMemory(device, m_readback_memory);
+    vkDestroyBuffer(device, m_readback, nullptr);
+    vkFreeMemory(device, m_readback_memory, nullptr);
+    vkDestroyBuffer(device, m_results, nullptr);
+    vkFreeMemory(device, m_results_memory, nullptr);
+    vkDestroyBuffer(device, m_partials, nullptr);
+    vkFreeMemory(device, m_partials_memory, nullptr);
+}
+
+void GpuReduction::create_buffers()
+{
+    m_device.create_buffer(sizeof(glm::vec4) * MAX_GROUPS * m_max_reductions, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_partials, m_partials_memory);
+    m_device.create_buffer(sizeof(uint32_t) * m_max_words,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_results, m_results_memory);
+    m_device.create_buffer(sizeof(uint32_t) * m_max_words * m_slots, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_readback, m_readback_memory);
+
+    void* mapped;
+    if (vkMapMemory(m_device.device(), m_readback_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map reduction readback buffer");
+    }
+    m_mapped = static_cast<const uint32_t*>(mapped);
+}
+
+void GpuReduction::create_layouts()
+{
+    // Source, partials, results.
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = { {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data(),
+    };
+    if (vkCreateDescriptorSetLayout(m_device.device(), &layout_info, nullptr, &m_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reduction descriptor set layout");
+    }
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = static_cast<uint32_t>(std::max({ sizeof(ReducePush), sizeof(HistogramPush), sizeof(ScanPush) })),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    if (vkCreatePipelineLayout(m_device.device(), &pipeline_layout_info, nullptr, &m_pipeline_layout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reduction pipeline layout");
+    }
+
+    // One more set than sources for the partials.
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * (MAX_SOURCES + 1) };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = MAX_SOURCES + 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    if (vkCreateDescriptorPool(m_device.device(), &pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create reduction descriptor pool");
+    }
+}
+
+uint32_t GpuReduction::add_source(VkBuffer buffer)
+{
+    if (m_sets.size() > MAX_SOURCES) {
+        throw std::runtime_error("too many reduction sources");
+    }
+
+    VkDescriptorSet set;
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_set_layout,
+    };
+    if (vkAllocateDescriptorSets(m_device.device(), &alloc_info, &set) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate reduction descriptor set");
+    }
+
+    std::array<VkDescriptorBufferInfo, 3> infos = { {
+        { buffer, 0, VK_WHOLE_SIZE },
+        { m_partials, 0, VK_WHOLE_SIZE },
+        { m_results, 0, VK_WHOLE_SIZE },
+    } };
+    std::array<VkWriteDescriptorSet, 3> writes;
+    for (uint32_t binding = 0; binding < 3; binding++) {
+        writes[binding] = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = set,
+            .dstBinding = binding,
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .pBufferInfo = &infos[binding],
+        };
+    }
+    vkUpdateDescriptorSets(m_device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+
+    m_sets.push_back(set);
+    return static_cast<uint32_t>(m_sets.size() - 1);
+}
+
+void GpuReduction::begin(VkCommandBuffer command_buffer)
+{
+    m_words_used = 0;
+    m_final_passes.clear();
+    m_scans.clear();
+
+    // The previous recording's final passes and copy are done with the partials and results, and the caller's
+    // writes to the sources are visible.
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+            | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    // Histograms accumulate into the results.
+    vkCmdFillBuffer(command_buffer, m_results, 0, VK_WHOLE_SIZE, 0);
+    barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+uint32_t GpuReduction::reduce(
+    VkCommandBuffer command_buffer, uint32_t source, Op op, const Field& field, uint32_t count)
+{
+    if (m_final_passes.size() == m_max_reductions) {
+        throw std::runtime_error("too many reductions in one recording");
+    }
+
+    uint32_t word = allocate_words(4);
+    uint32_t groups = std::clamp(ComputePipeline::group_count(count, m_group_size), 1u, MAX_GROUPS);
+    uint32_t first_partial = static_cast<uint32_t>(m_final_passes.size()) * MAX_GROUPS;
+    ReducePush push = {
+        .offset = field.offset,
+        .stride = field.stride,
+        .count = count,
+        .op = static_cast<uint32_t>(op),
+        .use_length = field.length,
+        .destination = first_partial,
+        .final_pass = 0,
+    };
+    bind(command_buffer, *m_reduce, source);
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(command_buffer, groups, 1, 1);
+
+    m_final_passes.push_back({
+        .offset = first_partial,
+        .stride = 1,
+        .count = groups,
+        .op = static_cast<uint32_t>(op),
+        .use_length = 0,
+        .destination = word,
+        .final_pass = 1,
+    });
+    return word;
+}
+
+uint32_t GpuReduction::histogram(VkCommandBuffer command_buffer, uint32_t source, const Field& field,
+    uint32_t component, uint32_t count, float low, float high, uint32_t bins)
+{
+    if (bins == 0 || bins > MAX_BINS || !(high > low) || component > 3) {
+        throw std::runtime_error("invalid histogram");
+    }
+
+    uint32_t word = allocate_words(bins);
+    HistogramPush push = {
+        .offset = field.offset,
+        .stride = field.stride,
+        .count = count,
+        .use_length = field.length,
+        .component = component,
+        .destination = word,
+        .bins = bins,
+        .low = low,
+        .high = high,
+    };
+    bind(command_buffer, *m_histogram, source);
+    vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+    vkCmdDispatch(command_buffer, std::clamp(ComputePipeline::group_count(count, m_group_size), 1u, MAX_GROUPS), 1, 1);
+    return word;
+}
+
+void GpuReduction::scan(VkCommandBuffer, uint32_t word, uint32_t count)
+{
+    if (word + count > m_words_used) {
+        throw std::runtime_error("scan range outside the recorded results");
+    }
+    m_scans.push_back({ .destination = word, .count = count });
+}
+
+void GpuReduction::end(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    compute_barrier(command_buffer);
+    for (const ReducePush& push : m_final_passes) {
+        bind(command_buffer, *m_reduce, 0);
+        vkCmdPushConstants(command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+        vkCmdDispatch(command_buffer, 1, 1, 1);
+    }
+    if (!m_scans.empty()) {
+        compute_barrier(command_buffer);
+        for (const ScanPush& push : m_scans) {
+            bind(command_buffer, *m_scan, 0);
+            vkCmdPushConstants(
+                command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push);
+            vkCmdDispatch(command_buffer, 1, 1, 1);
+        }
+    }
+
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    if (m_words_used > 0) {
+        VkBufferCopy region = {
+            .srcOffset = 0,
+            .dstOffset = sizeof(uint32_t) * m_max_words * slot,
+            .size = sizeof(uint32_t) * m_words_used,
+        };
+        vkCmdCopyBuffer(command_buffer, m_results, m_readback, 1, &region);
+    }
+
+    barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+glm::vec4 GpuReduction::value(uint32_t slot, uint32_t word)
+{
+    glm::vec4 value;
+    std::memcpy(&value, words(slot, word), sizeof(value));
+    return value;
+}
+
+const uint32_t* GpuReduction::words(uint32_t slot, uint32_t word)
+{
+    return m_mapped + static_cast<size_t>(m_max_words) * slot + word;
+}
+
+uint32_t GpuReduction::allocate_words(uint32_t count)
+{
+    if (m_words_used + count > m_max_words) {
+        throw std::runtime_error("reduction results exceed their buffer");
+    }
+    uint32_t word = m_words_used;
+    m_words_used += count;
+    return word;
+}
+
+void GpuReduction::bind(VkCommandBuffer command_buffer, ComputePipeline& pipeline, uint32_t source)
+{
+    pipeline.bind(command_buffer);
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_sets[source], 0, nullptr);
+}
+
+void GpuReduction::compute_barrier(VkCommandBuffer command_buffer)
+{
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+} // namespace Simulation
@@ -0,0 +1,234 @@
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+namespace Simulation {
+
+static constexpr const char* SEVERITY_NAMES[] = { "debug", "info", "warning", "error" };
+static constexpr const char* CATEGORY_NAMES[]
+    = { "general", "validation", "performance", "device", "presentation", "tuning", "capture", "stats", "simulation" };
+static_assert(std::size(CATEGORY_NAMES) == static_cast<size_t>(LogCategory::Count));
+
+static constexpr auto IDLE_POLL = std::chrono::milliseconds(2);
+static constexpr auto RATE_WINDOW = std::chrono::seconds(1);
+
+Logger& Logger::instance()
+{
+    static Logger logger;
+    return logger;
+}
+
+Logger::Logger()
+    : m_cells { new Cell[CAPACITY] }
+    , m_start { std::chrono::steady_clock::now() }
+{
+    for (uint32_t i = 0; i < CAPACITY; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    m_thread = std::thread(&Logger::drain_loop, this);
+}
+
+Logger::~Logger()
+{
+    m_stop = true;
+    m_thread.join();
+}
+
+void Logger::set_category_enabled(LogCategory category, bool enabled)
+{
+    uint32_t bit = 1u << static_cast<uint32_t>(category);
+    if (enabled) {
+        m_disabled_categories.fetch_and(~bit);
+    } else {
+        m_disabled_categories.fetch_or(bit);
+    }
+}
+
+bool Logger::enabled(LogSeverity severity, LogCategory category)
+{
+    return static_cast<uint32_t>(severity) >= m_min_severity.load(std::memory_order_relaxed)
+        && !(m_disabled_categories.load(std::memory_order_relaxed) & (1u << static_cast<uint32_t>(category)));
+}
+
+void Logger::log(LogSeverity severity, LogCategory category, const char* format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    vlog(severity, category, format, arguments);
+    va_end(arguments);
+}
+
+#define SIM_LOGGER_SHORTHAND(name, severity)                                                                         \
+    void Logger::name(LogCategory category, const char* format, ...)                                                 \
+    {                                                                                                                \
+        va_list arguments;                                                                                           \
+        va_start(arguments, format);                                                                                 \
+        instance().vlog(severity, category, format, arguments);                                                      \
+        va_end(arguments);                                                                                           \
+    }
+SIM_LOGGER_SHORTHAND(debug, LogSeverity::Debug)
+SIM_LOGGER_SHORTHAND(info, LogSeverity::Info)
+SIM_LOGGER_SHORTHAND(warning, LogSeverity::Warning)
+SIM_LOGGER_SHORTHAND(error, LogSeverity::Error)
+#undef SIM_LOGGER_SHORTHAND
+
+void Logger::vlog(LogSeverity severity, LogCategory category, const char* format, va_list arguments)
+{
+    if (!enabled(severity, category)) {
+        return;
+    }
+
+    // Claim a cell: its sequence equals the position while it is free for that lap of the ring.
+    uint64_t position = m_enqueue_position.load(std::memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &m_cells[position & (CAPACITY - 1)];
+        uint64_t sequence = cell->sequence.load(std::memory_order_acquire);
+        int64_t difference = static_cast<int64_t>(sequence) - static_cast<int64_t>(position);
+        if (difference == 0) {
+            if (m_enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (difference < 0) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            position = m_enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    Record& record = cell->record;
+    record.time = std::chrono::steady_clock::now();
+    record.severity = severity;
+    record.category = category;
+    int length = std::vsnprintf(record.text, MAX_MESSAGE, format, arguments);
+    record.length = static_cast<uint32_t>(std::clamp(length, 0, static_cast<int>(MAX_MESSAGE) - 1));
+    cell->sequence.store(position + 1, std::memory_order_release);
+}
+
+void Logger::flush()
+{
+    uint64_t target = m_enqueue_position.load(std::memory_order_acquire);
+    while (m_written.load(std::memory_order_acquire) < target) {
+        std::this_thread::sleep_for(IDLE_POLL);
+    }
+}
+
+void Logger::write(const Record& record)
+{
+    double seconds = std::chrono::duration<double>(record.time - m_start).count();
+    std::FILE* stream = record.severity >= LogSeverity::Warning ? stderr : stdout;
+    std::fprintf(stream, "[%9.3f] %s %s: %.*s\n", seconds, SEVERITY_NAMES[static_cast<uint32_t>(record.severity)],
+        CATEGORY_NAMES[static_cast<uint32_t>(record.category)], static_cast<int>(record.length), record.text);
+}
+
+void Logger::drain_loop()
+{
+    struct Repeats {
+        std::chrono::steady_clock::time_point window_start;
+        uint32_t count;
+        uint64_t suppressed;
+        Record first;
+    };
+    std::unordered_map<uint64_t, Repeats> windows;
+
+    auto summarise = [&](Repeats& entry) {
+        if (entry.suppressed != 0) {
+            Record summary = entry.first;
+            summary.time = std::chrono::steady_clock::now();
+            int length = std::snprintf(summary.text, MAX_MESSAGE, "%llu repeats suppressed: %.*s",
+                static_cast<unsigned long long>(entry.suppressed), static_cast<int>(entry.first.length),
+                entry.first.text);
+            summary.length = static_cast<uint32_t>(std::clamp(length, 0, static_cast<int>(MAX_MESSAGE) - 1));
+            write(summary);
+        }
+    };
+
+    auto last_sweep = std::chrono::steady_clock::now();
+    for (;;) {
+        bool stopping = m_stop.load(std::memory_order_acquire);
+        bool progressed = false;
+        for (;;) {
+            Cell& cell = m_cells[m_dequeue_position & (CAPACITY - 1)];
+            if (cell.sequence.load(std::memory_order_acquire) != m_dequeue_position + 1) {
+                break;
+            }
+
+            // Identical text from the same category counts as a repeat.
+            const Record& record = cell.record;
+            uint64_t key = std::hash<std::string_view> {}(std::string_view(record.text, record.length))
+                ^ static_cast<uint64_t>(record.category);
+            auto [entry, inserted] = windows.try_emplace(key, Repeats { record.time, 0, 0, record });
+            if (!inserted && record.time - entry->second.window_start >= RATE_WINDOW) {
+                summarise(entry->second);
+                entry->second = { record.time, 0, 0, record };
+            }
+            if (++entry->second.count <= RATE_LIMIT) {
+                write(record);
+            } else {
+                entry->second.suppressed++;
+            }
+
+            cell.sequence.store(m_dequeue_position + CAPACITY, std::memory_order_release);
+            m_dequeue_position++;
+            progressed = true;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_sweep >= RATE_WINDOW || stopping) {
+            for (auto it = windows.begin(); it != windows.end();) {
+                if (now - it->second.window_start >= RATE_WINDOW || stopping) {
+                    summarise(it->second);
+                    it = windows.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            last_sweep = now;
+        }
+        if (uint64_t dropped = m_dropped.exchange(0, std::memory_order_relaxed)) {
+            std::fprintf(
+                stderr, "[logger] %llu messages dropped, ring full\n", static_cast<unsigned long long>(dropped));
+        }
+
+        if (progressed) {
+            std::fflush(stdout);
+            std::fflush(stderr);
+        }
+        m_written.store(m_dequeue_position, std::memory_order_release);
+        if (stopping) {
+            return;
+        }
+        if (!progressed) {
+            std::this_thread::sleep_for(IDLE_POLL);
+        }
+    }
+}
+
+bool Logger::parse_severity(const std::string& name, LogSeverity& severity)
+{
+    for (uint32_t i = 0; i < std::size(SEVERITY_NAMES); i++) {
+        if (name == SEVERITY_NAMES[i]) {
+            severity = static_cast<LogSeverity>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Logger::parse_category(const std::string& name, LogCategory& category)
+{
+    for (uint32_t i = 0; i < std::size(CATEGORY_NAMES); i++) {
+        if (name == CATEGORY_NAMES[i]) {
+            category = static_cast<LogCategory>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace Simulation
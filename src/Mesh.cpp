@@ -0,0 +1,143 @@
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+Mesh::Mesh(Device& device, UploadQueue& uploader, const std::string& path)
+    : m_device { device }
+    , m_uploader { uploader }
+    , m_asset { path }
+{
+    uint32_t lod_count = m_asset.lod_count();
+    m_vertex_offsets.resize(lod_count);
+    m_index_offsets.resize(lod_count);
+    m_pending_streams.assign(lod_count, 2);
+
+    VkDeviceSize vertex_size = 0;
+    VkDeviceSize index_size = 0;
+    for (uint32_t i = 0; i < lod_count; i++) {
+        const MeshFileLod& l = m_asset.lod(i);
+        m_vertex_offsets[i] = vertex_size;
+        vertex_size = align_up(vertex_size + static_cast<VkDeviceSize>(l.vertex_count) * sizeof(MeshVertex), 16);
+        m_index_offsets[i] = index_size;
+        index_size = align_up(index_size + static_cast<VkDeviceSize>(l.index_count) * l.index_size, 16);
+    }
+
+    m_device.create_buffer(vertex_size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertex_buffer, m_vertex_memory);
+    m_device.create_buffer(index_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_index_buffer, m_index_memory);
+
+    // Coarsest level first so something can be drawn after the first few batches.
+    for (uint32_t i = lod_count; i-- > 0;) {
+        const MeshFileLod& l = m_asset.lod(i);
+        m_asset.prefetch(i);
+        m_uploader.enqueue(m_vertex_buffer, m_vertex_offsets[i], m_asset.vertex_data(i),
+            static_cast<VkDeviceSize>(l.vertex_count) * sizeof(MeshVertex), [this, i] { stream_complete(i); });
+        m_uploader.enqueue(m_index_buffer, m_index_offsets[i], m_asset.index_data(i),
+            static_cast<VkDeviceSize>(l.index_count) * l.index_size, [this, i] { stream_complete(i); });
+    }
+}
+
+glm::vec3 Mesh::bounds_min() const
+{
+    const MeshFileHeader& h = m_asset.header();
+    return { h.bounds_min[0], h.bounds_min[1], h.bounds_min[2] };
+}
+
+glm::vec3 Mesh::bounds_max() const
+{
+    const MeshFileHeader& h = m_asset.header();
+    return { h.bounds_max[0], h.bounds_max[1], h.bounds_max[2] };
+}
+
+Mesh::~Mesh()
+{
+    // Pending requests point into the mapping and at this object.
+    m_uploader.wait_idle();
+
+    vkDestroyBuffer(m_device.device(), m_vertex_buffer, nullptr);
+    vkFreeMemory(m_device.device(), m_vertex_memory, nullptr);
+    vkDestroyBuffer(m_device.device(), m_index_buffer, nullptr);
+    vkFreeMemory(m_device.device(), m_index_memory, nullptr);
+}
+
+std::vector<VkVertexInputBindingDescription> Mesh::binding_descriptions()
+{
+    return { { .binding = 0, .stride = sizeof(MeshVertex), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX } };
+}
+
+std::vector<VkVertexInputAttributeDescription> Mesh::attribute_descriptions()
+{
+    return {
+        { .location = 0,
+            .binding = 0,
+            .format = VK_FORMAT_R16G16B16A16_UNORM,
+            .offset = offsetof(MeshVertex, position) },
+        { .location = 1, .binding = 0, .format = VK_FORMAT_R16G16_SNORM, .offset = offsetof(MeshVertex, normal) },
+    };
+}
+
+Mesh::PushConstants Mesh::push_constants(const glm::mat4& transform) const
+{
+    glm::vec3 min = bounds_min();
+    glm::vec3 max = bounds_max();
+    return {
+        .transform = transform,
+        .position_offset = glm::vec4(min, 0.0f),
+        .position_scale = glm::vec4(max - min, 1.0f),
+    };
+}
+
+Mesh::PushConstants Mesh::unit_push_constants(const glm::mat4& transform) const
+{
+    glm::vec3 min = bounds_min();
+    glm::vec3 max = bounds_max();
+    glm::vec3 center = (min + max) * 0.5f;
+    float radius = std::max(0.5f * glm::length(max - min), 1e-6f);
+    return {
+        .transform = transform,
+        .position_offset = glm::vec4((min - center) / radius, 0.0f),
+        .position_scale = glm::vec4((max - min) / radius, 1.0f),
+    };
+}
+
+void Mesh::stream_complete(uint32_t lod)
+{
+    if (--m_pending_streams[lod] != 0)
+        return;
+
+    // Only count a level once every coarser one is resident too, so LOD selection never skips a hole.
+    int finest = m_asset.lod_count();
+    while (finest > 0 && m_pending_streams[finest - 1] == 0) {
+        finest--;
+    }
+    m_finest_resident = finest < static_cast<int>(m_asset.lod_count()) ? finest : -1;
+}
+
+bool Mesh::draw_item(uint32_t desired_lod, DrawItem& item) const
+{
+    if (m_finest_resident < 0)
+        return false;
+
+    uint32_t lod = std::max<uint32_t>(desired_lod, m_finest_resident);
+    lod = std::min(lod, m_asset.lod_count() - 1);
+    const MeshFileLod& l = m_asset.lod(lod);
+
+    item = {
+        .vertex_buffer = m_vertex_buffer,
+        .vertex_offset = m_vertex_offsets[lod],
+        .index_buffer = m_index_buffer,
+        .index_offset = m_index_offsets[lod],
+        .index_type = l.index_size == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32,
+        .count = l.index_count,
+    };
+    return true;
+}
+
+} // namespace Simulation
@@ -0,0 +1,319 @@
+#include "MeshFile.hpp"
+#include "VertexFormat.hpp"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace Simulation {
+
+static uint64_t align_up(uint64_t value, uint64_t alignment) { return (value + alignment - 1) / alignment * alignment; }
+
+void write_mesh_file(const std::string& path, const std::vector<MeshSourceLod>& lods)
+{
+    if (lods.empty()) {
+        throw std::runtime_error("cannot write a mesh without LODs");
+    }
+
+    glm::vec3 bounds_min = lods[0].positions.empty() ? glm::vec3(0.0f) : lods[0].positions[0];
+    glm::vec3 bounds_max = bounds_min;
+    for (const auto& lod : lods) {
+        for (const auto& p : lod.positions) {
+            bounds_min = glm::min(bounds_min, p);
+            bounds_max = glm::max(bounds_max, p);
+        }
+    }
+    glm::vec3 extent = glm::max(bounds_max - bounds_min, glm::vec3(1e-12f));
+
+    MeshFileHeader header = {
+        .magic = MeshFileHeader::MAGIC,
+        .version = MeshFileHeader::VERSION,
+        .lod_count = static_cast<uint32_t>(lods.size()),
+        .vertex_stride = sizeof(MeshVertex),
+        .bounds_min = { bounds_min.x, bounds_min.y, bounds_min.z },
+        .bounds_max = { bounds_max.x, bounds_max.y, bounds_max.z },
+        .reserved = {},
+    };
+
+    std::vector<MeshFileLod> table(lods.size());
+    std::vector<std::vector<MeshVertex>> vertices(lods.size());
+    std::vector<std::vector<char>> indices(lods.size());
+
+    uint64_t offset = align_up(
+        sizeof(MeshFileHeader) + sizeof(MeshFileLod) * lods.size(), MeshFileHeader::STREAM_ALIGNMENT);
+    for (size_t i = lods.size(); i-- > 0;) {
+        const auto& src = lods[i];
+        if (src.normals.size() != src.positions.size()) {
+            throw std::runtime_error("mesh LOD has mismatched position and normal counts");
+        }
+        if (src.positions.empty() || src.indices.empty()) {
+            throw std::runtime_error("mesh LOD has no triangles");
+        }
+
+        vertices[i].resize(src.positions.size());
+        for (size_t v = 0; v < src.positions.size(); v++) {
+            glm::vec3 unit = (src.positions[v] - bounds_min) / extent;
+            glm::vec2 oct = oct_encode(src.normals[v]);
+            vertices[i][v] = {
+                .position = { quantize_unorm16(unit.x), quantize_unorm16(unit.y), quantize_unorm16(unit.z), 0 },
+                .normal = { quantize_snorm16(oct.x), quantize_snorm16(oct.y) },
+            };
+        }
+
+        IndexStream stream = narrow_indices(src.indices, src.positions.size());
+        indices[i] = std::move(stream.bytes);
+
+        table[i].vertex_offset = offset;
+        offset = align_up(offset + vertices[i].size() * sizeof(MeshVertex), MeshFileHeader::STREAM_ALIGNMENT);
+        table[i].index_offset = offset;
+        offset = align_up(offset + indices[i].size(), MeshFileHeader::STREAM_ALIGNMENT);
+        table[i].vertex_count = static_cast<uint32_t>(src.positions.size());
+        table[i].index_count = static_cast<uint32_t>(src.indices.size());
+        table[i].index_size = stream.index_size;
+        table[i].reserved = 0;
+    }
+
+    std::ofstream file { path, std::ios::binary | std::ios::trunc };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file " + path);
+    }
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), sizeof(MeshFileLod) * table.size());
+    for (size_t i = lods.size(); i-- > 0;) {
+        file.seekp(static_cast<std::streamoff>(table[i].vertex_offset));
+        file.write(reinterpret_cast<const char*>(vertices[i].data()), vertices[i].size() * sizeof(MeshVertex));
+        file.seekp(static_cast<std::streamoff>(table[i].index_offset));
+        file.write(indices[i].data(), indices[i].size());
+    }
+    // Pad the file so the last stream ends on the stream alignment like every other one.
+    file.seekp(static_cast<std::streamoff>(offset - 1));
+    file.put(0);
+}
+
+MeshAsset::MeshAsset(const std::string& path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("failed to open file " + path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(MeshFileHeader)) {
+        close(fd);
+        throw std::runtime_error("mesh file is truncated: " + path);
+    }
+    m_size = static_cast<size_t>(st.st_size);
+
+    m_data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m_data == MAP_FAILED) {
+        m_data = nullptr;
+        throw std::runtime_error("failed to mmap mesh file " + path);
+    }
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+
+    const MeshFileHeader& h = header();
+    bool valid = h.magic == MeshFileHeader::MAGIC && h.version == MeshFileHeader::VERSION
+        && h.vertex_stride == sizeof(MeshVertex) && h.lod_count > 0
+        && sizeof(MeshFileHeader) + sizeof(MeshFileLod) * h.lod_count <= m_size;
+    for (uint32_t i = 0; valid && i < h.lod_count; i++) {
+        const MeshFileLod& l = lod(i);
+        // Offsets are checked on their own first so that adding the stream length cannot wrap around.
+        valid = (l.index_size == 2 || l.index_size == 4) && l.vertex_count > 0 && l.index_count > 0
+            && l.vertex_offset <= m_size && l.index_offset <= m_size
+            && l.vertex_offset + static_cast<uint64_t>(l.vertex_count) * sizeof(MeshVertex) <= m_size
+            && l.index_offset + static_cast<uint64_t>(l.index_count) * l.index_size <= m_size;
+    }
+    if (!valid) {
+        munmap(m_data, m_size);
+        throw std::runtime_error("invalid mesh file " + path);
+    }
+}
+
+MeshAsset::~MeshAsset() { munmap(m_data, m_size); }
+
+const MeshFileLod& MeshAsset::lod(uint32_t index) const
+{
+    auto table = reinterpret_cast<const MeshFileLod*>(static_cast<const char*>(m_data) + sizeof(MeshFileHeader));
+    return table[index];
+}
+
+const void* MeshAsset::vertex_data(uint32_t index) const
+{
+    return static_cast<const char*>(m_data) + lod(index).vertex_offset;
+}
+
+const void* MeshAsset::index_data(uint32_t index) const
+{
+    return static_cast<const char*>(m_data) + lod(index).index_offset;
+}
+
+void MeshAsset::prefetch(uint32_t index) const
+{
+    const MeshFileLod& l = lod(index);
+    uint64_t page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    uint64_t begin = l.vertex_offset / page * page;
+    uint64_t end = std::min<uint64_t>(l.index_offset + static_cast<uint64_t>(l.index_count) * l.index_size, m_size);
+    madvise(static_cast<char*>(m_data) + begin, end - begin, MADV_WILLNEED);
+}
+
+
+// One index of a face corner: 1-based, or negative to count back from the latest element; 0 when absent.
+static uint32_t obj_index(const std::string& token, size_t count)
+{
+    if (token.empty()) {
+        return 0;
+    }
+    long index = std::stol(token);
+    if (index < 0) {
+        index += static_cast<long>(count) + 1;
+    }
+    if (index <= 0 || index > static_cast<long>(count)) {
+        throw std::out_of_range(token);
+    }
+    return static_cast<uint32_t>(index);
+}
+
+MeshSourceLod read_obj_file(const std::string& path)
+{
+    std::ifstream file { path };
+    if (!file.is_open()) {
+        throw std::runtime_error("failed to open file " + path);
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> normals;
+    MeshSourceLod mesh;
+    // (position, normal) index pair -> vertex; normal 0 when the face did not give one.
+    std::unordered_map<uint64_t, uint32_t> vertices;
+    std::vector<bool> computed_normal;
+
+    std::string line;
+    for (uint32_t line_number = 1; std::getline(file, line); line_number++) {
+        std::istringstream tokens { line };
+        std::string kind;
+        tokens >> kind;
+        try {
+            if (kind == "v" || kind == "vn") {
+                glm::vec3 value;
+                if (!(tokens >> value.x >> value.y >> value.z)) {
+                    throw std::invalid_argument(kind);
+                }
+                (kind == "v" ? positions : normals).push_back(value);
+            } else if (kind == "f") {
+                std::vector<uint32_t> corners;
+                for (std::string corner; tokens >> corner;) {
+                    size_t first_slash = corner.find('/');
+                    size_t last_slash = corner.rfind('/');
+                    uint32_t position = obj_index(corner.substr(0, first_slash), positions.size());
+                    uint32_t normal = first_slash != std::string::npos && last_slash != first_slash
+                        ? obj_index(corner.substr(last_slash + 1), normals.size())
+                        : 0;
+                    if (position == 0) {
+                        throw std::invalid_argument(corner);
+                    }
+
+                    uint64_t key = static_cast<uint64_t>(position) << 32 | normal;
+                    auto [vertex, inserted] = vertices.try_emplace(key, static_cast<uint32_t>(mesh.positions.size()));
+                    if (inserted) {
+                        mesh.positions.push_back(positions[position - 1]);
+                        mesh.normals.push_back(normal != 0 ? normals[normal - 1] : glm::vec3(0.0f));
+                        computed_normal.push_back(normal == 0);
+                    }
+                    corners.push_back(vertex->second);
+                }
+                if (corners.size() < 3) {
+                    throw std::invalid_argument(line);
+                }
+
+                for (size_t i = 2; i < corners.size(); i++) {
+                    uint32_t a = corners[0];
+                    uint32_t b = corners[i - 1];
+                    uint32_t c = corners[i];
+                    mesh.indices.insert(mesh.indices.end(), { a, b, c });
+                    // The cross product's length is twice the area, which weights the average.
+                    glm::vec3 face = glm::cross(
+                        mesh.positions[b] - mesh.positions[a], mesh.positions[c] - mesh.positions[a]);
+                    for (uint32_t v : { a, b, c }) {
+                        if (computed_normal[v]) {
+                            mesh.normals[v] += face;
+                        }
+                    }
+                }
+            }
+        } catch (const std::logic_error&) {
+            throw std::runtime_error("invalid OBJ line " + std::to_string(line_number) + " in " + path);
+        }
+    }
+    if (mesh.indices.empty()) {
+        throw std::runtime_error("no faces in " + path);
+    }
+
+    for (auto& normal : mesh.normals) {
+        float length = glm::length(normal);
+        normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 0.0f, 1.0f);
+    }
+    return mesh;
+}
+
+MeshSourceLod simplify_mesh(const MeshSourceLod& lod, uint32_t cells)
+{
+    if (lod.positions.empty() || cells == 0) {
+        return {};
+    }
+    glm::vec3 bounds_min = lod.positions[0];
+    glm::vec3 bounds_max = bounds_min;
+    for (const auto& p : lod.positions) {
+        bounds_min = glm::min(bounds_min, p);
+        bounds_max = glm::max(bounds_max, p);
+    }
+    glm::vec3 extent = bounds_max - bounds_min;
+    float cell_size = std::max({ extent.x, extent.y, extent.z, 1e-12f }) / static_cast<float>(cells);
+
+    struct Cluster {
+        glm::vec3 position_sum { 0.0f };
+        glm::vec3 normal_sum { 0.0f };
+        uint32_t count = 0;
+    };
+    std::unordered_map<uint64_t, uint32_t> cell_clusters;
+    std::vector<Cluster> clusters;
+    std::vector<uint32_t> remap(lod.positions.size());
+    for (size_t v = 0; v < lod.positions.size(); v++) {
+        glm::uvec3 cell = glm::uvec3(glm::min((lod.positions[v] - bounds_min) / cell_size, glm::vec3(cells - 1)));
+        uint64_t key = (static_cast<uint64_t>(cell.x) << 42) | (static_cast<uint64_t>(cell.y) << 21) | cell.z;
+        auto [cluster, inserted] = cell_clusters.try_emplace(key, static_cast<uint32_t>(clusters.size()));
+        if (inserted) {
+            clusters.emplace_back();
+        }
+        Cluster& c = clusters[cluster->second];
+        c.position_sum += lod.positions[v];
+        c.normal_sum += lod.normals[v];
+        c.count++;
+        remap[v] = cluster->second;
+    }
+
+    MeshSourceLod coarse;
+    for (size_t i = 0; i + 2 < lod.indices.size(); i += 3) {
+        uint32_t a = remap[lod.indices[i]];
+        uint32_t b = remap[lod.indices[i + 1]];
+        uint32_t c = remap[lod.indices[i + 2]];
+        if (a != b && b != c && a != c) {
+            coarse.indices.insert(coarse.indices.end(), { a, b, c });
+        }
+    }
+    for (const auto& cluster : clusters) {
+        coarse.positions.push_back(cluster.position_sum / static_cast<float>(cluster.count));
+        float length = glm::length(cluster.normal_sum);
+        coarse.normals.push_back(length > 0.0f ? cluster.normal_sum / length : glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+    return coarse;
+}
+
+} // namespace Simulation
@@ -0,0 +1,464 @@
+#include "ParticleSimulation.hpp"
+#include "Debug.hpp"
+#include "Shaders.hpp"
+#include "TimelineSemaphore.hpp"
+#include "VertexFormat.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+static const glm::vec4 ATTRACTOR { 0.0f, 0.0f, 0.0f, 0.05f };
+// Four vec4 reductions and the speed histogram.
+static constexpr uint32_t DIAGNOSTIC_WORDS = 5 * 4 + ParticleSimulation::SPEED_BINS;
+
+ParticleSimulation::ParticleSimulation(Device& device, uint32_t particle_count, VertexEncoding encoding)
+    : m_device { device }
+    , m_count { particle_count }
+    , m_encoding { encoding }
+    , m_profiler { device, 2, 1 }
+    , m_reduction { device, 2, DIAGNOSTIC_WORDS }
+{
+    create_buffers();
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        m_state_sources[slot] = m_reduction.add_source(m_state_buffers[slot]);
+    }
+    create_descriptors();
+    create_command_buffers();
+    m_pipeline = std::make_unique<ComputePipeline>(
+        m_device, Shaders::particles_comp, m_pipeline_layout, m_specialization);
+    upload_initial_state();
+}
+
+ParticleSimulation::~ParticleSimulation()
+{
+    VkDevice device = m_device.device();
+    m_device.compute_timeline().wait(m_device.compute_timeline().last_reserved());
+
+    m_pipeline.reset();
+    vkDestroyCommandPool(device, m_command_pool, nullptr);
+    vkDestroyPipelineLayout(device, m_pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, m_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_set_layout, nullptr);
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        vkDestroyBuffer(device, m_state_buffers[slot], nullptr);
+        vkFreeMemory(device, m_state_memory[slot], nullptr);
+        vkDestroyBuffer(device, m_vertex_buffers[slot], nullptr);
+        vkFreeMemory(device, m_vertex_memory[slot], nullptr);
+    }
+}
+
+void ParticleSimulation::create_buffers()
+{
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        m_device.create_buffer(sizeof(Particle) * m_count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_state_buffers[slot], m_state_memory[slot]);
+        m_device.create_buffer(static_cast<VkDeviceSize>(vertex_size()) * m_count,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertex_buffers[slot], m_vertex_memory[slot]);
+    }
+}
+
+void ParticleSimulation::create_descriptors()
+{
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = { {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data(),
+    };
+    if (vkCreateDescriptorSetLayout(m_device.device(), &layout_info, nullptr, &m_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor set layout");
+    }
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(StepConstants),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    if (vkCreatePipelineLayout(m_device.device(), &pipeline_layout_info, nullptr, &m_pipeline_layout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle pipeline layout");
+    }
+
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * 2 };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 2,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    if (vkCreateDescriptorPool(m_device.device(), &pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle descriptor pool");
+    }
+
+    std::array<VkDescriptorSetLayout, 2> layouts = { m_set_layout, m_set_layout };
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = 2,
+        .pSetLayouts = layouts.data(),
+    };
+    if (vkAllocateDescriptorSets(m_device.device(), &alloc_info, m_sets) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate particle descriptor sets");
+    }
+
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        std::array<VkDescriptorBufferInfo, 3> infos = { {
+            { m_state_buffers[1 - slot], 0, VK_WHOLE_SIZE },
+            { m_state_buffers[slot], 0, VK_WHOLE_SIZE },
+            { m_vertex_buffers[slot], 0, VK_WHOLE_SIZE },
+        } };
+        std::array<VkWriteDescriptorSet, 3> writes;
+        for (uint32_t binding = 0; binding < 3; binding++) {
+            writes[binding] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_sets[slot],
+                .dstBinding = binding,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &infos[binding],
+            };
+        }
+        vkUpdateDescriptorSets(
+            m_device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void ParticleSimulation::create_command_buffers()
+{
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_device.compute_family(),
+    };
+    if (vkCreateCommandPool(m_device.device(), &pool_info, nullptr, &m_command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create particle command pool");
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 2,
+    };
+    if (vkAllocateCommandBuffers(m_device.device(), &alloc_info, m_command_buffers) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate particle command buffers");
+    }
+}
+
+std::vector<ParticleSimulation::Particle> ParticleSimulation::make_disc(uint32_t count, float strength, uint32_t seed)
+{
+    std::vector<Particle> particles(count);
+    std::mt19937 random { seed };
+    std::uniform_real_distribution<float> unit { 0.0f, 1.0f };
+    for (uint32_t i = 0; i < count; i++) {
+        float radius = 0.1f + 0.8f * std::sqrt(unit(random));
+        float angle = 6.2831853f * unit(random);
+        float height = 0.05f * (unit(random) - 0.5f);
+        glm::vec3 position { radius * std::cos(angle), radius * std::sin(angle), height };
+        float speed = std::sqrt(strength / radius);
+        glm::vec3 velocity { -speed * std::sin(angle), speed * std::cos(angle), 0.0f };
+        // As particles.comp computes it, with the same softening.
+        float energy = 0.5f * speed * speed - strength / std::sqrt(glm::dot(position, position) + 0.001f);
+        particles[i] = { glm::vec4(position, energy), glm::vec4(velocity, 0.0f) };
+    }
+    return particles;
+}
+
+// The disc as tick 0 in slot 0.
+void ParticleSimulation::upload_initial_state()
+{
+    std::vector<Particle> particles = make_disc(m_count, ATTRACTOR.w, 1234);
+    std::vector<glm::vec4> vertices(m_count);
+    for (uint32_t i = 0; i < m_count; i++) {
+        vertices[i] = glm::vec4(glm::vec3(particles[i].position) - vertex_origin(), glm::length(particles[i].velocity));
+    }
+    std::vector<uint16_t> half_vertices;
+    if (m_encoding == VertexEncoding::Half) {
+        half_vertices.resize(4 * m_count);
+        for (uint32_t i = 0; i < m_count; i++) {
+            for (int component = 0; component < 4; component++) {
+                half_vertices[4 * i + component] = quantize_half(vertices[i][component]);
+            }
+        }
+    }
+
+    VkDeviceSize state_size = sizeof(Particle) * m_count;
+    VkDeviceSize vertex_bytes = static_cast<VkDeviceSize>(vertex_size()) * m_count;
+    VkBuffer staging;
+    VkDeviceMemory staging_memory;
+    m_device.create_buffer(state_size + vertex_bytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, staging_memory);
+    void* mapped;
+    vkMapMemory(m_device.device(), staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    std::memcpy(mapped, particles.data(), state_size);
+    std::memcpy(static_cast<char*>(mapped) + state_size,
+        half_vertices.empty() ? static_cast<const void*>(vertices.data()) : half_vertices.data(), vertex_bytes);
+    vkUnmapMemory(m_device.device(), staging_memory);
+
+    // Recorded on the compute queue so the buffers start out owned by the family that simulates them.
+    VkCommandBuffer command_buffer = m_command_buffers[0];
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    VkBufferCopy state_region = { .srcOffset = 0, .dstOffset = 0, .size = state_size };
+    vkCmdCopyBuffer(command_buffer, staging, m_state_buffers[0], 1, &state_region);
+    VkBufferCopy vertex_region = { .srcOffset = state_size, .dstOffset = 0, .size = vertex_bytes };
+    vkCmdCopyBuffer(command_buffer, staging, m_vertex_buffers[0], 1, &vertex_region);
+    ownership_barrier(command_buffer, 0, true, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT);
+    vkEndCommandBuffer(command_buffer);
+
+    uint64_t value = m_device.submit_compute({ command_buffer });
+    m_device.compute_timeline().wait(value);
+    vkResetCommandBuffer(command_buffer, 0);
+    vkDestroyBuffer(m_device.device(), staging, nullptr);
+    vkFreeMemory(m_device.device(), staging_memory, nullptr);
+
+    m_tick = 0;
+    m_render_slot = 0;
+    m_tick_values[0] = value;
+    m_tick_values[1] = 0;
+    m_render_reads[0] = 0;
+    m_render_reads[1] = 0;
+    m_pending_acquire = true;
+}
+
+void ParticleSimulation::tune(Autotuner& tuner)
+{
+    const VkPhysicalDeviceLimits& limits = m_device.properties.limits;
+    std::vector<uint32_t> group_sizes;
+    for (uint32_t size : { 64u, 32u, 128u, 256u, 512u }) {
+        if (size <= limits.maxComputeWorkGroupSize[0] && size <= limits.maxComputeWorkGroupInvocations) {
+            group_sizes.push_back(size);
+        }
+    }
+    std::vector<TuningParameter> space = { { "group_size", GROUP_SIZE_ID, group_sizes } };
+
+    bool measured = tuner.needs_tuning("particles");
+    auto record = [&](VkCommandBuffer command_buffer, ComputePipeline& pipeline,
+                      const SpecializationConstants& constants) {
+        dispatch(command_buffer, pipeline, 1, 0.0f, constants.get(GROUP_SIZE_ID, m_group_size));
+    };
+    m_specialization = tuner.select("particles", Shaders::particles_comp, m_pipeline_layout, space, record, true);
+    m_group_size = m_specialization.get(GROUP_SIZE_ID, m_group_size);
+    m_pipeline = std::make_unique<ComputePipeline>(
+        m_device, Shaders::particles_comp, m_pipeline_layout, m_specialization);
+
+    // The variants ran on the compute queue, which owns the state buffers, but overwrote slot 1 and possibly the
+    // frame being drawn, so start over from the disc.
+    if (measured) {
+        upload_initial_state();
+    }
+}
+
+void ParticleSimulation::dispatch(
+    VkCommandBuffer command_buffer, ComputePipeline& pipeline, uint32_t slot, float dt, uint32_t group_size)
+{
+    StepConstants constants = {
+        .attractor = ATTRACTOR,
+        .dt = dt,
+        .count = m_count,
+        .half_vertices = m_encoding == VertexEncoding::Half,
+    };
+    pipeline.bind(command_buffer);
+    vkCmdBindDescriptorSets(
+        command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_sets[slot], 0, nullptr);
+    vkCmdPushConstants(
+        command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, ComputePipeline::group_count(m_count, group_size), 1, 1);
+}
+
+void ParticleSimulation::step(float dt)
+{
+    SIM_TRACE_ZONE("ParticleSimulation::step");
+    uint64_t tick = m_tick + 1;
+    uint32_t slot = static_cast<uint32_t>(tick % 2);
+
+    // The slot's command buffer, timestamps and readback were last used by tick - 2.
+    m_device.compute_timeline().wait(m_tick_values[slot]);
+    if (m_tick_values[slot] != 0) {
+        const auto& results = m_profiler.collect(slot);
+        if (!results.empty()) {
+            m_last_step_ms = results[0].milliseconds;
+        }
+    }
+    if (tick > 2) {
+        read_diagnostics(slot, tick - 2);
+    }
+
+    VkCommandBuffer command_buffer = m_command_buffers[slot];
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    m_profiler.begin_frame(command_buffer, slot);
+    uint32_t scope = m_profiler.begin_scope(command_buffer, "particles");
+
+    // The previous tick (or the initial upload) wrote the state read here and read the state written here.
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    dispatch(command_buffer, *m_pipeline, slot, dt, m_group_size);
+    m_profiler.end_scope(command_buffer, scope);
+    record_diagnostics(command_buffer, slot);
+    ownership_barrier(
+        command_buffer, slot, true, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+    vkEndCommandBuffer(command_buffer);
+
+    // The vertex buffer is overwritten without being handed back, so only the frame that drew it must be done.
+    std::vector<VkSemaphoreSubmitInfo> waits;
+    if (m_render_reads[slot] != 0) {
+        waits.push_back(
+            m_device.graphics_timeline().submit_info(m_render_reads[slot], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT));
+    }
+    m_tick_values[slot] = m_device.submit_compute({ command_buffer }, waits);
+    m_render_reads[slot] = 0;
+
+    m_tick = tick;
+    m_render_slot = 1 - slot;
+    m_pending_acquire = true;
+}
+
+void ParticleSimulation::record_diagnostics(VkCommandBuffer command_buffer, uint32_t slot)
+{
+    using Op = GpuReduction::Op;
+    GpuReduction::Field position = { .offset = 0, .stride = 2 };
+    GpuReduction::Field velocity = { .offset = 1, .stride = 2 };
+    GpuReduction::Field speed = { .offset = 1, .stride = 2, .length = true };
+    uint32_t source = m_state_sources[slot];
+
+    m_reduction.begin(command_buffer);
+    m_diagnostic_words = {
+        .energy = m_reduction.reduce(command_buffer, source, Op::Sum, position, m_count),
+        .momentum = m_reduction.reduce(command_buffer, source, Op::Sum, velocity, m_count),
+        .bounds_min = m_reduction.reduce(command_buffer, source, Op::Min, position, m_count),
+        .bounds_max = m_reduction.reduce(command_buffer, source, Op::Max, position, m_count),
+        .max_speed = m_reduction.reduce(command_buffer, source, Op::Max, speed, m_count),
+        .cumulative_speeds = m_reduction.histogram(
+            command_buffer, source, speed, 0, m_count, 0.0f, MAX_DIAGNOSTIC_SPEED, SPEED_BINS),
+    };
+    m_reduction.scan(command_buffer, m_diagnostic_words.cumulative_speeds, SPEED_BINS);
+    m_reduction.end(command_buffer, slot);
+}
+
+void ParticleSimulation::read_diagnostics(uint32_t slot, uint64_t tick)
+{
+    m_diagnostics.tick = tick;
+    m_diagnostics.energy = m_reduction.value(slot, m_diagnostic_words.energy).w;
+    m_diagnostics.momentum = glm::vec3(m_reduction.value(slot, m_diagnostic_words.momentum));
+    m_diagnostics.bounds_min = glm::vec3(m_reduction.value(slot, m_diagnostic_words.bounds_min));
+    m_diagnostics.bounds_max = glm::vec3(m_reduction.value(slot, m_diagnostic_words.bounds_max));
+    m_diagnostics.max_speed = m_reduction.value(slot, m_diagnostic_words.max_speed).x;
+    const uint32_t* counts = m_reduction.words(slot, m_diagnostic_words.cumulative_speeds);
+    m_diagnostics.cumulative_speeds.assign(counts, counts + SPEED_BINS);
+}
+
+float ParticleSimulation::Diagnostics::speed_percentile(float fraction) const
+{
+    if (cumulative_speeds.empty()) {
+        return 0.0f;
+    }
+    float rank = fraction * static_cast<float>(cumulative_speeds.back());
+    auto bin = std::find_if(cumulative_speeds.begin(), cumulative_speeds.end(),
+        [&](uint32_t count) { return static_cast<float>(count) >= rank; });
+    return static_cast<float>(bin - cumulative_speeds.begin() + 1) * MAX_DIAGNOSTIC_SPEED / SPEED_BINS;
+}
+
+VkSemaphoreSubmitInfo ParticleSimulation::render_wait()
+{
+    return m_device.compute_timeline().submit_info(
+        m_tick_values[m_render_slot], VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT);
+}
+
+void ParticleSimulation::record_acquire(VkCommandBuffer command_buffer)
+{
+    if (m_pending_acquire) {
+        ownership_barrier(command_buffer, m_render_slot, false, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+            VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT);
+        m_pending_acquire = false;
+    }
+}
+
+DrawItem ParticleSimulation::draw_item()
+{
+    return { .vertex_buffer = m_vertex_buffers[m_render_slot], .count = m_count };
+}
+
+// The release half is recorded on the compute queue with only source scopes, the acquire half on the graphics
+// queue with only destination scopes; the semaphore between the two submissions orders them.
+void ParticleSimulation::ownership_barrier(VkCommandBuffer command_buffer, uint32_t slot, bool release,
+    VkPipelineStageFlags2 stages, VkAccessFlags2 access)
+{
+    if (!m_device.has_async_compute()) {
+        return;
+    }
+
+    VkBufferMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .srcStageMask = release ? stages : VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask = release ? access : VK_ACCESS_2_NONE,
+        .dstStageMask = release ? VK_PIPELINE_STAGE_2_NONE : stages,
+        .dstAccessMask = release ? VK_ACCESS_2_NONE : access,
+        .srcQueueFamilyIndex = m_device.compute_family(),
+        .dstQueueFamilyIndex = m_device.graphics_family(),
+        .buffer = m_vertex_buffers[slot],
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .bufferMemoryBarrierCount = 1,
+        .pBufferMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+glm::vec3 ParticleSimulation::vertex_origin() { return glm::vec3(ATTRACTOR); }
+
+std::vector<VkVertexInputBindingDescription> ParticleSimulation::binding_descriptions()
+{
+    return { { .binding = 0, .stride = vertex_size(), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX } };
+}
+
+// The vertex fetch widens halves to floats, so particles.vert is the same for both encodings.
+std::vector<VkVertexInputAttributeDescription> ParticleSimulation::attribute_descriptions()
+{
+    VkFormat format
+        = m_encoding == VertexEncoding::Half ? VK_FORMAT_R16G16B16A16_SFLOAT : VK_FORMAT_R32G32B32A32_SFLOAT;
+    return { { .location = 0, .binding = 0, .format = format, .offset = 0 } };
+}
+
+} // namespace Simulation
@@ -1,17 +1,17 @@
 #include "Pipeline.hpp"
+#include "Debug.hpp"
 
 #include <cassert>
-#include <fstream>
-#include <iostream>
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
 
 namespace Simulation {
-Pipeline::Pipeline(Device& device, const std::string& vertex_filepath, const std::string& frag_filepath,
+Pipeline::Pipeline(Device& device, std::span<const uint32_t> vertex_code, std::span<const uint32_t> frag_code,
     const PipelineConfigInfo& config_info)
     : m_device(device)
 {
-    create_graphics_pipeline(vertex_filepath, frag_filepath, config_info);
+    SIM_TRACE_ZONE("Pipeline::Pipeline");
+    create_graphics_pipeline(vertex_code, frag_code, config_info);
 }
 
 Pipeline::~Pipeline()
@@ -21,25 +21,8 @@ Pipeline::~Pipeline()
     vkDestroyPipeline(m_device.device(), m_graphics_pipeline, nullptr);
 }
 
-std::vector<char> Pipeline::read_file(const std::string& filepath)
-{
-    std::ifstream file { filepath, std::ios::ate | std::ios::binary };
-
-    if (!file.is_open())
-        throw std::runtime_error("failed to open file " + filepath);
-
-    size_t file_size = static_cast<size_t>(file.tellg());
-    std::vector<char> buffer(file_size);
-
-    file.seekg(0);
-    file.read(buffer.data(), file_size);
-
-    file.close();
-    return buffer;
-}
-
 void Pipeline::create_graphics_pipeline(
-    const std::string& vertex_filepath, const std::string& frag_filepath, const PipelineConfigInfo& config_info)
+    std::span<const uint32_t> vertex_code, std::span<const uint32_t> frag_code, const PipelineConfigInfo& config_info)
 {
 
     assert(config_info.pipeline_layout != VK_NULL_HANDLE
@@ -48,11 +31,8 @@ void Pipeline::create_graphics_pipeline(
     assert(config_info.render_pass != VK_NULL_HANDLE
         && "Cannot create graphics pipeline no render_pass provided to config_info");
 
-    auto v_code = read_file(vertex_filepath);
-    auto f_code = read_file(frag_filepath);
-
-    create_shader_module(v_code, &m_vert_shader_module);
-    create_shader_module(f_code, &m_frag_shader_module);
+    create_shader_module(vertex_code, &m_vert_shader_module);
+    create_shader_module(frag_code, &m_frag_shader_module);
 
     VkPipelineShaderStageCreateInfo shader_stages[2];
     shader_stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -61,7 +41,7 @@ void Pipeline::create_graphics_pipeline(
     shader_stages[0].pName = "main";
     shader_stages[0].flags = 0;
     shader_stages[0].pNext = 0;
-    shader_stages[0].pSpecializationInfo = nullptr;
+    shader_stages[0].pSpecializationInfo = config_info.specialization.info();
 
     shader_stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
     shader_stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -69,14 +49,23 @@ void Pipeline::create_graphics_pipeline(
     shader_stages[1].pName = "main";
     shader_stages[1].flags = 0;
     shader_stages[1].pNext = 0;
-    shader_stages[1].pSpecializationInfo = nullptr;
+    shader_stages[1].pSpecializationInfo = config_info.specialization.info();
 
     VkPipelineVertexInputStateCreateInfo vertex_input_info {};
     vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    vertex_input_info.vertexAttributeDescriptionCount = 0;
-    vertex_input_info.vertexBindingDescriptionCount = 0;
-    vertex_input_info.pVertexAttributeDescriptions = nullptr;
-    vertex_input_info.pVertexBindingDescriptions = nullptr;
+    vertex_input_info.vertexAttributeDescriptionCount
+        = static_cast<uint32_t>(config_info.attribute_descriptions.size());
+    vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(config_info.binding_descriptions.size());
+    vertex_input_info.pVertexAttributeDescriptions = config_info.attribute_descriptions.data();
+    vertex_input_info.pVertexBindingDescriptions = config_info.binding_descriptions.data();
+
+    // The config is returned by value, so re-point the nested state at this copy's members.
+    VkPipelineViewportStateCreateInfo viewport_info = config_info.viewport_info;
+    viewport_info.pViewports = &config_info.viewport;
+    viewport_info.pScissors = &config_info.scissor;
+
+    VkPipelineColorBlendStateCreateInfo color_blend_info = config_info.color_blend_info;
+    color_blend_info.pAttachments = &config_info.color_blend_attatchment;
 
     VkGraphicsPipelineCreateInfo pipeline_info {};
     pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -84,11 +73,11 @@ void Pipeline::create_graphics_pipeline(
     pipeline_info.pStages = shader_stages;
     pipeline_info.pVertexInputState = &vertex_input_info;
     pipeline_info.pInputAssemblyState = &config_info.input_assembly_info;
-    pipeline_info.pViewportState = &config_info.viewport_info;
+    pipeline_info.pViewportState = &viewport_info;
     pipeline_info.pRasterizationState = &config_info.rasterization_info;
     pipeline_info.pMultisampleState = &config_info.multisample_info;
 
-    pipeline_info.pColorBlendState = &config_info.color_blend_info;
+    pipeline_info.pColorBlendState = &color_blend_info;
     pipeline_info.pDepthStencilState = &config_info.depth_stencil_info;
     pipeline_info.pDynamicState = nullptr;
 
@@ -105,12 +94,17 @@ void Pipeline::create_graphics_pipeline(
     }
 }
 
-void Pipeline::create_shader_module(const std::vector<char>& code, VkShaderModule* shader_module)
+void Pipeline::bind(VkCommandBuffer command_buffer)
+{
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_graphics_pipeline);
+}
+
+void Pipeline::create_shader_module(std::span<const uint32_t> code, VkShaderModule* shader_module)
 {
     VkShaderModuleCreateInfo create_info {};
     create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    create_info.codeSize = code.size();
-    create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    create_info.codeSize = code.size_bytes();
+    create_info.pCode = code.data();
 
     if (vkCreateShaderModule(m_device.device(), &create_info, nullptr, shader_module) != VK_SUCCESS) {
         throw std::runtime_error("error creating shader module");
@@ -135,7 +129,7 @@ PipelineConfigInfo Pipeline::default_pipeline_config_info(uint32_t width, uint32
     config_info.scissor.offset = { 0, 0 };
     config_info.scissor.extent = { width, height };
 
-    config_info.viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    config_info.viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
     config_info.viewport_info.viewportCount = 1;
     config_info.viewport_info.pViewports = &config_info.viewport;
     config_info.viewport_info.scissorCount = 1;
@@ -161,8 +155,9 @@ PipelineConfigInfo Pipeline::default_pipeline_config_info(uint32_t width, uint32
     config_info.multisample_info.alphaToCoverageEnable = VK_FALSE;
     config_info.multisample_info.alphaToOneEnable = VK_FALSE;
 
-    config_info.color_blend_attatchment.blendEnable
+    config_info.color_blend_attatchment.colorWriteMask
         = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    config_info.color_blend_attatchment.blendEnable = VK_FALSE;
     config_info.color_blend_attatchment.srcColorBlendFactor = VK_BLEND_FACTOR_ONE;
     config_info.color_blend_attatchment.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO;
     config_info.color_blend_attatchment.colorBlendOp = VK_BLEND_OP_ADD;
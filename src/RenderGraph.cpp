@@ -0,0 +1,788 @@
+#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+static constexpr VkAccessFlags2 WRITE_ACCESS = VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT
+    | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT
+    | VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+static constexpr VkImageUsageFlags ATTACHMENT_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+    | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+
+void RenderPassBuilder::access(RenderResource resource, VkPipelineStageFlags2 stages, VkAccessFlags2 access,
+    VkImageLayout layout, VkImageUsageFlags usage, bool write)
+{
+    auto& accesses = m_graph.m_passes[m_pass].accesses;
+    m_graph.m_resources[resource].usage |= usage;
+
+    for (auto& existing : accesses) {
+        if (existing.resource == resource) {
+            if (existing.layout != layout) {
+                throw std::runtime_error("render graph pass '" + m_graph.m_passes[m_pass].name
+                    + "' uses '" + m_graph.m_resources[resource].name + "' in two layouts");
+            }
+            existing.stages |= stages;
+            existing.access |= access;
+            existing.write = existing.write || write;
+            return;
+        }
+    }
+    accesses.push_back({ resource, stages, access, layout, write });
+}
+
+void RenderPassBuilder::color_attachment(RenderResource image, VkAttachmentLoadOp load_op, VkClearColorValue clear)
+{
+    VkAccessFlags2 access = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+    if (load_op == VK_ATTACHMENT_LOAD_OP_LOAD) {
+        access |= VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT;
+    }
+    this->access(image, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, access,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, true);
+
+    VkClearValue clear_value {};
+    clear_value.color = clear;
+    m_graph.m_passes[m_pass].color_attachments.push_back({ image, load_op, VK_ATTACHMENT_STORE_OP_STORE, clear_value });
+}
+
+void RenderPassBuilder::depth_attachment(RenderResource image, VkAttachmentLoadOp load_op, float clear_depth)
+{
+    this->access(image, VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+        VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, true);
+
+    VkClearValue clear_value {};
+    clear_value.depthStencil = { clear_depth, 0 };
+    m_graph.m_passes[m_pass].depth_attachment = { image, load_op, VK_ATTACHMENT_STORE_OP_STORE, clear_value };
+}
+
+void RenderPassBuilder::sampled(RenderResource image, VkPipelineStageFlags2 stages)
+{
+    access(image, stages, VK_ACCESS_2_SHADER_READ_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        VK_IMAGE_USAGE_SAMPLED_BIT, false);
+}
+
+void RenderPassBuilder::storage_read(RenderResource resource, VkPipelineStageFlags2 stages)
+{
+    bool image = m_graph.m_resources[resource].is_image;
+    access(resource, stages, VK_ACCESS_2_SHADER_READ_BIT,
+        image ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_USAGE_STORAGE_BIT, false);
+}
+
+void RenderPassBuilder::storage_write(RenderResource resource, VkPipelineStageFlags2 stages)
+{
+    bool image = m_graph.m_resources[resource].is_image;
+    access(resource, stages, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT,
+        image ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_USAGE_STORAGE_BIT, true);
+}
+
+void RenderPassBuilder::transfer_read(RenderResource resource)
+{
+    bool image = m_graph.m_resources[resource].is_image;
+    access(resource, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+        image ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        false);
+}
+
+void RenderPassBuilder::transfer_write(RenderResource resource)
+{
+    bool image = m_graph.m_resources[resource].is_image;
+    access(resource, VK_PIPELINE_STAGE_2_TRANSFER_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        image ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        true);
+}
+
+void RenderPassBuilder::indirect_read(RenderResource buffer)
+{
+    access(buffer, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, 0, false);
+}
+
+void RenderPassBuilder::side_effect() { m_graph.m_passes[m_pass].side_effect = true; }
+
+RenderGraph::RenderGraph(Device& device, uint32_t frame_count)
+    : m_device { device }
+    , m_frame_count { frame_count }
+{
+}
+
+RenderGraph::~RenderGraph() { reset(); }
+
+RenderResource RenderGraph::create_image(const std::string& name, VkFormat format, VkExtent2D extent)
+{
+    Resource resource {
+        .name = name,
+        .is_image = true,
+        .imported = false,
+        .format = format,
+        .extent = extent,
+    };
+    m_resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(m_resources.size() - 1);
+}
+
+RenderResource RenderGraph::import_image(const std::string& name, VkFormat format, VkExtent2D extent,
+    VkImageLayout initial_layout, VkPipelineStageFlags2 initial_stages, VkImageLayout final_layout)
+{
+    Resource resource {
+        .name = name,
+        .is_image = true,
+        .imported = true,
+        .format = format,
+        .extent = extent,
+        .initial_layout = initial_layout,
+        .initial_stages = initial_stages,
+        .final_layout = final_layout,
+    };
+    m_resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(m_resources.size() - 1);
+}
+
+RenderResource RenderGraph::import_buffer(
+    const std::string& name, VkPipelineStageFlags2 initial_stages, VkAccessFlags2 initial_access)
+{
+    Resource resource {
+        .name = name,
+        .is_image = false,
+        .imported = true,
+        .initial_stages = initial_stages,
+        .initial_access = initial_access,
+    };
+    m_resources.push_back(std::move(resource));
+    return static_cast<RenderResource>(m_resources.size() - 1);
+}
+
+uint32_t RenderGraph::add_pass(const std::string& name, const std::function<void(RenderPassBuilder&)>& setup,
+    std::function<void(VkCommandBuffer)> execute)
+{
+    if (m_compiled) {
+        throw std::runtime_error("render graph is already compiled");
+    }
+
+    uint32_t index = static_cast<uint32_t>(m_passes.size());
+    m_passes.push_back({ .name = name, .execute = std::move(execute) });
+
+    RenderPassBuilder builder { *this, index };
+    setup(builder);
+    return index;
+}
+
+void RenderGraph::compile()
+{
+    cull_passes();
+    compute_lifetimes();
+    create_render_passes();
+    create_transients();
+    compute_barriers();
+    m_compiled = true;
+}
+
+void RenderGraph::reset()
+{
+    VkDevice device = m_device.device();
+
+    for (auto& pass : m_passes) {
+        for (auto& [views, framebuffer] : pass.framebuffers) {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        }
+        vkDestroyRenderPass(device, pass.render_pass, nullptr);
+    }
+    for (auto& resource : m_resources) {
+        for (auto view : resource.views) {
+            vkDestroyImageView(device, view, nullptr);
+        }
+        for (auto image : resource.images) {
+            vkDestroyImage(device, image, nullptr);
+        }
+    }
+    for (auto& block : m_blocks) {
+        for (auto memory : block.memory) {
+            vkFreeMemory(device, memory, nullptr);
+        }
+    }
+
+    m_passes.clear();
+    m_resources.clear();
+    m_order.clear();
+    m_batches.clear();
+    m_blocks.clear();
+    m_stats = {};
+    m_compiled = false;
+}
+
+// Whether the access depends on what was in the resource before the pass. Attachments that are cleared or discarded
+// do not, even though the depth test reads them; anything else that is not write-only does.
+bool RenderGraph::reads_previous(const Pass& pass, const Access& access)
+{
+    auto discards = [&](const Attachment& attachment) {
+        return attachment.resource == access.resource && attachment.load_op != VK_ATTACHMENT_LOAD_OP_LOAD;
+    };
+    if (std::any_of(pass.color_attachments.begin(), pass.color_attachments.end(), discards)
+        || discards(pass.depth_attachment)) {
+        return false;
+    }
+    return !access.write || (access.access & ~WRITE_ACCESS) != 0;
+}
+
+// Walk the passes backwards: a pass survives if it has side effects or writes something that is imported or read
+// by a surviving later pass.
+void RenderGraph::cull_passes()
+{
+    std::vector<bool> needed(m_resources.size());
+    for (size_t i = 0; i < m_resources.size(); i++) {
+        needed[i] = m_resources[i].imported;
+    }
+
+    for (size_t p = m_passes.size(); p-- > 0;) {
+        Pass& pass = m_passes[p];
+        pass.live = pass.side_effect;
+        for (const auto& access : pass.accesses) {
+            if (access.write && needed[access.resource]) {
+                pass.live = true;
+            }
+        }
+        if (!pass.live) {
+            m_stats.culled_passes++;
+            continue;
+        }
+
+        for (const auto& access : pass.accesses) {
+            if (reads_previous(pass, access)) {
+                needed[access.resource] = true;
+            } else if (!m_resources[access.resource].imported) {
+                needed[access.resource] = false;
+            }
+        }
+    }
+
+    for (uint32_t p = 0; p < m_passes.size(); p++) {
+        if (m_passes[p].live) {
+            m_order.push_back(p);
+        }
+    }
+    m_stats.live_passes = static_cast<uint32_t>(m_order.size());
+}
+
+void RenderGraph::compute_lifetimes()
+{
+    for (uint32_t i = 0; i < m_order.size(); i++) {
+        for (const auto& access : m_passes[m_order[i]].accesses) {
+            Resource& resource = m_resources[access.resource];
+            if (resource.first_use == NONE) {
+                resource.first_use = i;
+            }
+            resource.last_use = i;
+            resource.last_stages = access.stages;
+            resource.last_access = access.access & WRITE_ACCESS;
+        }
+    }
+}
+
+void RenderGraph::create_render_passes()
+{
+    // An attachment is stored only if it is imported or a later live pass reads it before overwriting it.
+    auto store_op = [&](uint32_t position, RenderResource resource) {
+        if (m_resources[resource].imported) {
+            return VK_ATTACHMENT_STORE_OP_STORE;
+        }
+        for (uint32_t i = position + 1; i < m_order.size(); i++) {
+            for (const auto& access : m_passes[m_order[i]].accesses) {
+                if (access.resource == resource) {
+                    bool reads = reads_previous(m_passes[m_order[i]], access);
+                    return reads ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+                }
+            }
+        }
+        return VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    };
+
+    for (uint32_t i = 0; i < m_order.size(); i++) {
+        Pass& pass = m_passes[m_order[i]];
+        if (pass.color_attachments.empty() && pass.depth_attachment.resource == NONE) {
+            continue;
+        }
+
+        std::vector<VkAttachmentDescription> descriptions;
+        std::vector<VkAttachmentReference> color_refs;
+        VkAttachmentReference depth_ref {};
+
+        auto describe = [&](Attachment& attachment, VkImageLayout layout) {
+            const Resource& resource = m_resources[attachment.resource];
+            if (descriptions.empty()) {
+                pass.extent = resource.extent;
+            } else if (resource.extent.width != pass.extent.width || resource.extent.height != pass.extent.height) {
+                throw std::runtime_error("render graph pass '" + pass.name + "' has attachments of different sizes");
+            }
+
+            attachment.store_op = store_op(i, attachment.resource);
+            descriptions.push_back({
+                .format = resource.format,
+                .samples = VK_SAMPLE_COUNT_1_BIT,
+                .loadOp = attachment.load_op,
+                .storeOp = attachment.store_op,
+                .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+                // Layout transitions are done by the graph's own barriers, never by the render pass.
+                .initialLayout = layout,
+                .finalLayout = layout,
+            });
+            pass.clear_values.push_back(attachment.clear);
+            return VkAttachmentReference { static_cast<uint32_t>(descriptions.size() - 1), layout };
+        };
+
+        for (auto& attachment : pass.color_attachments) {
+            color_refs.push_back(describe(attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+        }
+        if (pass.depth_attachment.resource != NONE) {
+            depth_ref = describe(pass.depth_attachment, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        }
+
+        VkSubpassDescription subpass = {
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .colorAttachmentCount = static_cast<uint32_t>(color_refs.size()),
+            .pColorAttachments = color_refs.data(),
+            .pDepthStencilAttachment = pass.depth_attachment.resource != NONE ? &depth_ref : nullptr,
+        };
+        VkRenderPassCreateInfo render_pass_info = {
+            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+            .attachmentCount = static_cast<uint32_t>(descriptions.size()),
+            .pAttachments = descriptions.data(),
+            .subpassCount = 1,
+            .pSubpasses = &subpass,
+        };
+        if (vkCreateRenderPass(m_device.device(), &render_pass_info, nullptr, &pass.render_pass) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create render pass for '" + pass.name + "'");
+        }
+    }
+}
+
+void RenderGraph::create_transients()
+{
+    VkDevice device = m_device.device();
+    std::vector<RenderResource> transients;
+
+    for (RenderResource r = 0; r < m_resources.size(); r++) {
+        Resource& resource = m_resources[r];
+        if (resource.imported || resource.first_use == NONE) {
+            continue;
+        }
+        transients.push_back(r);
+
+        VkImageUsageFlags usage = resource.usage;
+        if ((usage & ~ATTACHMENT_USAGE) == 0) {
+            usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+        }
+        VkImageCreateInfo image_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = resource.format,
+            .extent = { resource.extent.width, resource.extent.height, 1 },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        resource.usage = usage;
+        resource.images.resize(m_frame_count);
+        for (auto& image : resource.images) {
+            if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create transient image '" + resource.name + "'");
+            }
+        }
+        vkGetImageMemoryRequirements(device, resource.images[0], &resource.requirements);
+        m_stats.unaliased_bytes += resource.requirements.size;
+    }
+
+    // Largest first, each into the first block of the same memory type none of whose residents is alive at the
+    // same time. Every resident starts at offset 0, so the block is as large as its largest resident.
+    std::sort(transients.begin(), transients.end(), [&](RenderResource a, RenderResource b) {
+        return m_resources[a].requirements.size > m_resources[b].requirements.size;
+    });
+
+    for (RenderResource r : transients) {
+        Resource& resource = m_resources[r];
+
+        uint32_t memory_type;
+        if (resource.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+            try {
+                memory_type = m_device.find_memory_type(
+                    resource.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+            } catch (const std::runtime_error&) {
+                memory_type = m_device.find_memory_type(
+                    resource.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            }
+        } else {
+            memory_type = m_device.find_memory_type(
+                resource.requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        }
+
+        for (uint32_t b = 0; b < m_blocks.size() && resource.block == NONE; b++) {
+            MemoryBlock& block = m_blocks[b];
+            if (block.memory_type != memory_type) {
+                continue;
+            }
+            bool overlaps = std::any_of(block.residents.begin(), block.residents.end(), [&](RenderResource other) {
+                const Resource& o = m_resources[other];
+                return !(o.last_use < resource.first_use || resource.last_use < o.first_use);
+            });
+            if (!overlaps) {
+                resource.block = b;
+            }
+        }
+        if (resource.block == NONE) {
+            resource.block = static_cast<uint32_t>(m_blocks.size());
+            m_blocks.push_back({ .memory_type = memory_type, .size = 0 });
+        }
+
+        MemoryBlock& block = m_blocks[resource.block];
+        block.size = std::max(block.size, resource.requirements.size);
+        block.residents.push_back(r);
+    }
+
+    for (auto& block : m_blocks) {
+        m_stats.transient_bytes += block.size;
+        block.memory.resize(m_frame_count);
+        for (auto& memory : block.memory) {
+            VkMemoryAllocateInfo alloc_info = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+                .allocationSize = block.size,
+                .memoryTypeIndex = block.memory_type,
+            };
+            if (vkAllocateMemory(device, &alloc_info, nullptr, &memory) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate render graph memory");
+            }
+        }
+    }
+
+    for (RenderResource r : transients) {
+        Resource& resource = m_resources[r];
+        resource.views.resize(m_frame_count);
+        for (uint32_t frame = 0; frame < m_frame_count; frame++) {
+            if (vkBindImageMemory(device, resource.images[frame], m_blocks[resource.block].memory[frame], 0)
+                != VK_SUCCESS) {
+                throw std::runtime_error("failed to bind transient image '" + resource.name + "'");
+            }
+
+            VkImageViewCreateInfo view_info = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .image = resource.images[frame],
+                .viewType = VK_IMAGE_VIEW_TYPE_2D,
+                .format = resource.format,
+                // Views of depth/stencil images are depth only so they can also be sampled.
+                .subresourceRange = { aspect(resource) & ~VK_IMAGE_ASPECT_STENCIL_BIT, 0, 1, 0, 1 },
+            };
+            if (view_info.subresourceRange.aspectMask == 0) {
+                view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
+            }
+            if (vkCreateImageView(device, &view_info, nullptr, &resource.views[frame]) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create transient image view '" + resource.name + "'");
+            }
+        }
+    }
+}
+
+// Track every resource's state through the live passes and emit a barrier wherever an access needs its layout
+// changed or has to wait for an earlier one. Each barrier may be recorded anywhere between the previous access to
+// its resource and the pass that needs it, which batch_barriers() exploits.
+void RenderGraph::compute_barriers()
+{
+    struct State {
+        VkImageLayout layout;
+        VkPipelineStageFlags2 write_stages;
+        VkAccessFlags2 write_access;
+        VkPipelineStageFlags2 synced_stages; // stages that already see the last write
+        uint32_t last_position;
+    };
+
+    std::vector<State> states(m_resources.size());
+    for (RenderResource r = 0; r < m_resources.size(); r++) {
+        const Resource& resource = m_resources[r];
+        State& state = states[r];
+        state = { resource.initial_layout, resource.initial_stages, resource.initial_access, 0, NONE };
+
+        // A transient's memory may have been used by an earlier resident of its block in this frame.
+        if (!resource.imported && resource.block != NONE) {
+            state.write_stages = VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT;
+            uint32_t latest = NONE;
+            for (RenderResource other : m_blocks[resource.block].residents) {
+                const Resource& o = m_resources[other];
+                if (o.last_use < resource.first_use && (latest == NONE || o.last_use > latest)) {
+                    latest = o.last_use;
+                    state.last_position = o.last_use;
+                    state.write_stages = o.last_stages;
+                    state.write_access = o.last_access;
+                }
+            }
+        }
+    }
+
+    std::vector<Barrier> barriers;
+    auto emit = [&](RenderResource r, State& state, VkPipelineStageFlags2 src_stages, VkAccessFlags2 src_access,
+                    VkPipelineStageFlags2 dst_stages, VkAccessFlags2 dst_access, VkImageLayout new_layout,
+                    uint32_t deadline) {
+        barriers.push_back({
+            .resource = r,
+            .src_stages = src_stages,
+            .src_access = src_access,
+            .dst_stages = dst_stages,
+            .dst_access = dst_access,
+            .old_layout = state.layout,
+            .new_layout = new_layout,
+            .earliest = state.last_position == NONE ? 0 : state.last_position + 1,
+            .deadline = deadline,
+        });
+    };
+
+    for (uint32_t i = 0; i < m_order.size(); i++) {
+        for (const auto& access : m_passes[m_order[i]].accesses) {
+            const Resource& resource = m_resources[access.resource];
+            State& state = states[access.resource];
+            bool layout_change = resource.is_image && access.layout != state.layout;
+
+            if (access.write) {
+                // Write after read only has to wait for the readers; write after write also flushes the old write.
+                if (state.synced_stages) {
+                    emit(access.resource, state, state.synced_stages, 0, access.stages, access.access, access.layout,
+                        i);
+                } else if (state.write_stages || layout_change) {
+                    emit(access.resource, state, state.write_stages, state.write_access, access.stages,
+                        access.access, access.layout, i);
+                }
+                state.write_stages = access.stages;
+                state.write_access = access.access & WRITE_ACCESS;
+                state.synced_stages = 0;
+            } else if (layout_change) {
+                emit(access.resource, state, state.write_stages | state.synced_stages, state.write_access,
+                    access.stages, access.access, access.layout, i);
+                state.synced_stages = access.stages;
+            } else {
+                if (state.write_stages && (access.stages & ~state.synced_stages)) {
+                    emit(access.resource, state, state.write_stages, state.write_access, access.stages,
+                        access.access, access.layout, i);
+                }
+                state.synced_stages |= access.stages;
+            }
+
+            if (resource.is_image) {
+                state.layout = access.layout;
+            }
+            state.last_position = i;
+        }
+    }
+
+    uint32_t end = static_cast<uint32_t>(m_order.size());
+    for (RenderResource r = 0; r < m_resources.size(); r++) {
+        const Resource& resource = m_resources[r];
+        State& state = states[r];
+        if (resource.is_image && resource.imported && resource.final_layout != VK_IMAGE_LAYOUT_UNDEFINED
+            && resource.final_layout != state.layout) {
+            emit(r, state, state.write_stages | state.synced_stages, state.write_access,
+                VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, resource.final_layout, end);
+        }
+    }
+
+    m_stats.barriers = static_cast<uint32_t>(barriers.size());
+    batch_barriers(barriers);
+    m_stats.barrier_batches = static_cast<uint32_t>(m_batches.size());
+}
+
+// Every barrier is an interval [earliest, deadline] of positions it may be recorded at. Sweeping forward and only
+// flushing when some pending barrier reaches its deadline, taking everything placeable along, gives the fewest
+// vkCmdPipelineBarrier2 calls that satisfy all intervals. Each barrier keeps its own stage masks, so merging never
+// widens a dependency.
+void RenderGraph::batch_barriers(std::vector<Barrier>& barriers)
+{
+    std::sort(barriers.begin(), barriers.end(),
+        [](const Barrier& a, const Barrier& b) { return a.earliest < b.earliest; });
+
+    std::vector<Barrier> pending;
+    size_t next = 0;
+    for (uint32_t position = 0; position <= m_order.size(); position++) {
+        while (next < barriers.size() && barriers[next].earliest == position) {
+            pending.push_back(barriers[next++]);
+        }
+
+        bool due = std::any_of(
+            pending.begin(), pending.end(), [&](const Barrier& barrier) { return barrier.deadline == position; });
+        if (!due) {
+            continue;
+        }
+
+        m_batches.push_back({ .position = position, .barriers = std::move(pending) });
+        pending.clear();
+    }
+}
+
+void RenderGraph::record_batch(VkCommandBuffer command_buffer, const BarrierBatch& batch)
+{
+    std::vector<VkImageMemoryBarrier2> image_barriers;
+    std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+
+    for (const auto& barrier : batch.barriers) {
+        const Resource& resource = m_resources[barrier.resource];
+        if (resource.is_image) {
+            image_barriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+                .srcStageMask = barrier.src_stages,
+                .srcAccessMask = barrier.src_access,
+                .dstStageMask = barrier.dst_stages,
+                .dstAccessMask = barrier.dst_access,
+                .oldLayout = barrier.old_layout,
+                .newLayout = barrier.new_layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image(barrier.resource),
+                .subresourceRange = { aspect(resource), 0, 1, 0, 1 },
+            });
+        } else {
+            buffer_barriers.push_back({
+                .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+                .srcStageMask = barrier.src_stages,
+                .srcAccessMask = barrier.src_access,
+                .dstStageMask = barrier.dst_stages,
+                .dstAccessMask = barrier.dst_access,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .buffer = buffer(barrier.resource),
+                .offset = 0,
+                .size = VK_WHOLE_SIZE,
+            });
+        }
+    }
+
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .bufferMemoryBarrierCount = static_cast<uint32_t>(buffer_barriers.size()),
+        .pBufferMemoryBarriers = buffer_barriers.data(),
+        .imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size()),
+        .pImageMemoryBarriers = image_barriers.data(),
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+}
+
+VkFramebuffer RenderGraph::framebuffer(Pass& pass)
+{
+    std::vector<VkImageView> views;
+    for (const auto& attachment : pass.color_attachments) {
+        views.push_back(image_view(attachment.resource));
+    }
+    if (pass.depth_attachment.resource != NONE) {
+        views.push_back(image_view(pass.depth_attachment.resource));
+    }
+
+    auto found = pass.framebuffers.find(views);
+    if (found != pass.framebuffers.end()) {
+        return found->second;
+    }
+
+    VkFramebufferCreateInfo framebuffer_info = {
+        .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+        .renderPass = pass.render_pass,
+        .attachmentCount = static_cast<uint32_t>(views.size()),
+        .pAttachments = views.data(),
+        .width = pass.extent.width,
+        .height = pass.extent.height,
+        .layers = 1,
+    };
+    VkFramebuffer framebuffer;
+    if (vkCreateFramebuffer(m_device.device(), &framebuffer_info, nullptr, &framebuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create framebuffer for '" + pass.name + "'");
+    }
+    pass.framebuffers.emplace(std::move(views), framebuffer);
+    return framebuffer;
+}
+
+VkImageAspectFlags RenderGraph::aspect(const Resource& resource)
+{
+    switch (resource.format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+        return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    case VK_FORMAT_S8_UINT:
+        return VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+        return VK_IMAGE_ASPECT_COLOR_BIT;
+    }
+}
+
+void RenderGraph::bind_image(RenderResource image, VkImage handle, VkImageView view)
+{
+    if (!m_resources[image].imported) {
+        throw std::runtime_error("only imported images can be bound");
+    }
+    m_resources[image].bound_image = handle;
+    m_resources[image].bound_view = view;
+}
+
+void RenderGraph::bind_buffer(RenderResource buffer, VkBuffer handle)
+{
+    if (!m_resources[buffer].imported) {
+        throw std::runtime_error("only imported buffers can be bound");
+    }
+    m_resources[buffer].bound_buffer = handle;
+}
+
+VkImage RenderGraph::image(RenderResource image)
+{
+    const Resource& resource = m_resources[image];
+    return resource.imported ? resource.bound_image : resource.images[m_frame_index];
+}
+
+VkImageView RenderGraph::image_view(RenderResource image)
+{
+    const Resource& resource = m_resources[image];
+    return resource.imported ? resource.bound_view : resource.views[m_frame_index];
+}
+
+VkBuffer RenderGraph::buffer(RenderResource buffer) { return m_resources[buffer].bound_buffer; }
+
+void RenderGraph::execute(VkCommandBuffer command_buffer, uint32_t frame_index)
+{
+    if (!m_compiled) {
+        throw std::runtime_error("render graph executed before compile()");
+    }
+    m_frame_index = frame_index;
+
+    size_t next_batch = 0;
+    for (uint32_t position = 0; position < m_order.size(); position++) {
+        while (next_batch < m_batches.size() && m_batches[next_batch].position == position) {
+            record_batch(command_buffer, m_batches[next_batch++]);
+        }
+
+        Pass& pass = m_passes[m_order[position]];
+        if (pass.render_pass != VK_NULL_HANDLE) {
+            VkRenderPassBeginInfo begin_info = {
+                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                .renderPass = pass.render_pass,
+                .framebuffer = framebuffer(pass),
+                .renderArea = { { 0, 0 }, pass.extent },
+                .clearValueCount = static_cast<uint32_t>(pass.clear_values.size()),
+                .pClearValues = pass.clear_values.data(),
+            };
+            vkCmdBeginRenderPass(command_buffer, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+            if (pass.execute) {
+                pass.execute(command_buffer);
+            }
+            vkCmdEndRenderPass(command_buffer);
+        } else if (pass.execute) {
+            pass.execute(command_buffer);
+        }
+    }
+
+    while (next_batch < m_batches.size()) {
+        record_batch(command_buffer, m_batches[next_batch++]);
+    }
+}
+
+} // namespace Simulation
@@ -0,0 +1,389 @@
+#include "ScenarioBatch.hpp"
+#include "Debug.hpp"
+#include "Shaders.hpp"
+#include "TimelineSemaphore.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+std::vector<Scenario> ScenarioBatch::load(const std::string& path)
+{
+    std::ifstream file { path };
+    if (!file) {
+        throw std::runtime_error("failed to open scenario list " + path);
+    }
+
+    std::vector<Scenario> scenarios;
+    std::string line;
+    for (uint32_t line_number = 1; std::getline(file, line); line_number++) {
+        std::istringstream fields { line };
+        std::string name;
+        if (!(fields >> name) || name[0] == '#') {
+            continue;
+        }
+        Scenario scenario { .name = name };
+        if (!(fields >> scenario.particle_count >> scenario.steps >> scenario.dt >> scenario.strength
+                >> scenario.seed)
+            || scenario.particle_count == 0) {
+            throw std::runtime_error(path + ":" + std::to_string(line_number) + ": invalid scenario");
+        }
+        scenarios.push_back(scenario);
+    }
+    return scenarios;
+}
+
+ScenarioBatch::ScenarioBatch(Device& device, std::vector<Scenario> scenarios)
+    : m_device { device }
+    , m_scenarios { std::move(scenarios) }
+{
+    const VkPhysicalDeviceLimits& limits = m_device.properties.limits;
+    if (m_scenarios.empty() || m_scenarios.size() > limits.maxComputeWorkGroupCount[1]) {
+        throw std::runtime_error("scenario count exceeds what one dispatch can cover");
+    }
+    for (const Scenario& scenario : m_scenarios) {
+        m_first.push_back(m_total_count);
+        m_total_count += scenario.particle_count;
+        m_max_count = std::max(m_max_count, scenario.particle_count);
+        m_max_steps = std::max(m_max_steps, scenario.steps);
+    }
+    if (ComputePipeline::group_count(m_max_count, m_group_size) > limits.maxComputeWorkGroupCount[0]) {
+        throw std::runtime_error("scenario has too many particles for one dispatch");
+    }
+
+    create_buffers();
+    create_descriptors();
+    create_command_buffers();
+    SpecializationConstants specialization;
+    specialization.set(GROUP_SIZE_ID, m_group_size);
+    m_pipeline = std::make_unique<ComputePipeline>(
+        m_device, Shaders::scenario_batch_comp, m_pipeline_layout, specialization);
+    upload_initial_state();
+}
+
+ScenarioBatch::~ScenarioBatch()
+{
+    VkDevice device = m_device.device();
+    m_device.compute_timeline().wait(m_device.compute_timeline().last_reserved());
+
+    m_pipeline.reset();
+    vkDestroyCommandPool(device, m_command_pool, nullptr);
+    vkDestroyPipelineLayout(device, m_pipeline_layout, nullptr);
+    vkDestroyDescriptorPool(device, m_descriptor_pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, m_set_layout, nullptr);
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        vkDestroyBuffer(device, m_state_buffers[slot], nullptr);
+        vkFreeMemory(device, m_state_memory[slot], nullptr);
+    }
+    vkDestroyBuffer(device, m_scenario_buffer, nullptr);
+    vkFreeMemory(device, m_scenario_memory, nullptr);
+    vkDestroyBuffer(device, m_readback_buffer, nullptr);
+    vkFreeMemory(device, m_readback_memory, nullptr);
+}
+
+void ScenarioBatch::create_buffers()
+{
+    VkDeviceSize state_size = sizeof(Particle) * m_total_count;
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        m_device.create_buffer(state_size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_state_buffers[slot], m_state_memory[slot]);
+    }
+    m_device.create_buffer(sizeof(GpuScenario) * m_scenarios.size(),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        m_scenario_buffer, m_scenario_memory);
+    m_device.create_buffer(state_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_readback_buffer,
+        m_readback_memory);
+}
+
+void ScenarioBatch::create_descriptors()
+{
+    std::array<VkDescriptorSetLayoutBinding, 3> bindings = { {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+    } };
+    VkDescriptorSetLayoutCreateInfo layout_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = static_cast<uint32_t>(bindings.size()),
+        .pBindings = bindings.data(),
+    };
+    if (vkCreateDescriptorSetLayout(m_device.device(), &layout_info, nullptr, &m_set_layout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create scenario batch descriptor set layout");
+    }
+
+    VkPushConstantRange push_range = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(uint32_t),
+    };
+    VkPipelineLayoutCreateInfo pipeline_layout_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_set_layout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push_range,
+    };
+    if (vkCreatePipelineLayout(m_device.device(), &pipeline_layout_info, nullptr, &m_pipeline_layout)
+        != VK_SUCCESS) {
+        throw std::runtime_error("failed to create scenario batch pipeline layout");
+    }
+
+    VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * 2 };
+    VkDescriptorPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = 2,
+        .poolSizeCount = 1,
+        .pPoolSizes = &pool_size,
+    };
+    if (vkCreateDescriptorPool(m_device.device(), &pool_info, nullptr, &m_descriptor_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create scenario batch descriptor pool");
+    }
+
+    std::array<VkDescriptorSetLayout, 2> layouts = { m_set_layout, m_set_layout };
+    VkDescriptorSetAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_descriptor_pool,
+        .descriptorSetCount = 2,
+        .pSetLayouts = layouts.data(),
+    };
+    if (vkAllocateDescriptorSets(m_device.device(), &alloc_info, m_sets) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate scenario batch descriptor sets");
+    }
+
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        std::array<VkDescriptorBufferInfo, 3> infos = { {
+            { m_state_buffers[slot], 0, VK_WHOLE_SIZE },
+            { m_state_buffers[1 - slot], 0, VK_WHOLE_SIZE },
+            { m_scenario_buffer, 0, VK_WHOLE_SIZE },
+        } };
+        std::array<VkWriteDescriptorSet, 3> writes;
+        for (uint32_t binding = 0; binding < 3; binding++) {
+            writes[binding] = {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = m_sets[slot],
+                .dstBinding = binding,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &infos[binding],
+            };
+        }
+        vkUpdateDescriptorSets(
+            m_device.device(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    }
+}
+
+void ScenarioBatch::create_command_buffers()
+{
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_device.compute_family(),
+    };
+    if (vkCreateCommandPool(m_device.device(), &pool_info, nullptr, &m_command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create scenario batch command pool");
+    }
+
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 2,
+    };
+    if (vkAllocateCommandBuffers(m_device.device(), &alloc_info, m_command_buffers) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate scenario batch command buffers");
+    }
+}
+
+void ScenarioBatch::upload_initial_state()
+{
+    VkDeviceSize state_size = sizeof(Particle) * m_total_count;
+    VkDeviceSize table_size = sizeof(GpuScenario) * m_scenarios.size();
+    VkBuffer staging;
+    VkDeviceMemory staging_memory;
+    m_device.create_buffer(state_size + table_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging, staging_memory);
+    void* mapped;
+    vkMapMemory(m_device.device(), staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    auto* particles = static_cast<Particle*>(mapped);
+    auto* table = reinterpret_cast<GpuScenario*>(static_cast<char*>(mapped) + state_size);
+    for (size_t i = 0; i < m_scenarios.size(); i++) {
+        const Scenario& scenario = m_scenarios[i];
+        std::vector<Particle> disc
+            = ParticleSimulation::make_disc(scenario.particle_count, scenario.strength, scenario.seed);
+        std::memcpy(particles + m_first[i], disc.data(), sizeof(Particle) * disc.size());
+        table[i] = {
+            .attractor = glm::vec4(0.0f, 0.0f, 0.0f, scenario.strength),
+            .dt = scenario.dt,
+            .steps = scenario.steps,
+            .first = m_first[i],
+            .count = scenario.particle_count,
+        };
+    }
+    vkUnmapMemory(m_device.device(), staging_memory);
+
+    VkCommandBuffer command_buffer = m_command_buffers[0];
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    VkBufferCopy state_region = { .srcOffset = 0, .dstOffset = 0, .size = state_size };
+    vkCmdCopyBuffer(command_buffer, staging, m_state_buffers[0], 1, &state_region);
+    VkBufferCopy table_region = { .srcOffset = state_size, .dstOffset = 0, .size = table_size };
+    vkCmdCopyBuffer(command_buffer, staging, m_scenario_buffer, 1, &table_region);
+    vkEndCommandBuffer(command_buffer);
+
+    m_device.compute_timeline().wait(m_device.submit_compute({ command_buffer }));
+    vkResetCommandBuffer(command_buffer, 0);
+    vkDestroyBuffer(m_device.device(), staging, nullptr);
+    vkFreeMemory(m_device.device(), staging_memory, nullptr);
+}
+
+void ScenarioBatch::record_chunk(VkCommandBuffer command_buffer, uint32_t first_tick, uint32_t tick_count)
+{
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    m_pipeline->bind(command_buffer);
+
+    uint32_t group_count = ComputePipeline::group_count(m_max_count, m_group_size);
+    for (uint32_t tick = first_tick; tick < first_tick + tick_count; tick++) {
+        // The previous tick, in this chunk or the last, or the upload wrote what this one reads and read what it
+        // overwrites.
+        VkMemoryBarrier2 barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_COPY_BIT,
+            .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        };
+        VkDependencyInfo dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+            .memoryBarrierCount = 1,
+            .pMemoryBarriers = &barrier,
+        };
+        vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1,
+            &m_sets[tick % 2], 0, nullptr);
+        vkCmdPushConstants(
+            command_buffer, m_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &tick);
+        vkCmdDispatch(command_buffer, group_count, static_cast<uint32_t>(m_scenarios.size()), 1);
+    }
+    vkEndCommandBuffer(command_buffer);
+}
+
+void ScenarioBatch::run()
+{
+    SIM_TRACE_ZONE("ScenarioBatch::run");
+    if (m_finished) {
+        return;
+    }
+
+    uint32_t chunk = 0;
+    for (uint32_t tick = 0; tick < m_max_steps; tick += TICKS_PER_CHUNK, chunk++) {
+        // Wait for the chunk that last used this command buffer; the other one keeps the queue busy meanwhile.
+        uint32_t slot = chunk % 2;
+        m_device.compute_timeline().wait(m_chunk_values[slot]);
+        vkResetCommandBuffer(m_command_buffers[slot], 0);
+        record_chunk(m_command_buffers[slot], tick, std::min(TICKS_PER_CHUNK, m_max_steps - tick));
+        m_chunk_values[slot] = m_device.submit_compute({ m_command_buffers[slot] });
+    }
+
+    read_back();
+    m_finished = true;
+}
+
+// Finished scenarios are copied through every tick, so the buffer written last holds all results.
+void ScenarioBatch::read_back()
+{
+    VkCommandBuffer command_buffer = m_command_buffers[0];
+    m_device.compute_timeline().wait(m_chunk_values[0]);
+    vkResetCommandBuffer(command_buffer, 0);
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(command_buffer, &begin_info);
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+
+    VkBufferCopy region = { .srcOffset = 0, .dstOffset = 0, .size = sizeof(Particle) * m_total_count };
+    vkCmdCopyBuffer(command_buffer, m_state_buffers[m_max_steps % 2], m_readback_buffer, 1, &region);
+
+    barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier2(command_buffer, &dependency);
+    vkEndCommandBuffer(command_buffer);
+
+    m_chunk_values[0] = m_device.submit_compute({ command_buffer });
+    m_device.compute_timeline().wait(m_chunk_values[0]);
+}
+
+void ScenarioBatch::write_results(const std::string& directory)
+{
+    if (!m_finished) {
+        throw std::runtime_error("scenario batch has not been run");
+    }
+
+    void* mapped;
+    vkMapMemory(m_device.device(), m_readback_memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+    const auto* particles = static_cast<const Particle*>(mapped);
+    for (size_t i = 0; i < m_scenarios.size(); i++) {
+        const Scenario& scenario = m_scenarios[i];
+        std::string path = directory + "/" + scenario.name + ".particles";
+        std::ofstream file { path, std::ios::binary };
+        if (!file) {
+            vkUnmapMemory(m_device.device(), m_readback_memory);
+            throw std::runtime_error("failed to open " + path);
+        }
+        ScenarioResultHeader header = {
+            .magic = ScenarioResultHeader::MAGIC,
+            .version = ScenarioResultHeader::VERSION,
+            .particle_count = scenario.particle_count,
+            .steps = scenario.steps,
+            .dt = scenario.dt,
+            .strength = scenario.strength,
+            .seed = scenario.seed,
+            .padding = 0,
+        };
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(particles + m_first[i]), sizeof(Particle) * scenario.particle_count);
+        // A full disk otherwise leaves a truncated file behind that looks like a result.
+        file.close();
+        if (!file) {
+            vkUnmapMemory(m_device.device(), m_readback_memory);
+            throw std::runtime_error("failed to write " + path);
+        }
+    }
+    vkUnmapMemory(m_device.device(), m_readback_memory);
+}
+
+} // namespace Simulation
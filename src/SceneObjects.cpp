@@ -0,0 +1,115 @@
+#include "SceneObjects.hpp"
+#include "Debug.hpp"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <random>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+// The strength of ParticleSimulation's attractor, so objects orbit like the particles at the same radius.
+static constexpr float ATTRACTOR_STRENGTH = 0.05f;
+static constexpr float MIN_ORBIT = 0.2f;
+static constexpr float MAX_ORBIT = 4.0f;
+
+SceneObjects::SceneObjects(Device& device, ThreadPool& pool, uint32_t count, uint32_t frames_in_flight)
+    : m_device { device }
+    , m_pool { pool }
+    , m_count { count }
+{
+    std::mt19937 random { 4321 };
+    std::uniform_real_distribution<float> unit { 0.0f, 1.0f };
+    m_orbits.resize(m_count);
+    m_instances.resize(m_count);
+    float min_sq = MIN_ORBIT * MIN_ORBIT;
+    for (uint32_t i = 0; i < m_count; i++) {
+        // Uniform over the annulus, so the density on screen is the same everywhere.
+        float radius = std::sqrt(min_sq + (MAX_ORBIT * MAX_ORBIT - min_sq) * unit(random));
+        m_orbits[i] = {
+            .radius = radius,
+            .angle = 6.2831853f * unit(random),
+            .angular_speed = std::sqrt(ATTRACTOR_STRENGTH / (radius * radius * radius)),
+            .height = 0.1f * (unit(random) - 0.5f),
+        };
+        m_instances[i] = { .bounding_sphere = glm::vec4(0.01f + 0.03f * unit(random)), .draw = 0 };
+    }
+
+    m_boxes.resize(m_count);
+    place(0, m_count);
+    m_bvh.build(m_boxes);
+
+    // Also the staging source when GpuCulling culls them.
+    m_device.create_buffer(sizeof(GpuInstance) * m_count * frames_in_flight,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_instance_buffer,
+        m_instance_memory);
+    void* mapped;
+    if (vkMapMemory(m_device.device(), m_instance_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map object instance buffer");
+    }
+    m_instance_mapped = static_cast<char*>(mapped);
+}
+
+SceneObjects::~SceneObjects()
+{
+    vkDestroyBuffer(m_device.device(), m_instance_buffer, nullptr);
+    vkFreeMemory(m_device.device(), m_instance_memory, nullptr);
+}
+
+void SceneObjects::place(uint32_t begin, uint32_t end)
+{
+    for (uint32_t i = begin; i < end; i++) {
+        const Orbit& orbit = m_orbits[i];
+        glm::vec3 center { orbit.radius * std::cos(orbit.angle), orbit.radius * std::sin(orbit.angle), orbit.height };
+        float radius = m_instances[i].bounding_sphere.w;
+        glm::vec3 half { radius };
+        m_instances[i].bounding_sphere = glm::vec4(center, radius);
+        m_boxes.set(i, center - half, center + half);
+    }
+}
+
+void SceneObjects::step(float dt)
+{
+    SIM_TRACE_ZONE("SceneObjects::step");
+    m_pool.parallel_for(m_count, 4096, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            m_orbits[i].angle = std::fmod(m_orbits[i].angle + m_orbits[i].angular_speed * dt, 6.2831853f);
+        }
+        place(begin, end);
+    });
+
+    m_bvh.refit(m_boxes);
+    if (m_bvh.needs_rebuild()) {
+        m_bvh.build(m_boxes);
+    }
+}
+
+uint32_t SceneObjects::cull(const glm::mat4& view_projection, uint32_t frame_index)
+{
+    SIM_TRACE_ZONE("SceneObjects::cull");
+    return m_bvh.cull(Frustum::from_matrix(view_projection), m_pool, m_instance_mapped + instance_offset(frame_index),
+        m_count, m_instances.data(), sizeof(GpuInstance));
+}
+
+void SceneObjects::write_instances(uint32_t frame_index)
+{
+    std::memcpy(m_instance_mapped + instance_offset(frame_index), m_instances.data(), sizeof(GpuInstance) * m_count);
+}
+
+VkVertexInputBindingDescription SceneObjects::binding_description()
+{
+    return { .binding = 1, .stride = sizeof(GpuInstance), .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE };
+}
+
+VkVertexInputAttributeDescription SceneObjects::attribute_description()
+{
+    return { .location = 2,
+        .binding = 1,
+        .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .offset = offsetof(GpuInstance, bounding_sphere) };
+}
+
+} // namespace Simulation
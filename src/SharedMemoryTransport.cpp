@@ -0,0 +1,204 @@
+#include "SharedMemoryTransport.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Simulation {
+
+static constexpr auto ATTACH_TIMEOUT = std::chrono::seconds(60);
+
+// Spin briefly, then yield, then sleep, so an idle ring costs little CPU but a busy one has low latency.
+static void backoff(uint32_t& attempts)
+{
+    attempts++;
+    if (attempts < 64) {
+        return;
+    }
+    if (attempts < 1024) {
+        std::this_thread::yield();
+    } else {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+std::string SharedMemoryTransport::ring_name(const std::string& session, uint32_t from, uint32_t to)
+{
+    return "/" + session + "-" + std::to_string(from) + "-" + std::to_string(to);
+}
+
+SharedMemoryTransport::SharedMemoryTransport(const Transport::Options& options)
+    : Transport { options.rank, options.ranks }
+    , m_incoming(options.ranks)
+    , m_outgoing(options.ranks)
+{
+    for (uint32_t peer = 0; peer < ranks(); peer++) {
+        if (peer == rank()) {
+            continue;
+        }
+        std::string name = ring_name(options.session, peer, rank());
+        shm_unlink(name.c_str());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(mapping_size())) != 0) {
+            throw std::runtime_error("failed to create " + name + ": " + std::strerror(errno));
+        }
+        void* mapped = mmap(nullptr, mapping_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("failed to map " + name);
+        }
+        Ring& ring = m_incoming[peer];
+        ring.header = new (mapped) RingHeader {};
+        ring.data = static_cast<char*>(mapped) + sizeof(RingHeader);
+        ring.header->ready.store(1, std::memory_order_release);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + ATTACH_TIMEOUT;
+    for (uint32_t peer = 0; peer < ranks(); peer++) {
+        if (peer == rank()) {
+            continue;
+        }
+        std::string name = ring_name(options.session, rank(), peer);
+        uint32_t attempts = 0;
+        while (m_outgoing[peer].header == nullptr) {
+            int fd = shm_open(name.c_str(), O_RDWR, 0600);
+            struct stat info;
+            if (fd >= 0 && fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) == mapping_size()) {
+                void* mapped = mmap(nullptr, mapping_size(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                auto* header = static_cast<RingHeader*>(mapped);
+                uint32_t unattached = 0;
+                if (mapped != MAP_FAILED && header->ready.load(std::memory_order_acquire) == 1
+                    && header->attached.compare_exchange_strong(unattached, 1)) {
+                    m_outgoing[peer] = { header, static_cast<char*>(mapped) + sizeof(RingHeader) };
+                } else if (mapped != MAP_FAILED) {
+                    munmap(mapped, mapping_size());
+                }
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            if (m_outgoing[peer].header == nullptr) {
+                if (std::chrono::steady_clock::now() > deadline) {
+                    throw std::runtime_error("timed out attaching to rank " + std::to_string(peer));
+                }
+                backoff(attempts);
+            }
+        }
+    }
+
+    // Every peer has mapped the rings this rank reads, so the names are no longer needed.
+    for (uint32_t peer = 0; peer < ranks(); peer++) {
+        if (peer == rank()) {
+            continue;
+        }
+        uint32_t attempts = 0;
+        while (m_incoming[peer].header->attached.load(std::memory_order_acquire) == 0) {
+            if (std::chrono::steady_clock::now() > deadline) {
+                throw std::runtime_error("timed out waiting for rank " + std::to_string(peer));
+            }
+            backoff(attempts);
+        }
+        shm_unlink(ring_name(options.session, peer, rank()).c_str());
+        m_receivers.emplace_back(&SharedMemoryTransport::receive_loop, this, peer);
+    }
+}
+
+SharedMemoryTransport::~SharedMemoryTransport()
+{
+    for (Ring& ring : m_outgoing) {
+        if (ring.header) {
+            ring.header->closed.store(1, std::memory_order_release);
+        }
+    }
+    m_stopping = true;
+    for (auto& receiver : m_receivers) {
+        receiver.join();
+    }
+    for (Ring* rings : { m_incoming.data(), m_outgoing.data() }) {
+        for (uint32_t peer = 0; peer < ranks(); peer++) {
+            if (rings[peer].header) {
+                munmap(rings[peer].header, mapping_size());
+            }
+        }
+    }
+}
+
+void SharedMemoryTransport::write(Ring& ring, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    uint64_t head = ring.header->head.load(std::memory_order_relaxed);
+    uint32_t attempts = 0;
+    while (size > 0) {
+        uint64_t free = RING_BYTES - (head - ring.header->tail.load(std::memory_order_acquire));
+        if (free == 0) {
+            backoff(attempts);
+            continue;
+        }
+        attempts = 0;
+        uint64_t offset = head % RING_BYTES;
+        size_t count = static_cast<size_t>(std::min<uint64_t>({ free, size, RING_BYTES - offset }));
+        std::memcpy(ring.data + offset, bytes, count);
+        head += count;
+        bytes += count;
+        size -= count;
+        ring.header->head.store(head, std::memory_order_release);
+    }
+}
+
+// False when stopping, or when the writer has closed the ring before `size` bytes arrived.
+bool SharedMemoryTransport::read(Ring& ring, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    uint64_t tail = ring.header->tail.load(std::memory_order_relaxed);
+    uint32_t attempts = 0;
+    while (size > 0) {
+        // Closing follows the writer's last write, so reading the flag first means no data is missed.
+        bool closed = ring.header->closed.load(std::memory_order_acquire);
+        uint64_t available = ring.header->head.load(std::memory_order_acquire) - tail;
+        if (available == 0) {
+            if (m_stopping || closed) {
+                return false;
+            }
+            backoff(attempts);
+            continue;
+        }
+        attempts = 0;
+        uint64_t offset = tail % RING_BYTES;
+        size_t count = static_cast<size_t>(std::min<uint64_t>({ available, size, RING_BYTES - offset }));
+        std::memcpy(bytes, ring.data + offset, count);
+        tail += count;
+        bytes += count;
+        size -= count;
+        ring.header->tail.store(tail, std::memory_order_release);
+    }
+    return true;
+}
+
+void SharedMemoryTransport::send(uint32_t peer, uint32_t tag, const void* data, size_t size)
+{
+    FrameHeader header = { .tag = tag, .padding = 0, .size = size };
+    write(m_outgoing[peer], &header, sizeof(header));
+    write(m_outgoing[peer], data, size);
+}
+
+void SharedMemoryTransport::receive_loop(uint32_t peer)
+{
+    FrameHeader header;
+    while (read(m_incoming[peer], &header, sizeof(header))) {
+        std::vector<uint8_t> payload(header.size);
+        if (!read(m_incoming[peer], payload.data(), payload.size())) {
+            break;
+        }
+        deliver(peer, header.tag, std::move(payload));
+    }
+    close(peer);
+}
+
+} // namespace Simulation
@@ -0,0 +1,49 @@
+#include "Specialization.hpp"
+
+#include <algorithm>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+uint32_t SpecializationConstants::get(uint32_t constant_id, uint32_t fallback) const
+{
+    for (const auto& entry : m_entries) {
+        if (entry.constantID == constant_id) {
+            uint32_t value;
+            std::memcpy(&value, m_data.data() + entry.offset, sizeof(value));
+            return value;
+        }
+    }
+    return fallback;
+}
+
+const VkSpecializationInfo* SpecializationConstants::info() const
+{
+    if (m_entries.empty()) {
+        return nullptr;
+    }
+    m_info = {
+        .mapEntryCount = static_cast<uint32_t>(m_entries.size()),
+        .pMapEntries = m_entries.data(),
+        .dataSize = m_data.size(),
+        .pData = m_data.data(),
+    };
+    return &m_info;
+}
+
+std::string SpecializationConstants::to_string() const
+{
+    std::vector<VkSpecializationMapEntry> entries = m_entries;
+    std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return a.constantID < b.constantID; });
+
+    std::string text;
+    for (const auto& entry : entries) {
+        if (!text.empty()) {
+            text += ' ';
+        }
+        text += std::to_string(entry.constantID) + '=' + std::to_string(get(entry.constantID, 0));
+    }
+    return text;
+}
+
+} // namespace Simulation
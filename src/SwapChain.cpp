@@ -1,9 +1,13 @@
 #include "SwapChain.hpp"
+#include "Debug.hpp"
+#include "Logger.hpp"
+#include "TimelineSemaphore.hpp"
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
 #include <cstring>
-#include <iostream>
+#include <limits>
 #include <set>
 #include <stdexcept>
 #include <vulkan/vulkan_core.h>
@@ -15,9 +19,6 @@ SwapChain::SwapChain(Device& device_ref, VkExtent2D window_extent)
 {
     create_swap_chain();
     create_image_views();
-    create_render_pass();
-    create_depth_resources();
-    create_frame_buffers();
     create_sync_objects();
 }
 SwapChain::~SwapChain()
@@ -32,23 +33,224 @@ SwapChain::~SwapChain()
         m_swap_chain = nullptr;
     }
 
-    for (size_t i = 0; i < m_depth_images.size(); i++) {
-        vkDestroyImageView(m_device.device(), m_depth_image_views[i], nullptr);
-        vkDestroyImage(m_device.device(), m_depth_images[i], nullptr);
-        vkFreeMemory(m_device.device(), m_depth_image_memorys[i], nullptr);
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        vkDestroySemaphore(m_device.device(), m_render_finished_semaphores[i], nullptr);
+        vkDestroySemaphore(m_device.device(), m_image_available_semaphores[i], nullptr);
+    }
+}
+
+VkResult SwapChain::accuire_next_image(uint32_t* image_index)
+{
+    SIM_TRACE_ZONE("SwapChain::accuire_next_image");
+    m_device.graphics_timeline().wait(m_in_flight_values[current_frame]);
+    m_completed_serial = std::max(m_completed_serial, m_in_flight_serials[current_frame]);
+
+    return vkAcquireNextImageKHR(m_device.device(), m_swap_chain, std::numeric_limits<uint64_t>::max(),
+        m_image_available_semaphores[current_frame], VK_NULL_HANDLE, image_index);
+}
+
+uint64_t SwapChain::completed_frame_serial()
+{
+    TimelineSemaphore& timeline = m_device.graphics_timeline();
+    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        if (m_in_flight_serials[i] > m_completed_serial && timeline.is_complete(m_in_flight_values[i])) {
+            m_completed_serial = m_in_flight_serials[i];
+        }
+    }
+    return m_completed_serial;
+}
+
+VkResult SwapChain::submit_command_buffers(
+    const VkCommandBuffer* buffers, uint32_t* image_index, const std::vector<VkSemaphoreSubmitInfo>& waits)
+{
+    SIM_TRACE_ZONE("SwapChain::submit_command_buffers");
+    m_device.graphics_timeline().wait(m_images_in_flight_values[*image_index]);
+
+    // Acquire and present only understand binary semaphores; everything else goes through the graphics timeline.
+    std::vector<VkSemaphoreSubmitInfo> wait_infos = waits;
+    wait_infos.push_back({
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = m_image_available_semaphores[current_frame],
+        .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+    });
+    VkSemaphoreSubmitInfo signal_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .semaphore = m_render_finished_semaphores[current_frame],
+        .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+    };
+
+    uint64_t value = m_device.submit_graphics({ *buffers }, wait_infos, { signal_info });
+    m_in_flight_values[current_frame] = value;
+    m_images_in_flight_values[*image_index] = value;
+    m_in_flight_serials[current_frame] = ++m_frame_serial;
+
+    VkSwapchainKHR swap_chains[] = { m_swap_chain };
+    VkPresentInfoKHR present_info = {
+        .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &m_render_finished_semaphores[current_frame],
+        .swapchainCount = 1,
+        .pSwapchains = swap_chains,
+        .pImageIndices = image_index,
+    };
+
+    auto result = vkQueuePresentKHR(m_device.present_queue(), &present_info);
+    current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+
+    return result;
+}
+
+void SwapChain::create_swap_chain()
+{
+    SIM_TRACE_ZONE("SwapChain::create_swap_chain");
+    SwapChainSupportDetails swap_chain_support = m_device.get_swap_chain_support();
+
+    VkSurfaceFormatKHR surface_format = choose_swap_surface_format(swap_chain_support.formats);
+    VkPresentModeKHR present_mode = choose_swap_present_mode(swap_chain_support.present_modes);
+    VkExtent2D extent = choose_swap_extent(swap_chain_support.capabilities);
+
+    uint32_t image_count = swap_chain_support.capabilities.minImageCount + 1;
+    if (swap_chain_support.capabilities.maxImageCount > 0
+        && image_count > swap_chain_support.capabilities.maxImageCount) {
+        image_count = swap_chain_support.capabilities.maxImageCount;
+    }
+
+    // Frame capture copies straight out of the presentable images, so ask for transfer source usage when the
+    // surface allows it.
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    if (swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) {
+        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     }
 
-    for (auto frame_buffer : m_swap_chain_frame_buffers) {
-        vkDestroyFramebuffer(m_device.device(), frame_buffer, nullptr);
+    VkSwapchainCreateInfoKHR create_info = {
+        .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+        .surface = m_device.surface(),
+        .minImageCount = image_count,
+        .imageFormat = surface_format.format,
+        .imageColorSpace = surface_format.colorSpace,
+        .imageExtent = extent,
+        .imageArrayLayers = 1,
+        .imageUsage = usage,
+    };
+
+    QueueFamilyIndicies indicies = m_device.find_physical_queue_families();
+    uint32_t queue_family_indices[] = { indicies.graphics_family, indicies.present_family };
+
+    if (indicies.graphics_family != indicies.present_family) {
+        create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
+        create_info.queueFamilyIndexCount = 2;
+        create_info.pQueueFamilyIndices = queue_family_indices;
+    } else {
+        create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        create_info.queueFamilyIndexCount = 0;
+        create_info.pQueueFamilyIndices = nullptr;
     }
 
-    vkDestroyRenderPass(m_device.device(), m_render_pass, nullptr);
+    create_info.preTransform = swap_chain_support.capabilities.currentTransform;
+    create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    create_info.presentMode = present_mode;
+    create_info.clipped = VK_TRUE;
+    create_info.oldSwapchain = VK_NULL_HANDLE;
+
+    if (vkCreateSwapchainKHR(m_device.device(), &create_info, nullptr, &m_swap_chain) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create swap chain!");
+    }
+
+    vkGetSwapchainImagesKHR(m_device.device(), m_swap_chain, &image_count, nullptr);
+    m_swap_chain_images.resize(image_count);
+    vkGetSwapchainImagesKHR(m_device.device(), m_swap_chain, &image_count, m_swap_chain_images.data());
+
+    m_swap_chain_image_format = surface_format.format;
+    m_swap_chain_image_usage = usage;
+    m_swap_chain_extent = extent;
+}
+
+void SwapChain::create_image_views()
+{
+    m_swap_chain_image_views.resize(m_swap_chain_images.size());
+    for (size_t i = 0; i < m_swap_chain_images.size(); i++) {
+        VkImageViewCreateInfo view_info = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = m_swap_chain_images[i],
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = m_swap_chain_image_format,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+
+        if (vkCreateImageView(m_device.device(), &view_info, nullptr, &m_swap_chain_image_views[i]) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create texture image view!");
+        }
+    }
+}
+
+void SwapChain::create_sync_objects()
+{
+    m_image_available_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    m_render_finished_semaphores.resize(MAX_FRAMES_IN_FLIGHT);
+    m_images_in_flight_values.resize(image_count(), 0);
+
+    VkSemaphoreCreateInfo semaphore_info = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        vkDestroySemaphore(m_device.device(), m_render_finished_semaphores[i], nullptr);
-        vkDestroySemaphore(m_device.device(), m_image_available_semaphores[i], nullptr);
-        vkDestroyFence(m_device.device(), m_in_flight_fences[i], nullptr);
+        if (vkCreateSemaphore(m_device.device(), &semaphore_info, nullptr, &m_image_available_semaphores[i])
+                != VK_SUCCESS
+            || vkCreateSemaphore(m_device.device(), &semaphore_info, nullptr, &m_render_finished_semaphores[i])
+                != VK_SUCCESS) {
+            throw std::runtime_error("failed to create synchronization objects for a frame!");
+        }
     }
 }
 
+VkSurfaceFormatKHR SwapChain::choose_swap_surface_format(const std::vector<VkSurfaceFormatKHR>& available_formats)
+{
+    for (const auto& available_format : available_formats) {
+        if (available_format.format == VK_FORMAT_B8G8R8A8_SRGB
+            && available_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+            return available_format;
+        }
+    }
+    return available_formats[0];
+}
+
+VkPresentModeKHR SwapChain::choose_swap_present_mode(const std::vector<VkPresentModeKHR>& available_present_modes)
+{
+    for (const auto& available_present_mode : available_present_modes) {
+        if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            Logger::info(LogCategory::Presentation, "present mode: mailbox");
+            return available_present_mode;
+        }
+    }
+
+    Logger::info(LogCategory::Presentation, "present mode: v-sync");
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+VkExtent2D SwapChain::choose_swap_extent(const VkSurfaceCapabilitiesKHR& capabilities)
+{
+    if (capabilities.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+        return capabilities.currentExtent;
+    }
+
+    VkExtent2D actual_extent = m_window_extent;
+    actual_extent.width = std::max(
+        capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, actual_extent.width));
+    actual_extent.height = std::max(
+        capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, actual_extent.height));
+
+    return actual_extent;
+}
+
+VkFormat SwapChain::find_depth_format()
+{
+    return m_device.find_support_format(
+        { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT }, VK_IMAGE_TILING_OPTIMAL,
+        VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
 } // namespace Simulation
@@ -0,0 +1,176 @@
+#include "TcpTransport.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Simulation {
+
+static constexpr auto CONNECT_TIMEOUT = std::chrono::seconds(60);
+
+static void write_all(int fd, const void* data, size_t size)
+{
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::send(fd, bytes, size, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            throw std::runtime_error(std::string("tcp send failed: ") + std::strerror(errno));
+        }
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+// False when the connection was closed before `size` bytes arrived.
+static bool read_all(int fd, void* data, size_t size)
+{
+    char* bytes = static_cast<char*>(data);
+    while (size > 0) {
+        ssize_t received = ::recv(fd, bytes, size, 0);
+        if (received < 0 && errno == EINTR) {
+            continue;
+        }
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+TcpTransport::TcpTransport(const Transport::Options& options)
+    : Transport { options.rank, options.ranks }
+    , m_sockets(options.ranks, -1)
+    , m_send_mutexes(options.ranks)
+{
+    if (!options.hosts.empty() && options.hosts.size() != options.ranks) {
+        throw std::runtime_error("tcp transport needs one host per rank");
+    }
+    auto host = [&](uint32_t rank) { return options.hosts.empty() ? std::string("127.0.0.1") : options.hosts[rank]; };
+
+    // Listen before connecting so lower ranks can queue their connection while this one is still connecting.
+    int listener = -1;
+    if (rank() + 1 < ranks()) {
+        listener = ::socket(AF_INET, SOCK_STREAM, 0);
+        int enable = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(static_cast<uint16_t>(options.base_port + rank()));
+        if (listener < 0 || ::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || ::listen(listener, static_cast<int>(ranks())) != 0) {
+            throw std::runtime_error(std::string("tcp listen failed: ") + std::strerror(errno));
+        }
+    }
+
+    for (uint32_t peer = 0; peer < rank(); peer++) {
+        connect_to(peer, host(peer), static_cast<uint16_t>(options.base_port + peer));
+    }
+    if (listener >= 0) {
+        accept_from_higher_ranks(listener);
+        ::close(listener);
+    }
+
+    for (uint32_t peer = 0; peer < ranks(); peer++) {
+        if (peer != rank()) {
+            int enable = 1;
+            setsockopt(m_sockets[peer], IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+            m_receivers.emplace_back(&TcpTransport::receive_loop, this, peer);
+        }
+    }
+}
+
+TcpTransport::~TcpTransport()
+{
+    for (int socket : m_sockets) {
+        if (socket >= 0) {
+            ::shutdown(socket, SHUT_RDWR);
+        }
+    }
+    for (auto& receiver : m_receivers) {
+        receiver.join();
+    }
+    for (int socket : m_sockets) {
+        if (socket >= 0) {
+            ::close(socket);
+        }
+    }
+}
+
+void TcpTransport::connect_to(uint32_t peer, const std::string& host, uint16_t port)
+{
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses;
+    if (getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &addresses) != 0) {
+        throw std::runtime_error("failed to resolve " + host);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + CONNECT_TIMEOUT;
+    int fd = -1;
+    while (fd < 0) {
+        fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (::connect(fd, addresses->ai_addr, addresses->ai_addrlen) != 0) {
+            ::close(fd);
+            fd = -1;
+            if (std::chrono::steady_clock::now() > deadline) {
+                freeaddrinfo(addresses);
+                throw std::runtime_error("timed out connecting to rank " + std::to_string(peer));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    freeaddrinfo(addresses);
+
+    uint32_t handshake = rank();
+    write_all(fd, &handshake, sizeof(handshake));
+    m_sockets[peer] = fd;
+}
+
+void TcpTransport::accept_from_higher_ranks(int listener)
+{
+    for (uint32_t accepted = rank() + 1; accepted < ranks(); accepted++) {
+        int fd = ::accept(listener, nullptr, nullptr);
+        uint32_t peer;
+        if (fd < 0 || !read_all(fd, &peer, sizeof(peer)) || peer <= rank() || peer >= ranks()
+            || m_sockets[peer] >= 0) {
+            throw std::runtime_error("bad tcp handshake on rank " + std::to_string(rank()));
+        }
+        m_sockets[peer] = fd;
+    }
+}
+
+void TcpTransport::send(uint32_t peer, uint32_t tag, const void* data, size_t size)
+{
+    FrameHeader header = { .tag = tag, .padding = 0, .size = size };
+    std::lock_guard<std::mutex> lock { m_send_mutexes[peer] };
+    write_all(m_sockets[peer], &header, sizeof(header));
+    write_all(m_sockets[peer], data, size);
+}
+
+void TcpTransport::receive_loop(uint32_t peer)
+{
+    FrameHeader header;
+    while (read_all(m_sockets[peer], &header, sizeof(header))) {
+        std::vector<uint8_t> payload(header.size);
+        if (!read_all(m_sockets[peer], payload.data(), payload.size())) {
+            break;
+        }
+        deliver(peer, header.tag, std::move(payload));
+    }
+    close(peer);
+}
+
+} // namespace Simulation
@@ -0,0 +1,91 @@
+#include "ThreadPool.hpp"
+#include "Debug.hpp"
+
+#include <algorithm>
+
+namespace Simulation {
+
+ThreadPool::ThreadPool(uint32_t thread_count)
+{
+    // The caller takes part in every loop, so spawn one fewer worker.
+    uint32_t workers = std::max(thread_count, 1u) - 1;
+    for (uint32_t i = 0; i < workers; i++) {
+        m_workers.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_work_cv.notify_all();
+    for (auto& worker : m_workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallel_for(
+    uint32_t count, uint32_t grain, const std::function<void(uint32_t begin, uint32_t end)>& fn)
+{
+    if (count == 0)
+        return;
+
+    grain = std::max(grain, 1u);
+    if (m_workers.empty() || count <= grain) {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_fn = &fn;
+        m_count = count;
+        m_grain = grain;
+        m_next.store(0, std::memory_order_relaxed);
+        m_active = static_cast<uint32_t>(m_workers.size());
+        m_generation++;
+    }
+    m_work_cv.notify_all();
+
+    run_chunks();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done_cv.wait(lock, [this] { return m_active == 0; });
+    m_fn = nullptr;
+}
+
+void ThreadPool::run_chunks()
+{
+    for (;;) {
+        uint32_t begin = m_next.fetch_add(m_grain, std::memory_order_relaxed);
+        if (begin >= m_count)
+            return;
+        (*m_fn)(begin, std::min(begin + m_grain, m_count));
+    }
+}
+
+void ThreadPool::worker_loop()
+{
+    SIM_TRACE_THREAD("pool worker");
+    uint64_t seen_generation = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_work_cv.wait(lock, [&] { return m_stop || m_generation != seen_generation; });
+            if (m_stop)
+                return;
+            seen_generation = m_generation;
+        }
+
+        run_chunks();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_active == 0) {
+            m_done_cv.notify_one();
+        }
+    }
+}
+
+} // namespace Simulation
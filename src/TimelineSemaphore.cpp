@@ -0,0 +1,57 @@
+#include "TimelineSemaphore.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+TimelineSemaphore::TimelineSemaphore(VkDevice device, uint64_t initial_value)
+    : m_device { device }
+    , m_completed { initial_value }
+    , m_last_reserved { initial_value }
+{
+    VkSemaphoreTypeCreateInfo type_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initial_value,
+    };
+    VkSemaphoreCreateInfo semaphore_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &type_info,
+    };
+    if (vkCreateSemaphore(m_device, &semaphore_info, nullptr, &m_semaphore) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timeline semaphore");
+    }
+}
+
+TimelineSemaphore::~TimelineSemaphore() { vkDestroySemaphore(m_device, m_semaphore, nullptr); }
+
+uint64_t TimelineSemaphore::completed()
+{
+    uint64_t value;
+    if (vkGetSemaphoreCounterValue(m_device, m_semaphore, &value) == VK_SUCCESS) {
+        m_completed = std::max(m_completed, value);
+    }
+    return m_completed;
+}
+
+void TimelineSemaphore::wait(uint64_t value)
+{
+    if (is_complete(value)) {
+        return;
+    }
+
+    VkSemaphoreWaitInfo wait_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &m_semaphore,
+        .pValues = &value,
+    };
+    if (vkWaitSemaphores(m_device, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+        throw std::runtime_error("failed to wait for timeline semaphore");
+    }
+    m_completed = std::max(m_completed, value);
+}
+
+} // namespace Simulation
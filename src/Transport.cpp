@@ -0,0 +1,69 @@
+#include "Transport.hpp"
+#include "SharedMemoryTransport.hpp"
+#include "TcpTransport.hpp"
+
+#include <stdexcept>
+
+namespace Simulation {
+
+std::unique_ptr<Transport> Transport::create(const Options& options)
+{
+    if (options.ranks == 0 || options.rank >= options.ranks) {
+        throw std::runtime_error("invalid rank " + std::to_string(options.rank) + " of "
+            + std::to_string(options.ranks));
+    }
+    if (options.kind == "tcp") {
+        return std::make_unique<TcpTransport>(options);
+    }
+    if (options.kind == "shm") {
+        return std::make_unique<SharedMemoryTransport>(options);
+    }
+    throw std::runtime_error("unknown transport " + options.kind);
+}
+
+Transport::Transport(uint32_t rank, uint32_t ranks)
+    : m_rank { rank }
+    , m_ranks { ranks }
+    , m_mailboxes(ranks)
+{
+}
+
+std::vector<uint8_t> Transport::receive(uint32_t peer, uint32_t tag)
+{
+    Mailbox& mailbox = m_mailboxes[peer];
+    std::unique_lock<std::mutex> lock { mailbox.mutex };
+    mailbox.arrived.wait(lock, [&] { return !mailbox.messages.empty() || mailbox.closed; });
+    if (mailbox.messages.empty()) {
+        throw std::runtime_error("rank " + std::to_string(peer) + " disconnected");
+    }
+
+    Message message = std::move(mailbox.messages.front());
+    mailbox.messages.pop_front();
+    if (message.tag != tag) {
+        throw std::runtime_error("expected message " + std::to_string(tag) + " from rank " + std::to_string(peer)
+            + ", got " + std::to_string(message.tag));
+    }
+    return std::move(message.payload);
+}
+
+void Transport::deliver(uint32_t peer, uint32_t tag, std::vector<uint8_t> payload)
+{
+    Mailbox& mailbox = m_mailboxes[peer];
+    {
+        std::lock_guard<std::mutex> lock { mailbox.mutex };
+        mailbox.messages.push_back({ tag, std::move(payload) });
+    }
+    mailbox.arrived.notify_one();
+}
+
+void Transport::close(uint32_t peer)
+{
+    Mailbox& mailbox = m_mailboxes[peer];
+    {
+        std::lock_guard<std::mutex> lock { mailbox.mutex };
+        mailbox.closed = true;
+    }
+    mailbox.arrived.notify_all();
+}
+
+} // namespace Simulation
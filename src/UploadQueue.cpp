@@ -0,0 +1,197 @@
+#include "UploadQueue.hpp"
+#include "Debug.hpp"
+#include "TimelineSemaphore.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace Simulation {
+
+UploadQueue::UploadQueue(Device& device, VkDeviceSize staging_size)
+    : m_device { device }
+    , m_staging_size { staging_size }
+{
+    VkCommandPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = m_device.find_physical_queue_families().graphics_family,
+    };
+    if (vkCreateCommandPool(m_device.device(), &pool_info, nullptr, &m_command_pool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create upload command pool");
+    }
+
+    m_device.create_buffer(m_staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, m_staging_buffer,
+        m_staging_memory);
+    void* mapped;
+    if (vkMapMemory(m_device.device(), m_staging_memory, 0, VK_WHOLE_SIZE, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map staging buffer");
+    }
+    m_staging_mapped = static_cast<char*>(mapped);
+
+    VkCommandBufferAllocateInfo alloc_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = m_command_pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    for (uint32_t i = 0; i < MAX_BATCHES; i++) {
+        if (vkAllocateCommandBuffers(m_device.device(), &alloc_info, &m_batches[i].command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create upload batch");
+        }
+        m_free_batches.push_back(i);
+    }
+}
+
+UploadQueue::~UploadQueue()
+{
+    wait_idle();
+
+    vkDestroyCommandPool(m_device.device(), m_command_pool, nullptr);
+
+    vkUnmapMemory(m_device.device(), m_staging_memory);
+    vkDestroyBuffer(m_device.device(), m_staging_buffer, nullptr);
+    vkFreeMemory(m_device.device(), m_staging_memory, nullptr);
+}
+
+void UploadQueue::enqueue(
+    VkBuffer dst, VkDeviceSize dst_offset, const void* src, VkDeviceSize size, std::function<void()> on_complete)
+{
+    m_requests.push_back({
+        .dst = dst,
+        .dst_offset = dst_offset,
+        .src = static_cast<const char*>(src),
+        .size = size,
+        .submitted = 0,
+        .on_complete = std::move(on_complete),
+    });
+}
+
+void UploadQueue::flush(VkDeviceSize budget)
+{
+    SIM_TRACE_ZONE("UploadQueue::flush");
+    if (m_free_batches.empty() || m_requests.empty())
+        return;
+
+    uint32_t batch_index = m_free_batches.front();
+    Batch& batch = m_batches[batch_index];
+
+    VkCommandBufferBeginInfo begin_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(batch.command_buffer, &begin_info);
+
+    VkDeviceSize recorded = 0;
+    while (!m_requests.empty() && recorded < budget) {
+        Request* request = &m_requests.front();
+        // Nothing to copy, but the callback still runs in order with the batch.
+        if (request->submitted == request->size) {
+            if (request->on_complete) {
+                batch.callbacks.push_back(std::move(request->on_complete));
+            }
+            m_requests.pop_front();
+            continue;
+        }
+
+        VkDeviceSize available = m_staging_size - (m_head - m_tail);
+        VkDeviceSize ring_offset = m_head % m_staging_size;
+        VkDeviceSize contiguous = m_staging_size - ring_offset;
+
+        VkDeviceSize chunk
+            = std::min({ request->size - request->submitted, available, contiguous, budget - recorded });
+        // The ring is full until a batch retires.
+        if (chunk == 0)
+            break;
+
+        std::memcpy(m_staging_mapped + ring_offset, request->src + request->submitted, chunk);
+
+        VkBufferCopy region = {
+            .srcOffset = ring_offset,
+            .dstOffset = request->dst_offset + request->submitted,
+            .size = chunk,
+        };
+        vkCmdCopyBuffer(batch.command_buffer, m_staging_buffer, request->dst, 1, &region);
+
+        m_head += chunk;
+        recorded += chunk;
+        request->submitted += chunk;
+
+        if (request->submitted == request->size) {
+            if (request->on_complete) {
+                batch.callbacks.push_back(std::move(request->on_complete));
+            }
+            m_requests.pop_front();
+        }
+    }
+
+    if (recorded == 0 && batch.callbacks.empty()) {
+        vkEndCommandBuffer(batch.command_buffer);
+        vkResetCommandBuffer(batch.command_buffer, 0);
+        return;
+    }
+
+    // Make the copies visible to any later vertex/index fetch or shader read on this queue.
+    VkMemoryBarrier2 barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT | VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT
+            | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask
+        = VK_ACCESS_2_INDEX_READ_BIT | VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT,
+    };
+    VkDependencyInfo dependency = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .memoryBarrierCount = 1,
+        .pMemoryBarriers = &barrier,
+    };
+    vkCmdPipelineBarrier2(batch.command_buffer, &dependency);
+    vkEndCommandBuffer(batch.command_buffer);
+
+    batch.value = m_device.submit_graphics({ batch.command_buffer });
+    m_submitted_value = batch.value;
+    batch.ring_end = m_head;
+    m_free_batches.pop_front();
+    m_in_flight.push_back(batch_index);
+    m_bytes_uploaded += recorded;
+}
+
+void UploadQueue::poll()
+{
+    SIM_TRACE_ZONE("UploadQueue::poll");
+    while (!m_in_flight.empty()) {
+        Batch& batch = m_batches[m_in_flight.front()];
+        if (!m_device.graphics_timeline().is_complete(batch.value))
+            break;
+
+        vkResetCommandBuffer(batch.command_buffer, 0);
+        m_tail = batch.ring_end;
+
+        auto callbacks = std::move(batch.callbacks);
+        batch.callbacks.clear();
+        m_free_batches.push_back(m_in_flight.front());
+        m_in_flight.pop_front();
+
+        for (auto& callback : callbacks) {
+            callback();
+        }
+    }
+}
+
+void UploadQueue::wait_idle()
+{
+    while (!idle()) {
+        flush(m_staging_size);
+        if (!m_in_flight.empty()) {
+            m_device.graphics_timeline().wait(m_batches[m_in_flight.front()].value);
+        }
+        poll();
+    }
+}
+
+} // namespace Simulation
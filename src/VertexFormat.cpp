@@ -0,0 +1,88 @@
+#include "VertexFormat.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+namespace Simulation {
+
+uint16_t quantize_half(float value)
+{
+    uint32_t bits = std::bit_cast<uint32_t>(value);
+    uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+    uint32_t magnitude = bits & 0x7FFFFFFF;
+
+    if (magnitude >= 0x7F800000) {
+        // Infinity stays infinity; NaN keeps a set mantissa bit.
+        return sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x0200 : 0);
+    }
+    if (magnitude >= 0x477FF000) {
+        // At or above 65520, which rounds past the largest finite half.
+        return sign | 0x7C00;
+    }
+    if (magnitude < 0x38800000) {
+        // Below the smallest normal half: a subnormal in units of 2^-24, rounded to nearest even.
+        if (magnitude < 0x33000000) {
+            return sign;
+        }
+        uint32_t exponent = magnitude >> 23;
+        uint32_t mantissa = (magnitude & 0x007FFFFF) | 0x00800000;
+        uint32_t shift = 126 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t remainder = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (remainder > midpoint || (remainder == midpoint && (half & 1))) {
+            half++;
+        }
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    // Rebias the exponent from 127 to 15 and round the 13 dropped mantissa bits to nearest even; a carry out of the
+    // mantissa correctly bumps the exponent.
+    uint32_t half = (magnitude - 0x38000000) >> 13;
+    uint32_t remainder = magnitude & 0x1FFF;
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+    return sign | static_cast<uint16_t>(half);
+}
+
+uint16_t quantize_unorm16(float value)
+{
+    return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * 65535.0f));
+}
+
+int16_t quantize_snorm16(float value)
+{
+    return static_cast<int16_t>(std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f));
+}
+
+glm::vec2 oct_encode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p { n.x, n.y };
+    if (n.z < 0.0f) {
+        p = { (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f) };
+    }
+    return p;
+}
+
+IndexStream narrow_indices(const std::vector<uint32_t>& indices, size_t vertex_count)
+{
+    IndexStream stream;
+    stream.index_size = vertex_count <= 0x10000 ? 2 : 4;
+    stream.bytes.resize(indices.size() * stream.index_size);
+    if (stream.index_size == 4) {
+        std::memcpy(stream.bytes.data(), indices.data(), stream.bytes.size());
+        return stream;
+    }
+    for (size_t n = 0; n < indices.size(); n++) {
+        uint16_t index = static_cast<uint16_t>(indices[n]);
+        std::memcpy(stream.bytes.data() + n * 2, &index, 2);
+    }
+    return stream;
+}
+
+} // namespace Simulation
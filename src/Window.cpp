@@ -2,6 +2,7 @@
 
 #include <GLFW/glfw3.h>
 #include <stdexcept>
+#include <utility>
 
 namespace Simulation {
 Window::Window(int width, int height, const std::string& name)
@@ -25,6 +26,12 @@ void Window::initWindow()
     glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
 
     window = glfwCreateWindow(m_width, m_height, m_name.c_str(), nullptr, nullptr);
+    glfwSetWindowUserPointer(window, this);
+    glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
+    glfwSetScrollCallback(window, scroll_callback);
+    glfwSetWindowRefreshCallback(window, refresh_callback);
+    glfwSetWindowIconifyCallback(window, iconify_callback);
 }
 
 void Window::create_window_surface(VkInstance instance, VkSurfaceKHR* surface)
@@ -34,4 +41,47 @@ void Window::create_window_surface(VkInstance instance, VkSurfaceKHR* surface)
     }
 }
 
+bool Window::take_changes()
+{
+    bool changed = m_changed;
+    m_changed = false;
+    return changed;
+}
+
+std::vector<int> Window::take_pressed_keys()
+{
+    return std::exchange(m_pressed_keys, {});
+}
+
+void Window::key_callback(GLFWwindow* window, int key, int, int action, int)
+{
+    auto self = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    if (action == GLFW_PRESS) {
+        self->m_pressed_keys.push_back(key);
+    }
+    self->m_changed = true;
+}
+
+void Window::mouse_button_callback(GLFWwindow* window, int, int, int)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->m_changed = true;
+}
+
+void Window::scroll_callback(GLFWwindow* window, double, double)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->m_changed = true;
+}
+
+void Window::refresh_callback(GLFWwindow* window)
+{
+    static_cast<Window*>(glfwGetWindowUserPointer(window))->m_changed = true;
+}
+
+void Window::iconify_callback(GLFWwindow* window, int iconified)
+{
+    auto self = static_cast<Window*>(glfwGetWindowUserPointer(window));
+    self->m_iconified = iconified == GLFW_TRUE;
+    self->m_changed = true;
+}
+
 } // namespace Simulation
@@ -1,21 +1,309 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <cstdlib>
-#include <iostream>
+#include <cstring>
 #include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "AdaptiveSimulation.hpp"
 #include "Application.hpp"
+#include "ConstraintSolver.hpp"
+#include "Debug.hpp"
+#include "DistributedSimulation.hpp"
+#include "Logger.hpp"
+#include "MeshFile.hpp"
 #include "Pipeline.hpp"
+#include "ScenarioBatch.hpp"
+#include "Transport.hpp"
 
-int main()
+// Every scenario listed in `path` on one headless device, one result file each in `output`.
+static void run_batch(const char* path, const char* output)
+{
+    Simulation::Device device {};
+    Simulation::ScenarioBatch batch { device, Simulation::ScenarioBatch::load(path) };
+
+    auto start = std::chrono::steady_clock::now();
+    batch.run();
+    batch.write_results(output);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    size_t count = batch.scenarios().size();
+    Simulation::Logger::info(Simulation::LogCategory::Simulation,
+        "batch: %zu scenarios in %.3f s (%.0f scenarios/hour)", count, seconds, count * 3600.0 / seconds);
+}
+
+// This process's part of a simulation split over `options.ranks` processes; runs on the CPU only.
+static void run_distributed(const Simulation::Transport::Options& options,
+    const Simulation::DistributedSimulation::Config& config, uint64_t ticks)
+{
+    auto transport = Simulation::Transport::create(options);
+    Simulation::ThreadPool pool {};
+    Simulation::DistributedSimulation simulation { *transport, pool, config };
+
+    auto start = std::chrono::steady_clock::now();
+    while (simulation.tick() < ticks) {
+        simulation.step();
+        if (simulation.tick() % 100 == 0 || simulation.tick() == ticks) {
+            uint64_t total = simulation.global_count();
+            if (total != config.particle_count) {
+                throw std::runtime_error("particle count is " + std::to_string(total) + ", expected "
+                    + std::to_string(config.particle_count));
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    Simulation::Logger::info(Simulation::LogCategory::Simulation,
+        "rank %u: %u particles in [%g, %g), halo %u, %.3f ms/tick, %.3f ms/tick waiting for halos", transport->rank(),
+        simulation.local_count(), simulation.slab_begin(), simulation.slab_end(), simulation.halo_count(),
+        1000.0 * seconds / ticks, 1000.0 * simulation.halo_wait_seconds() / ticks);
+}
+
+// The distributed simulation's particles in one process with block time steps, against the force evaluations a
+// global step at the finest level in use would have needed.
+static void run_adaptive(const Simulation::AdaptiveSimulation::Config& config, uint64_t ticks)
+{
+    Simulation::ThreadPool pool {};
+    Simulation::AdaptiveSimulation simulation { pool, config };
+
+    auto start = std::chrono::steady_clock::now();
+    while (simulation.tick() < ticks) {
+        simulation.step();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::string levels;
+    for (uint32_t level = 0; level <= config.max_level; level++) {
+        levels += " " + std::to_string(simulation.level_count(level));
+    }
+    Simulation::Logger::info(Simulation::LogCategory::Simulation,
+        "adaptive: %u particles, %.3f ms/tick, %llu force evaluations (%.1fx fewer than a global step), levels%s",
+        config.particle_count, 1000.0 * seconds / ticks,
+        static_cast<unsigned long long>(simulation.force_evaluations()),
+        static_cast<double>(simulation.uniform_force_evaluations()) / simulation.force_evaluations(), levels.c_str());
+}
+
+// Square cloth pieces, every other one dropped onto the ground and the rest already resting there, solved with
+// every power-of-two thread count up to the core count.
+static void run_solver_benchmark()
+{
+    constexpr uint32_t SIDE = 32;
+    constexpr float SPACING = 0.02f;
+    constexpr uint32_t STEPS = 120;
+    constexpr float DT = 1.0f / 60.0f;
+
+    uint32_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+    for (uint32_t bodies : { 4096u, 32768u, 131072u }) {
+        for (uint32_t threads = 1;; threads = std::min(threads * 2, cores)) {
+            Simulation::ThreadPool pool { threads };
+            Simulation::ConstraintSolver::Config config;
+            Simulation::ConstraintSolver solver { pool, config };
+
+            uint32_t pieces = bodies / (SIDE * SIDE);
+            uint32_t per_row = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(pieces))));
+            for (uint32_t piece = 0; piece < pieces; piece++) {
+                glm::vec3 origin { (piece % per_row) * (SIDE + 2) * SPACING, piece % 2 ? 0.5f : config.radius,
+                    (piece / per_row) * (SIDE + 2) * SPACING };
+                uint32_t first = solver.body_count();
+                for (uint32_t z = 0; z < SIDE; z++) {
+                    for (uint32_t x = 0; x < SIDE; x++) {
+                        solver.add_body(origin + glm::vec3(x * SPACING, 0.0f, z * SPACING), 1.0f);
+                    }
+                }
+                auto index = [&](uint32_t x, uint32_t z) { return first + z * SIDE + x; };
+                for (uint32_t z = 0; z < SIDE; z++) {
+                    for (uint32_t x = 0; x < SIDE; x++) {
+                        if (x + 1 < SIDE) {
+                            solver.add_distance(index(x, z), index(x + 1, z));
+                        }
+                        if (z + 1 < SIDE) {
+                            solver.add_distance(index(x, z), index(x, z + 1));
+                        }
+                        if (x + 1 < SIDE && z + 1 < SIDE) {
+                            solver.add_distance(index(x, z), index(x + 1, z + 1));
+                            solver.add_distance(index(x + 1, z), index(x, z + 1));
+                        }
+                    }
+                }
+            }
+
+            // The first step builds the islands and batches.
+            solver.step(DT);
+            uint32_t colors = solver.color_count();
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t step = 0; step < STEPS; step++) {
+                solver.step(DT);
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            Simulation::Logger::info(Simulation::LogCategory::Simulation,
+                "solver: %u bodies, %u constraints, %u colors, %u threads: %.0f iterations/s, %.3f ms/step, %u bodies "
+                "awake at the end",
+                solver.body_count(), solver.constraint_count(), colors, threads, STEPS * config.iterations / seconds,
+                1000.0 * seconds / STEPS, solver.awake_body_count());
+            if (threads == cores) {
+                break;
+            }
+        }
+    }
+}
+
+// An OBJ file as a .smesh for --mesh, with coarser levels made by clustering at decreasing grid resolutions.
+static void convert_mesh(const char* source, const char* destination)
+{
+    std::vector<Simulation::MeshSourceLod> lods { Simulation::read_obj_file(source) };
+    for (uint32_t cells : { 64u, 16u, 4u }) {
+        Simulation::MeshSourceLod coarse = Simulation::simplify_mesh(lods[0], cells);
+        // Stop once a level no longer saves much over the one before it.
+        if (coarse.indices.empty() || coarse.indices.size() * 4 > lods.back().indices.size() * 3) {
+            break;
+        }
+        lods.push_back(std::move(coarse));
+    }
+    Simulation::write_mesh_file(destination, lods);
+    Simulation::Logger::info(Simulation::LogCategory::General, "mesh: %s -> %s, %zu levels, %zu to %zu triangles",
+        source, destination, lods.size(), lods.back().indices.size() / 3, lods[0].indices.size() / 3);
+}
+
+// The interactive window, set up by the options that apply to it in command line order.
+static void run_window(int argc, char** argv)
 {
     Simulation::Application app {};
 
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            app.enable_capture(argv[++i]);
+        } else if (std::strcmp(argv[i], "--mesh") == 0 && i + 1 < argc) {
+            app.load_mesh(argv[++i]);
+        } else if (std::strcmp(argv[i], "--objects") == 0 && i + 1 < argc) {
+            app.add_objects(static_cast<uint32_t>(std::stoul(argv[++i])));
+        } else if (std::strcmp(argv[i], "--gpu-culling") == 0) {
+            app.enable_gpu_culling();
+        } else if (std::strcmp(argv[i], "--autotune") == 0) {
+            app.enable_autotune(false);
+        } else if (std::strcmp(argv[i], "--retune") == 0) {
+            app.enable_autotune(true);
+        } else if (std::strcmp(argv[i], "--stats") == 0) {
+            app.enable_stats();
+        } else if (std::strcmp(argv[i], "--fps") == 0 && i + 1 < argc) {
+            app.set_frame_rate(std::stod(argv[++i]));
+        } else if (std::strcmp(argv[i], "--paused") == 0) {
+            app.set_paused(true);
+        }
+    }
+
+    app.run();
+}
+
+static std::vector<std::string> split(const std::string& list, char separator)
+{
+    std::vector<std::string> items;
+    size_t begin = 0;
+    for (size_t end; (end = list.find(separator, begin)) != std::string::npos; begin = end + 1) {
+        items.push_back(list.substr(begin, end - begin));
+    }
+    items.push_back(list.substr(begin));
+    return items;
+}
+
+int main(int argc, char** argv)
+{
     try {
-        app.run();
+        const char* batch = nullptr;
+        const char* mesh_source = nullptr;
+        const char* mesh_destination = nullptr;
+        const char* output = ".";
+        bool distributed = false;
+        bool solver_benchmark = false;
+        bool adaptive = false;
+        Simulation::AdaptiveSimulation::Config adaptive_config;
+        Simulation::Transport::Options transport;
+        Simulation::DistributedSimulation::Config config;
+        uint64_t ticks = 1000;
+        const char* trace = nullptr;
+        for (int i = 1; i < argc; i++) {
+            if (std::strcmp(argv[i], "--batch") == 0 && i + 1 < argc) {
+                batch = argv[++i];
+            } else if (std::strcmp(argv[i], "--convert-mesh") == 0 && i + 2 < argc) {
+                mesh_source = argv[++i];
+                mesh_destination = argv[++i];
+            } else if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+                output = argv[++i];
+            } else if (std::strcmp(argv[i], "--ranks") == 0 && i + 1 < argc) {
+                distributed = true;
+                transport.ranks = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (std::strcmp(argv[i], "--rank") == 0 && i + 1 < argc) {
+                transport.rank = static_cast<uint32_t>(std::stoul(argv[++i]));
+            } else if (std::strcmp(argv[i], "--transport") == 0 && i + 1 < argc) {
+                transport.kind = argv[++i];
+            } else if (std::strcmp(argv[i], "--hosts") == 0 && i + 1 < argc) {
+                transport.hosts = split(argv[++i], ',');
+            } else if (std::strcmp(argv[i], "--port") == 0 && i + 1 < argc) {
+                transport.base_port = static_cast<uint16_t>(std::stoul(argv[++i]));
+            } else if (std::strcmp(argv[i], "--session") == 0 && i + 1 < argc) {
+                transport.session = argv[++i];
+            } else if (std::strcmp(argv[i], "--particles") == 0 && i + 1 < argc) {
+                config.particle_count = static_cast<uint32_t>(std::stoul(argv[++i]));
+                adaptive_config.particle_count = config.particle_count;
+            } else if (std::strcmp(argv[i], "--ticks") == 0 && i + 1 < argc) {
+                ticks = std::stoull(argv[++i]);
+            } else if (std::strcmp(argv[i], "--adaptive") == 0) {
+                adaptive = true;
+            } else if (std::strcmp(argv[i], "--solver-benchmark") == 0) {
+                solver_benchmark = true;
+            } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+                trace = argv[++i];
+#ifdef SIM_ENABLE_TRACING
+                SIM_TRACE_THREAD("main");
+                Simulation::Trace::instance().set_enabled(true);
+#else
+                Simulation::Logger::warning(Simulation::LogCategory::General,
+                    "built without SIM_ENABLE_TRACING, the trace will be empty");
+#endif
+            } else if (std::strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+                Simulation::LogSeverity severity;
+                if (!Simulation::Logger::parse_severity(argv[++i], severity)) {
+                    throw std::runtime_error(std::string("unknown log level ") + argv[i]);
+                }
+                Simulation::Logger::instance().set_min_severity(severity);
+            } else if (std::strcmp(argv[i], "--log-disable") == 0 && i + 1 < argc) {
+                for (const auto& name : split(argv[++i], ',')) {
+                    Simulation::LogCategory category;
+                    if (!Simulation::Logger::parse_category(name, category)) {
+                        throw std::runtime_error("unknown log category " + name);
+                    }
+                    Simulation::Logger::instance().set_category_enabled(category, false);
+                }
+            }
+        }
+        if (mesh_source) {
+            convert_mesh(mesh_source, mesh_destination);
+        } else if (batch) {
+            run_batch(batch, output);
+        } else if (distributed) {
+            run_distributed(transport, config, ticks);
+        } else if (adaptive) {
+            run_adaptive(adaptive_config, ticks);
+        } else if (solver_benchmark) {
+            run_solver_benchmark();
+        } else {
+            run_window(argc, argv);
+        }
+
+        if (trace) {
+            uint64_t events = Simulation::Trace::instance().write(trace);
+            Simulation::Logger::info(Simulation::LogCategory::General, "trace: %llu events in %s, %llu dropped",
+                static_cast<unsigned long long>(events), trace,
+                static_cast<unsigned long long>(Simulation::Trace::instance().dropped()));
+        }
     } catch (const std::exception& e) {
-        std::cerr << e.what() << '\n';
+        Simulation::Logger::error(Simulation::LogCategory::General, "%s", e.what());
         return EXIT_FAILURE;
     }
     return EXIT_SUCCESS;
@@ -0,0 +1,128 @@
+#include "Culling.hpp"
+#include "ThreadPool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace Simulation;
+
+// The same test as Bvh's leaves, one box at a time: outside when the corner furthest along a plane's normal is
+// behind it.
+static bool outside(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max)
+{
+    for (const auto& plane : frustum.planes) {
+        glm::vec3 corner { plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y,
+            plane.z >= 0.0f ? max.z : min.z };
+        if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// An axis-aligned box frustum, [-1, 1] in x and y and [0, 1] in z, so about half of the scattered boxes are culled.
+static Frustum box_frustum()
+{
+    Frustum frustum;
+    frustum.planes[0] = { 1.0f, 0.0f, 0.0f, 1.0f };
+    frustum.planes[1] = { -1.0f, 0.0f, 0.0f, 1.0f };
+    frustum.planes[2] = { 0.0f, 1.0f, 0.0f, 1.0f };
+    frustum.planes[3] = { 0.0f, -1.0f, 0.0f, 1.0f };
+    frustum.planes[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+    frustum.planes[5] = { 0.0f, 0.0f, -1.0f, 1.0f };
+    return frustum;
+}
+
+static bool check(bool condition, const char* what, uint32_t count)
+{
+    if (!condition) {
+        std::fprintf(stderr, "%u objects: %s\n", count, what);
+    }
+    return condition;
+}
+
+// Counts that are not multiples of four give odd leaf sizes and leaves starting off a SIMD boundary, e.g. 12 objects
+// split into [0, 6) and [6, 12); the last leaf's lanes run past the object count.
+static bool test_count(ThreadPool& pool, uint32_t count, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> position { -2.0f, 2.0f };
+    std::uniform_real_distribution<float> size { 0.01f, 0.2f };
+
+    AabbSoA boxes;
+    boxes.resize(count);
+    std::vector<glm::vec3> centers(count);
+    for (uint32_t i = 0; i < count; i++) {
+        centers[i] = { position(random), position(random), position(random) };
+        glm::vec3 half { size(random) };
+        boxes.set(i, centers[i] - half, centers[i] + half);
+    }
+
+    Bvh bvh;
+    bvh.build(boxes);
+    Frustum frustum = box_frustum();
+    bool ok = true;
+
+    for (uint32_t tick = 0; tick < 3; tick++) {
+        std::vector<uint32_t> expected;
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 min { boxes.min_x[i], boxes.min_y[i], boxes.min_z[i] };
+            glm::vec3 max { boxes.max_x[i], boxes.max_y[i], boxes.max_z[i] };
+            if (!outside(frustum, min, max)) {
+                expected.push_back(i);
+            }
+        }
+
+        std::vector<uint32_t> visible(count);
+        uint32_t visible_count = bvh.cull(frustum, pool, visible.data(), count);
+        visible.resize(visible_count);
+        std::sort(visible.begin(), visible.end());
+        ok &= check(visible == expected, "visible indices differ from the brute force test", count);
+
+        // Instance records are copied in the same order as the indices.
+        std::vector<glm::vec4> records(count);
+        for (uint32_t i = 0; i < count; i++) {
+            records[i] = glm::vec4(centers[i], static_cast<float>(i));
+        }
+        std::vector<glm::vec4> instances(count);
+        uint32_t instance_count
+            = bvh.cull(frustum, pool, instances.data(), count, records.data(), sizeof(glm::vec4));
+        std::vector<uint32_t> copied;
+        for (uint32_t i = 0; i < instance_count; i++) {
+            copied.push_back(static_cast<uint32_t>(instances[i].w));
+        }
+        std::sort(copied.begin(), copied.end());
+        ok &= check(copied == expected, "copied instances differ from the brute force test", count);
+
+        uint32_t capacity = static_cast<uint32_t>(expected.size() / 2);
+        ok &= check(bvh.cull(frustum, pool, visible.data(), capacity) == capacity, "capacity not respected", count);
+
+        // Move everything a little and refit, as a tick would.
+        for (uint32_t i = 0; i < count; i++) {
+            glm::vec3 shift { 0.05f, -0.03f, 0.02f };
+            centers[i] += shift;
+            glm::vec3 half { (boxes.max_x[i] - boxes.min_x[i]) * 0.5f };
+            boxes.set(i, centers[i] - half, centers[i] + half);
+        }
+        bvh.refit(boxes);
+    }
+    return ok;
+}
+
+int main()
+{
+    ThreadPool pool { 4 };
+    std::mt19937 random { 1234 };
+
+    bool ok = true;
+    for (uint32_t count : { 1u, 3u, 5u, 9u, 12u, 13u, 17u, 27u, 50u, 101u, 1023u, 4099u }) {
+        ok &= test_count(pool, count, random);
+    }
+
+    std::printf("%s\n", ok ? "culling: passed" : "culling: FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,218 @@
+#include "MeshFile.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace Simulation;
+
+static bool check(bool condition, const char* what)
+{
+    if (!condition) {
+        std::fprintf(stderr, "%s\n", what);
+    }
+    return condition;
+}
+
+static bool near(const glm::vec3& a, const glm::vec3& b, float tolerance)
+{
+    return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+}
+
+static std::string temp_path(const char* name) { return (std::filesystem::temp_directory_path() / name).string(); }
+
+// A bumpy `side` x `side` vertex grid in the xy plane, two triangles per cell.
+static MeshSourceLod grid(uint32_t side)
+{
+    MeshSourceLod lod;
+    for (uint32_t y = 0; y < side; y++) {
+        for (uint32_t x = 0; x < side; x++) {
+            float height = 0.1f * std::sin(static_cast<float>(x)) * std::cos(static_cast<float>(y));
+            lod.positions.push_back({ static_cast<float>(x), static_cast<float>(y) - 2.0f, height });
+            lod.normals.push_back({ 0.0f, 0.0f, 1.0f });
+        }
+    }
+    for (uint32_t y = 0; y + 1 < side; y++) {
+        for (uint32_t x = 0; x + 1 < side; x++) {
+            uint32_t i = y * side + x;
+            lod.indices.insert(lod.indices.end(), { i, i + 1, i + side, i + 1, i + side + 1, i + side });
+        }
+    }
+    return lod;
+}
+
+// Inverse of oct_encode(), as mesh.glsl does it.
+static glm::vec3 oct_decode(float x, float y)
+{
+    glm::vec3 n { x, y, 1.0f - std::abs(x) - std::abs(y) };
+    if (n.z < 0.0f) {
+        n = { (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f),
+            n.z };
+    }
+    return n / glm::length(n);
+}
+
+static bool test_round_trip()
+{
+    std::vector<MeshSourceLod> lods { grid(40) };
+    lods.push_back(simplify_mesh(lods[0], 8));
+    bool ok = check(!lods[1].indices.empty() && lods[1].indices.size() < lods[0].indices.size(),
+        "simplify_mesh did not make a smaller level");
+
+    std::string path = temp_path("mesh_file_test.smesh");
+    write_mesh_file(path, lods);
+    MeshAsset asset { path };
+
+    const MeshFileHeader& header = asset.header();
+    ok &= check(header.magic == MeshFileHeader::MAGIC && header.version == MeshFileHeader::VERSION, "bad header");
+    ok &= check(header.vertex_stride == sizeof(MeshVertex), "bad vertex stride");
+    ok &= check(asset.lod_count() == lods.size(), "bad LOD count");
+    glm::vec3 bounds_min { header.bounds_min[0], header.bounds_min[1], header.bounds_min[2] };
+    glm::vec3 bounds_max { header.bounds_max[0], header.bounds_max[1], header.bounds_max[2] };
+    ok &= check(near(bounds_min, { 0.0f, -2.0f, -0.1f }, 0.01f) && near(bounds_max, { 39.0f, 37.0f, 0.1f }, 0.01f),
+        "bad bounds");
+    glm::vec3 extent = bounds_max - bounds_min;
+
+    for (uint32_t i = 0; i < asset.lod_count(); i++) {
+        const MeshFileLod& lod = asset.lod(i);
+        const MeshSourceLod& source = lods[i];
+        ok &= check(lod.vertex_count == source.positions.size() && lod.index_count == source.indices.size(),
+            "LOD table counts differ from the source");
+        ok &= check(lod.index_size == 2, "indices of a small mesh are not 16-bit");
+        ok &= check(lod.vertex_offset % MeshFileHeader::STREAM_ALIGNMENT == 0
+                && lod.index_offset % MeshFileHeader::STREAM_ALIGNMENT == 0,
+            "stream is not aligned");
+
+        const auto* vertices = static_cast<const MeshVertex*>(asset.vertex_data(i));
+        bool positions_match = true;
+        bool normals_match = true;
+        for (uint32_t v = 0; v < lod.vertex_count; v++) {
+            glm::vec3 unit { vertices[v].position[0] / 65535.0f, vertices[v].position[1] / 65535.0f,
+                vertices[v].position[2] / 65535.0f };
+            positions_match &= near(bounds_min + unit * extent, source.positions[v], 0.01f);
+            glm::vec3 normal = oct_decode(vertices[v].normal[0] / 32767.0f, vertices[v].normal[1] / 32767.0f);
+            normals_match &= near(normal, source.normals[v], 0.01f);
+        }
+        ok &= check(positions_match, "vertex positions differ from the source");
+        ok &= check(normals_match, "vertex normals differ from the source");
+
+        const auto* indices = static_cast<const uint16_t*>(asset.index_data(i));
+        bool indices_match = true;
+        for (uint32_t j = 0; j < lod.index_count; j++) {
+            indices_match &= indices[j] == source.indices[j];
+        }
+        ok &= check(indices_match, "indices differ from the source");
+    }
+    // Coarsest level first in the file.
+    ok &= check(asset.lod(1).index_offset < asset.lod(0).vertex_offset, "streams are not stored coarsest first");
+
+    std::filesystem::remove(path);
+    return ok;
+}
+
+static bool test_invalid_files()
+{
+    bool ok = true;
+    std::string path = temp_path("mesh_file_test_invalid.smesh");
+
+    bool threw = false;
+    try {
+        write_mesh_file(path, { MeshSourceLod {} });
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ok &= check(threw, "an empty LOD was written");
+
+    write_mesh_file(path, { grid(4) });
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 300);
+    threw = false;
+    try {
+        MeshAsset asset { path };
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ok &= check(threw, "a truncated file was accepted");
+
+    // A stream offset near 2^64 that wraps around when the stream's length is added to it.
+    write_mesh_file(path, { grid(4) });
+    {
+        std::fstream file { path, std::ios::binary | std::ios::in | std::ios::out };
+        uint64_t offset = ~uint64_t(0) - 8;
+        file.seekp(sizeof(MeshFileHeader) + offsetof(MeshFileLod, vertex_offset));
+        file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    threw = false;
+    try {
+        MeshAsset asset { path };
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ok &= check(threw, "a wrapping stream offset was accepted");
+
+    std::filesystem::remove(path);
+    return ok;
+}
+
+// A cube of quads without normals, with negative face indices and a v/vt/vn corner.
+static bool test_obj()
+{
+    std::string path = temp_path("mesh_file_test.obj");
+    {
+        std::ofstream file { path };
+        file << "# cube\n"
+                "v 0 0 0\nv 1 0 0\nv 1 1 0\nv 0 1 0\nv 0 0 1\nv 1 0 1\nv 1 1 1\nv 0 1 1\n"
+                "vt 0 0\nvn 0 0 -1\n"
+                "f 1/1/1 4/1/1 3/1/1 2/1/1\n"
+                "f 5 6 7 8\nf 1 2 6 5\nf 2 3 7 6\nf 3 4 8 7\nf -4 -8 -5 -1\n";
+    }
+
+    MeshSourceLod mesh = read_obj_file(path);
+    bool ok = check(mesh.indices.size() == 36, "cube does not have 12 triangles");
+    // The first face's corners carry their own normal, so they are separate vertices from the other faces'.
+    ok &= check(mesh.positions.size() == 12, "vertices with and without normals were merged");
+    bool unit = true;
+    for (const auto& normal : mesh.normals) {
+        unit &= std::abs(glm::length(normal) - 1.0f) < 1e-4f;
+    }
+    ok &= check(unit, "normals are not unit length");
+    ok &= check(near(mesh.normals[0], { 0.0f, 0.0f, -1.0f }, 1e-6f), "given normal was not kept");
+
+    {
+        std::ofstream file { path };
+        file << "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+    }
+    bool threw = false;
+    try {
+        read_obj_file(path);
+    } catch (const std::runtime_error&) {
+        threw = true;
+    }
+    ok &= check(threw, "a face past the last vertex was accepted");
+
+    std::filesystem::remove(path);
+    return ok;
+}
+
+int main()
+{
+    bool ok = true;
+    try {
+        ok &= test_round_trip();
+        ok &= test_invalid_files();
+        ok &= test_obj();
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        ok = false;
+    }
+
+    std::printf("%s\n", ok ? "mesh file: passed" : "mesh file: FAILED");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}